@@ -0,0 +1,420 @@
+/*
+ * Copyright (C) 2026 v0lt
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+// Headless benchmark of the video output conversion.
+// Every decoder format known to MapTargetFormat is combined with every target format
+// the host can request. The frames are synthetic, the conversion is the code of the plugin.
+// Prints MP/s and a checksum of the output, the checksum changes if the conversion changes.
+// The output is written through the layout that SetTargetFormat gives the host (FillPixmapLayout).
+//
+// usage: convert_bench [-s WxH] [-t seconds] [-f filter] [-d] [-v] [-r]
+//   -d  the host asks for DIB alignment, RGB rows are bottom-up
+//   -v  the source is flipped (flip_image of the source)
+//   -r  reference mode: compares the output with swscale using the flags of the plugin before
+//       pixconv and prints the maximum difference per channel instead of MP/s
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <chrono>
+#include <vector>
+
+#include "FormatMap.h"
+#include "FrameConverter.h"
+
+extern "C"
+{
+#include <libavutil/imgutils.h>
+#include <libavutil/pixdesc.h>
+#include <libswscale/swscale.h>
+}
+
+using namespace nsVDXPixmap;
+
+static const AVPixelFormat s_sources[] = {
+	// mapped formats
+	AV_PIX_FMT_AYUV64LE,
+	AV_PIX_FMT_AYUV64BE,
+	AV_PIX_FMT_YUVA444P,
+	AV_PIX_FMT_YUVA422P,
+	AV_PIX_FMT_YUVA420P,
+	AV_PIX_FMT_YUVA444P9LE,
+	AV_PIX_FMT_YUVA444P10LE,
+	AV_PIX_FMT_YUVA444P16LE,
+	AV_PIX_FMT_YUVA422P9LE,
+	AV_PIX_FMT_YUVA422P10LE,
+	AV_PIX_FMT_YUVA422P16LE,
+	AV_PIX_FMT_YUVA420P9LE,
+	AV_PIX_FMT_YUVA420P10LE,
+	AV_PIX_FMT_YUVA420P16LE,
+	AV_PIX_FMT_YUV420P9LE,
+	AV_PIX_FMT_YUV420P10LE,
+	AV_PIX_FMT_YUV420P12LE,
+	AV_PIX_FMT_YUV420P14LE,
+	AV_PIX_FMT_YUV420P16LE,
+	AV_PIX_FMT_YUV422P9LE,
+	AV_PIX_FMT_YUV422P10LE,
+	AV_PIX_FMT_YUV422P12LE,
+	AV_PIX_FMT_YUV422P14LE,
+	AV_PIX_FMT_YUV422P16LE,
+	AV_PIX_FMT_YUV444P9LE,
+	AV_PIX_FMT_YUV444P10LE,
+	AV_PIX_FMT_YUV444P12LE,
+	AV_PIX_FMT_YUV444P14LE,
+	AV_PIX_FMT_YUV444P16LE,
+	AV_PIX_FMT_YUV420P,
+	AV_PIX_FMT_YUVJ420P,
+	AV_PIX_FMT_YUV422P,
+	AV_PIX_FMT_YUVJ422P,
+	AV_PIX_FMT_YUV440P,
+	AV_PIX_FMT_YUVJ440P,
+	AV_PIX_FMT_UYVY422,
+	AV_PIX_FMT_YUYV422,
+	AV_PIX_FMT_YUV444P,
+	AV_PIX_FMT_YUVJ444P,
+	AV_PIX_FMT_YUV411P,
+	AV_PIX_FMT_BGR24,
+	AV_PIX_FMT_BGRA,
+	AV_PIX_FMT_BGR0,
+	AV_PIX_FMT_BGRA64,
+	AV_PIX_FMT_GRAY8,
+	AV_PIX_FMT_GRAY16,
+	// default branch: high bit depth RGB and formats without a perfect match
+	AV_PIX_FMT_GBRP10LE,
+	AV_PIX_FMT_GBRP12LE,
+	AV_PIX_FMT_GBRP16LE,
+	AV_PIX_FMT_GBRP16BE,
+	AV_PIX_FMT_GBRAP12LE,
+	AV_PIX_FMT_GBRAP16BE,
+	AV_PIX_FMT_RGB48LE,
+	AV_PIX_FMT_RGB24,
+	AV_PIX_FMT_RGBA,
+	AV_PIX_FMT_PAL8,
+	AV_PIX_FMT_NV12,
+	AV_PIX_FMT_P010LE,
+};
+
+static const struct {
+	VDXPixmapFormat format;
+	const char* name;
+} s_targets[] = {
+	{ kPixFormat_Null,            "default"  },
+	{ kPixFormat_YUV420_Planar,   "YUV420"   },
+	{ kPixFormat_YUV422_Planar,   "YUV422"   },
+	{ kPixFormat_YUV411_Planar,   "YUV411"   },
+	{ kPixFormat_YUV422_UYVY,     "UYVY"     },
+	{ kPixFormat_YUV422_YUYV,     "YUYV"     },
+	{ kPixFormat_YUV444_Planar,   "YUV444"   },
+	{ kPixFormat_YUV444_Planar16, "YUV444_16"},
+	{ kPixFormat_YUV422_V210,     "V210"     },
+	{ kPixFormat_XRGB64,          "XRGB64"   },
+	{ kPixFormat_XRGB1555,        "XRGB1555" },
+	{ kPixFormat_RGB565,          "RGB565"   },
+	{ kPixFormat_RGB888,          "RGB888"   },
+	{ kPixFormat_XRGB8888,        "XRGB8888" },
+};
+
+// color range and matrix of the source, BT.601 limited is the common default
+static const struct {
+	bool full_range;
+	bool bt709;
+	const char* name;
+} s_colors[] = {
+	{ false, false, "601" },
+	{ true,  true,  "709FR" },
+};
+
+static const int line_align = 32;
+
+struct Picture {
+	std::vector<uint8_t> buf;
+	uint8_t* data[4] = {};
+	int linesize[4] = {};
+	int size = 0;
+
+	bool Alloc(const AVPixelFormat fmt, const int w, const int h)
+	{
+		size = av_image_get_buffer_size(fmt, w, h, line_align);
+		if (size < 0) {
+			return false;
+		}
+		buf.resize(size + line_align);
+		uint8_t* p = buf.data() + (line_align - uintptr_t(buf.data()) % line_align) % line_align;
+		return av_image_fill_arrays(data, linesize, p, fmt, w, h, line_align) >= 0;
+	}
+};
+
+// smooth gradients with some noise, every sample is in the valid range of its component
+static void fill_synthetic(Picture& pic, const AVPixelFormat fmt, const int w, const int h)
+{
+	const AVPixFmtDescriptor* desc = av_pix_fmt_desc_get(fmt);
+	std::vector<uint16_t> line(w);
+	uint32_t seed = 0x12345678;
+
+	for (int c = 0; c < desc->nb_components; c++) {
+		const bool chroma = (c == 1 || c == 2) && !(desc->flags & AV_PIX_FMT_FLAG_RGB);
+		const int cw = chroma ? AV_CEIL_RSHIFT(w, desc->log2_chroma_w) : w;
+		const int ch = chroma ? AV_CEIL_RSHIFT(h, desc->log2_chroma_h) : h;
+		const int depth = desc->comp[c].depth;
+		const int max = (1 << depth) - 1;
+		const int scale = 1 << (depth - 8);
+
+		for (int y = 0; y < ch; y++) {
+			for (int x = 0; x < cw; x++) {
+				seed = seed * 1664525 + 1013904223;
+				int v = ((x * 255 / cw + y * 64 / ch + c * 85) & 0xFF) * scale;
+				v += int(seed >> 24) % (4 * scale) - 2 * scale;
+				line[x] = (uint16_t)std::clamp(v, 0, max);
+			}
+			av_write_image_line2(line.data(), pic.data, pic.linesize, desc, 0, y, c, cw, 2);
+		}
+	}
+
+	if (desc->flags & AV_PIX_FMT_FLAG_PAL) {
+		uint32_t* pal = (uint32_t*)pic.data[1];
+		for (int i = 0; i < 256; i++) {
+			pal[i] = 0xFF000000u | (i << 16) | ((255 - i) << 8) | ((i * 7) & 0xFF);
+		}
+	}
+}
+
+// FNV-1a of the visible samples
+static uint64_t checksum(const Picture& pic, const AVPixelFormat fmt, const int w, const int h)
+{
+	const AVPixFmtDescriptor* desc = av_pix_fmt_desc_get(fmt);
+	uint64_t hash = 0xcbf29ce484222325ull;
+
+	for (int i = 0; i < 4 && pic.data[i]; i++) {
+		if (i == 1 && (desc->flags & AV_PIX_FMT_FLAG_PAL)) {
+			break;
+		}
+		const int bytes = av_image_get_linesize(fmt, w, i);
+		const int rows = (i == 1 || i == 2) ? AV_CEIL_RSHIFT(h, desc->log2_chroma_h) : h;
+		for (int y = 0; y < rows; y++) {
+			const uint8_t* p = pic.data[i] + (ptrdiff_t)y * pic.linesize[i];
+			for (int x = 0; x < bytes; x++) {
+				hash = (hash ^ p[x]) * 0x100000001b3ull;
+			}
+		}
+	}
+
+	return hash;
+}
+
+// the conversion of the plugin before pixconv: swscale for every pair
+static bool convert_reference(const Picture& src, Picture& dst, const FormatMapping& m, const int w, const int h,
+	const AVColorSpace colorspace, const bool full_range, const bool flip)
+{
+	int flags = m.in_subs ? SWS_BICUBIC : SWS_POINT;
+	flags |= SWS_FULL_CHR_H_INT | SWS_ACCURATE_RND;
+
+	SwsContext* sws = sws_getContext(w, h, m.src_fmt, w, h, m.av_fmt, flags, nullptr, nullptr, nullptr);
+	if (!sws) {
+		return false;
+	}
+	if (m.in_yuv && m.out_rgb) {
+		int* t1; int* t2; int r1, r2; int p0, p1, p2;
+		sws_getColorspaceDetails(sws, &t1, &r1, &t2, &r2, &p0, &p1, &p2);
+		sws_setColorspaceDetails(sws, sws_getCoefficients(colorspace), full_range ? 1 : 0, t2, r2, p0, p1, p2);
+	}
+
+	const uint8_t* data[4] = { src.data[0], src.data[1], src.data[2], src.data[3] };
+	int linesize[4] = { src.linesize[0], src.linesize[1], src.linesize[2], src.linesize[3] };
+	if (flip) {
+		// as VDFFFrameConverter
+		data[0] += linesize[0] * (h - 1);
+		linesize[0] = -linesize[0];
+	}
+	sws_scale(sws, data, linesize, 0, h, dst.data, dst.linesize);
+	sws_freeContext(sws);
+
+	return true;
+}
+
+// maximum difference per component, the output of the plugin is read through the layout of the host.
+// Values scaled by a proxy (max_value) are compared at 16 bits.
+static void max_difference(const VDXPixmapAlpha& pixmap, const Picture& ref, const AVPixelFormat fmt, const int max_value, int diff[4])
+{
+	const AVPixFmtDescriptor* desc = av_pix_fmt_desc_get(fmt);
+	const uint8_t* data[4] = { (const uint8_t*)pixmap.data, (const uint8_t*)pixmap.data2, (const uint8_t*)pixmap.data3, (const uint8_t*)pixmap.data4 };
+	const int linesize[4] = { int(pixmap.pitch), int(pixmap.pitch2), int(pixmap.pitch3), int(pixmap.pitch4) };
+	const int w = pixmap.w;
+	const int h = pixmap.h;
+	std::vector<uint16_t> a(w), b(w);
+
+	for (int c = 0; c < 4; c++) {
+		diff[c] = -1;
+	}
+	for (int c = 0; c < desc->nb_components; c++) {
+		const bool chroma = (c == 1 || c == 2) && !(desc->flags & AV_PIX_FMT_FLAG_RGB);
+		const int cw = chroma ? AV_CEIL_RSHIFT(w, desc->log2_chroma_w) : w;
+		const int ch = chroma ? AV_CEIL_RSHIFT(h, desc->log2_chroma_h) : h;
+		diff[c] = 0;
+		for (int y = 0; y < ch; y++) {
+			av_read_image_line2(a.data(), data, linesize, desc, 0, y, c, cw, 0, 2);
+			av_read_image_line2(b.data(), (const uint8_t**)ref.data, ref.linesize, desc, 0, y, c, cw, 0, 2);
+			for (int x = 0; x < cw; x++) {
+				const int v = max_value ? (a[x] * 65535 + max_value / 2) / max_value : a[x];
+				diff[c] = std::max(diff[c], std::abs(v - b[x]));
+			}
+		}
+	}
+}
+
+// v210 pictures are copied from the decoder into pages of the decoded format, the rows of
+// the host layout must fit
+static void check_v210_layout(const int w, const int h)
+{
+	Picture pic;
+	if (!pic.Alloc(AV_PIX_FMT_YUV422P10LE, w, h)) {
+		return;
+	}
+	VDXPixmapAlpha pixmap = {};
+	pixmap.format = kPixFormat_YUV422_V210;
+	pixmap.w = w;
+	pixmap.h = h;
+	FillPixmapLayout(pixmap, pic.data[0], AV_PIX_FMT_YUV422P10LE, line_align, false);
+	const bool ok = pixmap.pitch == (w + 47) / 48 * 128 && (int64_t)pixmap.pitch * h <= pic.size;
+	printf("%-16s %-10s %-6s %-16s %-5d %-8s %s\n\n", "yuv422p10le", "V210", "-", "yuv422p10le", (int)pixmap.format, "layout",
+		ok ? "ok" : "rows do not fit");
+}
+
+int main(int argc, char* argv[])
+{
+	int width  = 1920;
+	int height = 1080;
+	double min_time = 0.25;
+	const char* filter = nullptr;
+	bool dib = false;
+	bool flip = false;
+	bool reference = false;
+
+	for (int i = 1; i < argc; i++) {
+		if (!strcmp(argv[i], "-s") && i + 1 < argc) {
+			if (sscanf(argv[++i], "%dx%d", &width, &height) != 2 || width <= 0 || height <= 0) {
+				fprintf(stderr, "invalid size\n");
+				return 1;
+			}
+		}
+		else if (!strcmp(argv[i], "-t") && i + 1 < argc) {
+			min_time = atof(argv[++i]);
+		}
+		else if (!strcmp(argv[i], "-f") && i + 1 < argc) {
+			filter = argv[++i];
+		}
+		else if (!strcmp(argv[i], "-d")) {
+			dib = true;
+		}
+		else if (!strcmp(argv[i], "-v")) {
+			flip = true;
+		}
+		else if (!strcmp(argv[i], "-r")) {
+			reference = true;
+		}
+		else {
+			fprintf(stderr, "usage: %s [-s WxH] [-t seconds] [-f filter] [-d] [-v] [-r]\n", argv[0]);
+			return 1;
+		}
+	}
+
+	const double mpixels = double(width) * height / 1e6;
+
+	printf("%dx%d, pixconv cpu level %d%s%s\n\n", width, height, (int)pixconv::GetCpuLevel(), dib ? ", DIB" : "", flip ? ", flipped" : "");
+	check_v210_layout(width, height);
+	printf("%-16s %-10s %-6s %-16s %-5s %-8s %10s  %s\n", "source", "target", "color", "output", "vdfmt", "path",
+		reference ? "max diff" : "MP/s", "checksum");
+
+	for (const AVPixelFormat src_fmt : s_sources) {
+		const char* src_name = av_get_pix_fmt_name(src_fmt);
+		if (filter && !strstr(src_name, filter)) {
+			continue;
+		}
+
+		Picture src;
+		if (!src.Alloc(src_fmt, width, height)) {
+			printf("%-16s allocation failed\n", src_name);
+			continue;
+		}
+		fill_synthetic(src, src_fmt, width, height);
+
+		for (const auto& target : s_targets) {
+			for (const auto& color : s_colors) {
+				FormatMapping m;
+				if (!MapTargetFormat(src_fmt, target.format, color.full_range, color.bt709, m)) {
+					printf("%-16s %-10s %-6s %-16s\n", src_name, target.name, color.name, "-");
+					continue;
+				}
+				const char* out_name = av_get_pix_fmt_name(m.av_fmt);
+
+				if (m.direct_copy) {
+					printf("%-16s %-10s %-6s %-16s %-5d %-8s %10s  %016llx\n", src_name, target.name, color.name,
+						out_name, (int)m.format, "direct", "-", (unsigned long long)checksum(src, src_fmt, width, height));
+					continue;
+				}
+
+				const AVColorSpace colorspace = color.bt709 ? AVCOL_SPC_BT709 : AVCOL_SPC_BT470BG;
+				VDFFFrameConverter conv;
+				if (!conv.Init(m, width, height, colorspace, color.full_range, AVCHROMA_LOC_LEFT, flip, false)) {
+					printf("%-16s %-10s %-6s %-16s %-5d init failed\n", src_name, target.name, color.name, out_name, (int)m.format);
+					continue;
+				}
+
+				Picture dst;
+				if (!dst.Alloc(m.av_fmt, width, height)) {
+					printf("%-16s %-10s %-6s %-16s allocation failed\n", src_name, target.name, color.name, out_name);
+					continue;
+				}
+
+				// the planes the host gets, as VDFFVideoSource::SetTargetFormat sets them up
+				VDXPixmapAlpha pixmap = {};
+				pixmap.format = m.format;
+				pixmap.w = width;
+				pixmap.h = height;
+				FillPixmapLayout(pixmap, dst.data[0], m.av_fmt, line_align, dib ^ flip);
+				uint8_t* const dst_data[4] = { (uint8_t*)pixmap.data, (uint8_t*)pixmap.data2, (uint8_t*)pixmap.data3, (uint8_t*)pixmap.data4 };
+				const int dst_stride[4] = { int(pixmap.pitch), int(pixmap.pitch2), int(pixmap.pitch3), int(pixmap.pitch4) };
+
+				// warm up, also the output for the checksum
+				conv.Convert(src.data, src.linesize, dst_data, dst_stride);
+				const char* path = conv.IsSwscale() ? "swscale" : "pixconv";
+				const unsigned long long hash = checksum(dst, m.av_fmt, width, height);
+
+				if (reference) {
+					Picture ref;
+					if (!ref.Alloc(m.av_fmt, width, height) || !convert_reference(src, ref, m, width, height, colorspace, color.full_range, flip)) {
+						printf("%-16s %-10s %-6s %-16s %-5d %-8s %10s  %016llx\n", src_name, target.name, color.name,
+							out_name, (int)m.format, path, "no ref", hash);
+						continue;
+					}
+					int diff[4];
+					max_difference(pixmap, ref, m.av_fmt, conv.GetProxyMaxValue(), diff);
+					char text[32];
+					int len = 0;
+					for (int c = 0; c < 4 && diff[c] >= 0; c++) {
+						len += snprintf(text + len, sizeof(text) - len, c ? "/%d" : "%d", diff[c]);
+					}
+					printf("%-16s %-10s %-6s %-16s %-5d %-8s %10s  %016llx\n", src_name, target.name, color.name,
+						out_name, (int)m.format, path, text, hash);
+					continue;
+				}
+
+				int iterations = 0;
+				double elapsed = 0;
+				const auto start = std::chrono::steady_clock::now();
+				do {
+					conv.Convert(src.data, src.linesize, dst_data, dst_stride);
+					iterations++;
+					elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+				} while (elapsed < min_time || iterations < 3);
+
+				printf("%-16s %-10s %-6s %-16s %-5d %-8s %10.1f  %016llx\n", src_name, target.name, color.name,
+					out_name, (int)m.format, path, mpixels * iterations / elapsed, hash);
+			}
+		}
+	}
+
+	return 0;
+}
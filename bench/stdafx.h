@@ -0,0 +1,13 @@
+/*
+ * Copyright (C) 2026 v0lt
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+// Replaces src/pch/stdafx.h for the portable sources built by the benchmark.
+
+#include <algorithm>
+#include <cassert>
+#include <memory>
+#include <functional>
+#include <string>
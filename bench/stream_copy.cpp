@@ -0,0 +1,220 @@
+/*
+ * Copyright (C) 2026 v0lt
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+// Headless stream copy with the engine of the "Stream copy..." export command.
+// Every -i starts a job, every -o adds an output with the ranges given before it.
+// All outputs of a job are written in one pass over the input.
+// Prints the time and the throughput of every job. With -m smart it also prints the frames of
+// the reference stream in every output and the number the ranges ask for, a frame lost at a cut
+// (e.g. a leading picture of an open GOP) shows up as a difference.
+//
+// usage: stream_copy -i input [-s stream,stream...] [-m keyframe|smart] [-r start:end]... -o output [[-r ...]... -o output]...
+//        times are in seconds from the start of the reference stream (the first of -s),
+//        an empty end is the end of the stream, -m smart re-encodes the partial GOPs at the cuts
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include "StreamCopy.h"
+
+extern "C"
+{
+#include <libavutil/error.h>
+}
+
+struct PendingJob {
+	VDFFStreamCopy::Job job;
+	std::vector<std::pair<double, double>> ranges; // of the next output, seconds
+	std::vector<int64_t> frames; // of the reference stream by output, -1 if not known
+};
+
+static std::string error_string(const int err)
+{
+	char buf[AV_ERROR_MAX_STRING_SIZE];
+	av_strerror(err, buf, sizeof(buf));
+	return buf;
+}
+
+static int64_t seconds_to_ts(const AVStream* st, const double t)
+{
+	if (t < 0) {
+		return INT64_MAX;
+	}
+	const int64_t start_time = (st->start_time != AV_NOPTS_VALUE) ? st->start_time : 0;
+	return start_time + (int64_t)(t / av_q2d(st->time_base) + 0.5);
+}
+
+static bool open_job(PendingJob& p)
+{
+	AVFormatContext* fmt = nullptr;
+	int err = avformat_open_input(&fmt, p.job.input.c_str(), nullptr, nullptr);
+	if (err >= 0) {
+		err = avformat_find_stream_info(fmt, nullptr);
+	}
+	if (err < 0) {
+		fprintf(stderr, "%s: %s\n", p.job.input.c_str(), error_string(err).c_str());
+		avformat_close_input(&fmt);
+		return false;
+	}
+	p.job.fmt = fmt;
+	return true;
+}
+
+static bool add_output(PendingJob& p, const char* path)
+{
+	if (!p.job.fmt && !open_job(p)) {
+		return false;
+	}
+	if (p.job.streams.empty()) {
+		p.job.streams = VDFFStreamCopy::DefaultStreams(p.job.fmt);
+		if (p.job.streams.empty()) {
+			fprintf(stderr, "%s: no streams to copy\n", p.job.input.c_str());
+			return false;
+		}
+	}
+	const AVStream* ref = p.job.fmt->streams[p.job.streams[0]];
+
+	VDFFStreamCopy::Output& out = p.job.outputs.emplace_back();
+	out.path = path;
+	int64_t frames = p.ranges.empty() ? -1 : 0;
+	for (const auto& [start, end] : p.ranges) {
+		out.ranges.push_back({ seconds_to_ts(ref, start), seconds_to_ts(ref, end) });
+		if (end < 0 || ref->avg_frame_rate.num <= 0 || ref->avg_frame_rate.den <= 0) {
+			frames = -1;
+		} else if (frames >= 0) {
+			const double fps = av_q2d(ref->avg_frame_rate);
+			frames += llround(end * fps) - llround(start * fps);
+		}
+	}
+	p.frames.push_back(frames);
+	p.ranges.clear();
+	return true;
+}
+
+// packets of the first stream of a written file, the reference stream of the job
+static int64_t count_frames(const std::string& path)
+{
+	AVFormatContext* fmt = nullptr;
+	if (avformat_open_input(&fmt, path.c_str(), nullptr, nullptr) < 0) {
+		return -1;
+	}
+	int64_t count = 0;
+	AVPacket* pkt = av_packet_alloc();
+	while (pkt && av_read_frame(fmt, pkt) >= 0) {
+		if (pkt->stream_index == 0) {
+			count++;
+		}
+		av_packet_unref(pkt);
+	}
+	av_packet_free(&pkt);
+	avformat_close_input(&fmt);
+	return count;
+}
+
+static void usage()
+{
+	printf("usage: stream_copy -i input [-s stream,stream...] [-m keyframe|smart] [-r start:end]... -o output [[-r ...]... -o output]...\n");
+}
+
+int main(int argc, char** argv)
+{
+	std::vector<PendingJob> pending;
+
+	for (int i = 1; i < argc; i++) {
+		const char* arg = argv[i];
+		if (i + 1 >= argc) {
+			usage();
+			return 1;
+		}
+		const char* value = argv[++i];
+
+		if (!strcmp(arg, "-i")) {
+			pending.emplace_back().job.input = value;
+			continue;
+		}
+		if (pending.empty()) {
+			usage();
+			return 1;
+		}
+		PendingJob& p = pending.back();
+
+		if (!strcmp(arg, "-s")) {
+			for (const char* s = value; *s; ) {
+				char* e;
+				p.job.streams.push_back((int)strtol(s, &e, 10));
+				if (*e != ',') {
+					break;
+				}
+				s = e + 1;
+			}
+		} else if (!strcmp(arg, "-m")) {
+			p.job.smart_render = !strcmp(value, "smart");
+		} else if (!strcmp(arg, "-r")) {
+			const char* colon = strchr(value, ':');
+			const double start = atof(value);
+			const double end = (colon && colon[1]) ? atof(colon + 1) : -1.0;
+			p.ranges.emplace_back(start, end);
+		} else if (!strcmp(arg, "-o")) {
+			if (!add_output(p, value)) {
+				return 1;
+			}
+		} else {
+			usage();
+			return 1;
+		}
+	}
+
+	std::vector<VDFFStreamCopy::Job> jobs;
+	std::vector<std::vector<int64_t>> frames;
+	for (auto& p : pending) {
+		if (p.job.outputs.empty()) {
+			fprintf(stderr, "%s: no output\n", p.job.input.c_str());
+			return 1;
+		}
+		frames.push_back(p.job.smart_render ? p.frames : std::vector<int64_t>(p.frames.size(), -1));
+		jobs.push_back(std::move(p.job));
+	}
+	if (jobs.empty()) {
+		usage();
+		return 1;
+	}
+
+	auto t0 = std::chrono::steady_clock::now();
+	int64_t job_bytes = 0;
+
+	VDFFStreamCopy::Callbacks cb;
+	cb.progress = [&job_bytes](int, double, int64_t bytes) {
+		job_bytes = bytes;
+		return true;
+	};
+	cb.finished = [&](int job, int err) {
+		const auto t1 = std::chrono::steady_clock::now();
+		const double sec = std::chrono::duration<double>(t1 - t0).count();
+		if (err < 0) {
+			printf("%s: %s\n", jobs[job].input.c_str(), error_string(err).c_str());
+		} else {
+			printf("%s: %zu outputs, %.1f MB in %.3f s, %.1f MB/s\n", jobs[job].input.c_str(), jobs[job].outputs.size(),
+				job_bytes / 1e6, sec, sec > 0 ? job_bytes / 1e6 / sec : 0.0);
+			for (size_t i = 0; i < jobs[job].outputs.size(); i++) {
+				if (frames[job][i] >= 0) {
+					const std::string& path = jobs[job].outputs[i].path;
+					const int64_t count = count_frames(path);
+					printf("  %s: %lld frames, %lld expected%s\n", path.c_str(), (long long)count, (long long)frames[job][i],
+						(count == frames[job][i]) ? "" : " MISMATCH");
+				}
+			}
+		}
+		t0 = std::chrono::steady_clock::now();
+		job_bytes = 0;
+	};
+
+	return VDFFStreamCopy::Run(jobs, cb) < 0 ? 1 : 0;
+}
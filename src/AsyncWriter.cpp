@@ -0,0 +1,520 @@
+/*
+ * Copyright (C) 2026 v0lt
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include "stdafx.h"
+
+#include "AsyncWriter.h"
+#include <algorithm>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifndef _WIN32
+#include <cerrno>
+#include <cstdlib>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+extern "C"
+{
+#include <libavutil/error.h>
+#include <libavutil/mem.h>
+}
+
+namespace {
+
+// sector alignment for unbuffered I/O
+constexpr size_t kAlign = 4096;
+
+size_t align_up(const size_t size)
+{
+	return (size + kAlign - 1) & ~(kAlign - 1);
+}
+
+uint8_t* alloc_aligned(const size_t size)
+{
+#ifdef _WIN32
+	return (uint8_t*)_aligned_malloc(size, kAlign);
+#else
+	void* p = nullptr;
+	return (posix_memalign(&p, kAlign, size) == 0) ? (uint8_t*)p : nullptr;
+#endif
+}
+
+void free_aligned(uint8_t* p)
+{
+#ifdef _WIN32
+	_aligned_free(p);
+#else
+	free(p);
+#endif
+}
+
+// a file written at explicit offsets. In direct mode the full blocks go through a second,
+// unbuffered handle, the unaligned writes through the buffered one.
+class File
+{
+public:
+	~File() { Close(); }
+
+	int Open(const char* path, const bool direct);
+	void Close();
+	bool IsDirect() const;
+
+	int WriteAt(int64_t offset, const uint8_t* data, size_t size, const bool aligned);
+	int Truncate(const int64_t size);
+
+private:
+#ifdef _WIN32
+	HANDLE m_file = INVALID_HANDLE_VALUE;
+	HANDLE m_direct = INVALID_HANDLE_VALUE;
+#else
+	int m_file = -1;
+	int m_direct = -1;
+#endif
+};
+
+#ifdef _WIN32
+
+int win32_error()
+{
+	switch (GetLastError()) {
+	case ERROR_FILE_NOT_FOUND:
+	case ERROR_PATH_NOT_FOUND: return AVERROR(ENOENT);
+	case ERROR_ACCESS_DENIED:
+	case ERROR_SHARING_VIOLATION: return AVERROR(EACCES);
+	case ERROR_DISK_FULL:
+	case ERROR_HANDLE_DISK_FULL: return AVERROR(ENOSPC);
+	default: return AVERROR(EIO);
+	}
+}
+
+int File::Open(const char* path, const bool direct)
+{
+	const int len = MultiByteToWideChar(CP_UTF8, 0, path, -1, nullptr, 0);
+	std::wstring wpath(len, 0);
+	MultiByteToWideChar(CP_UTF8, 0, path, -1, wpath.data(), len);
+
+	m_file = CreateFileW(wpath.c_str(), GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (m_file == INVALID_HANDLE_VALUE) {
+		return win32_error();
+	}
+	if (direct) {
+		// not supported by every file system, the buffered handle is used then
+		m_direct = CreateFileW(wpath.c_str(), GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_NO_BUFFERING | FILE_FLAG_WRITE_THROUGH, nullptr);
+	}
+	return 0;
+}
+
+void File::Close()
+{
+	if (m_direct != INVALID_HANDLE_VALUE) {
+		CloseHandle(m_direct);
+		m_direct = INVALID_HANDLE_VALUE;
+	}
+	if (m_file != INVALID_HANDLE_VALUE) {
+		CloseHandle(m_file);
+		m_file = INVALID_HANDLE_VALUE;
+	}
+}
+
+bool File::IsDirect() const
+{
+	return m_direct != INVALID_HANDLE_VALUE;
+}
+
+int File::WriteAt(int64_t offset, const uint8_t* data, size_t size, const bool aligned)
+{
+	HANDLE h = (aligned && m_direct != INVALID_HANDLE_VALUE) ? m_direct : m_file;
+	while (size > 0) {
+		OVERLAPPED ov = {};
+		ov.Offset = DWORD(offset);
+		ov.OffsetHigh = DWORD(offset >> 32);
+		const DWORD n = DWORD(std::min<size_t>(size, 1 << 30));
+		DWORD written = 0;
+		if (!WriteFile(h, data, n, &written, &ov) || written == 0) {
+			return win32_error();
+		}
+		data += written;
+		offset += written;
+		size -= written;
+	}
+	return 0;
+}
+
+int File::Truncate(const int64_t size)
+{
+	LARGE_INTEGER li;
+	li.QuadPart = size;
+	if (!SetFilePointerEx(m_file, li, nullptr, FILE_BEGIN) || !SetEndOfFile(m_file)) {
+		return win32_error();
+	}
+	return 0;
+}
+
+#else
+
+int File::Open(const char* path, const bool direct)
+{
+	m_file = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0666);
+	if (m_file < 0) {
+		return AVERROR(errno);
+	}
+#ifdef O_DIRECT
+	if (direct) {
+		m_direct = open(path, O_WRONLY | O_DIRECT | O_CLOEXEC);
+	}
+#endif
+	return 0;
+}
+
+void File::Close()
+{
+	if (m_direct >= 0) {
+		close(m_direct);
+		m_direct = -1;
+	}
+	if (m_file >= 0) {
+		close(m_file);
+		m_file = -1;
+	}
+}
+
+bool File::IsDirect() const
+{
+	return m_direct >= 0;
+}
+
+int File::WriteAt(int64_t offset, const uint8_t* data, size_t size, const bool aligned)
+{
+	const int fd = (aligned && m_direct >= 0) ? m_direct : m_file;
+	while (size > 0) {
+		const ssize_t written = pwrite(fd, data, size, offset);
+		if (written < 0 && errno == EINTR) {
+			continue;
+		}
+		if (written <= 0) {
+			return (written < 0) ? AVERROR(errno) : AVERROR(EIO);
+		}
+		data += written;
+		offset += written;
+		size -= written;
+	}
+	return 0;
+}
+
+int File::Truncate(const int64_t size)
+{
+	return (ftruncate(m_file, size) < 0) ? AVERROR(errno) : 0;
+}
+
+#endif
+
+class Writer
+{
+public:
+	~Writer() { Close(); }
+
+	int Open(const char* path, const VDFFAsyncWriter::Options& options);
+	int Close();
+
+	static int write_packet(void* opaque, const uint8_t* buf, int buf_size);
+	static int64_t seek(void* opaque, int64_t offset, int whence);
+
+private:
+	struct Item {
+		int64_t offset = 0;
+		uint8_t* block = nullptr;  // a block of the pool
+		size_t size = 0;
+		std::vector<uint8_t> data; // a positioned write if there is no block
+	};
+
+	int write(const uint8_t* buf, size_t size);
+	int submit_block();
+	int queue_patch(const uint8_t* buf, size_t size);
+	void worker();
+
+	File m_file;
+	bool m_direct = false;
+	size_t m_block_size = 0;
+	std::vector<uint8_t*> m_blocks;
+
+	// muxing thread
+	uint8_t* m_block = nullptr; // being filled, at the end of the file
+	int64_t m_block_off = 0;
+	size_t m_block_len = 0;
+	int64_t m_pos = 0;
+	int64_t m_size = 0;
+
+	std::mutex m_mutex;
+	std::condition_variable m_cond;
+	std::deque<Item> m_queue;
+	std::vector<uint8_t*> m_free;
+	int m_error = 0;
+	bool m_exit = false;
+	std::thread m_thread;
+};
+
+int Writer::Open(const char* path, const VDFFAsyncWriter::Options& options)
+{
+	m_block_size = align_up(std::max<size_t>(options.block_size, kAlign));
+	const size_t count = std::max<size_t>(options.buffer_size / m_block_size, 2) + 1;
+	for (size_t i = 0; i < count; i++) {
+		uint8_t* p = alloc_aligned(m_block_size);
+		if (!p) {
+			return AVERROR(ENOMEM);
+		}
+		m_blocks.push_back(p);
+	}
+	m_block = m_blocks[0];
+	m_free.assign(m_blocks.begin() + 1, m_blocks.end());
+
+	const int err = m_file.Open(path, options.direct);
+	if (err < 0) {
+		return err;
+	}
+	m_direct = m_file.IsDirect();
+
+	m_thread = std::thread(&Writer::worker, this);
+	return 0;
+}
+
+int Writer::Close()
+{
+	if (m_thread.joinable()) {
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			if (m_block_len) {
+				Item item;
+				item.offset = m_block_off;
+				item.block = m_block;
+				item.size = m_block_len;
+				m_queue.push_back(std::move(item));
+				m_block = nullptr;
+				m_block_len = 0;
+			}
+			m_exit = true;
+		}
+		m_cond.notify_all();
+		m_thread.join();
+
+		// the last block was written padded
+		if (m_error >= 0 && m_direct) {
+			m_error = m_file.Truncate(m_size);
+		}
+	}
+	m_file.Close();
+
+	for (auto& p : m_blocks) {
+		free_aligned(p);
+	}
+	m_blocks.clear();
+	m_free.clear();
+	m_block = nullptr;
+
+	return m_error;
+}
+
+int Writer::write_packet(void* opaque, const uint8_t* buf, int buf_size)
+{
+	const int err = static_cast<Writer*>(opaque)->write(buf, buf_size);
+	return (err < 0) ? err : buf_size;
+}
+
+int64_t Writer::seek(void* opaque, int64_t offset, int whence)
+{
+	Writer* w = static_cast<Writer*>(opaque);
+	whence &= ~AVSEEK_FORCE;
+
+	int64_t pos;
+	switch (whence) {
+	case AVSEEK_SIZE: return w->m_size;
+	case SEEK_SET: pos = offset; break;
+	case SEEK_CUR: pos = w->m_pos + offset; break;
+	case SEEK_END: pos = w->m_size + offset; break;
+	default: return AVERROR(EINVAL);
+	}
+	if (pos < 0) {
+		return AVERROR(EINVAL);
+	}
+	w->m_pos = pos;
+	return pos;
+}
+
+int Writer::write(const uint8_t* buf, size_t size)
+{
+	if (!m_block) {
+		return (m_error < 0) ? m_error : AVERROR(EIO);
+	}
+	while (size > 0) {
+		const int64_t tail = m_block_off + (int64_t)m_block_len;
+		size_t n = 0;
+
+		if (m_pos >= tail) {
+			// a gap after a seek beyond the end is filled with zeros
+			const size_t gap = (size_t)std::min<int64_t>(m_pos - tail, int64_t(m_block_size - m_block_len));
+			if (gap) {
+				memset(m_block + m_block_len, 0, gap);
+				m_block_len += gap;
+			} else {
+				n = std::min(size, m_block_size - m_block_len);
+				memcpy(m_block + m_block_len, buf, n);
+				m_block_len += n;
+			}
+			if (m_block_len == m_block_size) {
+				const int err = submit_block();
+				if (err < 0) {
+					return err;
+				}
+			}
+		} else if (m_pos >= m_block_off) {
+			// rewrite in the block that is being filled
+			n = (size_t)std::min<int64_t>(size, tail - m_pos);
+			memcpy(m_block + (m_pos - m_block_off), buf, n);
+		} else {
+			n = (size_t)std::min<int64_t>(size, m_block_off - m_pos);
+			const int err = queue_patch(buf, n);
+			if (err < 0) {
+				return err;
+			}
+		}
+
+		buf += n;
+		size -= n;
+		m_pos += n;
+		m_size = std::max(m_size, m_pos);
+	}
+	return 0;
+}
+
+// queues the full block and waits for a free one
+int Writer::submit_block()
+{
+	Item item;
+	item.offset = m_block_off;
+	item.block = m_block;
+	item.size = m_block_len;
+
+	std::unique_lock<std::mutex> lock(m_mutex);
+	m_queue.push_back(std::move(item));
+	m_cond.notify_all();
+	m_cond.wait(lock, [this] { return !m_free.empty() || m_error < 0; });
+
+	m_block_off += m_block_len;
+	m_block_len = 0;
+	if (m_error < 0) {
+		m_block = nullptr;
+		return m_error;
+	}
+	m_block = m_free.back();
+	m_free.pop_back();
+	return 0;
+}
+
+int Writer::queue_patch(const uint8_t* buf, size_t size)
+{
+	Item item;
+	item.offset = m_pos;
+	item.size = size;
+	item.data.assign(buf, buf + size);
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	if (m_error < 0) {
+		return m_error;
+	}
+	m_queue.push_back(std::move(item));
+	m_cond.notify_all();
+	return 0;
+}
+
+void Writer::worker()
+{
+	for (;;) {
+		Item item;
+		int err;
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_cond.wait(lock, [this] { return !m_queue.empty() || m_exit; });
+			if (m_queue.empty()) {
+				return;
+			}
+			item = std::move(m_queue.front());
+			m_queue.pop_front();
+			err = m_error;
+		}
+
+		if (err >= 0) {
+			if (item.block) {
+				// unbuffered writes are whole sectors, the padding is cut off at Close
+				const size_t size = m_direct ? align_up(item.size) : item.size;
+				err = m_file.WriteAt(item.offset, item.block, size, true);
+			} else {
+				err = m_file.WriteAt(item.offset, item.data.data(), item.data.size(), false);
+			}
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			if (item.block) {
+				m_free.push_back(item.block);
+			}
+			if (err < 0 && m_error >= 0) {
+				m_error = err;
+			}
+		}
+		m_cond.notify_all();
+	}
+}
+
+} // namespace
+
+int VDFFAsyncWriter::Open(AVIOContext** pb, const char* path, const Options& options)
+{
+	auto writer = std::make_unique<Writer>();
+	int err = writer->Open(path, options);
+	if (err < 0) {
+		return err;
+	}
+
+	// the muxer writes through this buffer into the blocks of the writer
+	constexpr int io_size = 256 << 10;
+	uint8_t* buf = (uint8_t*)av_malloc(io_size);
+	AVIOContext* ctx = buf ? avio_alloc_context(buf, io_size, 1, writer.get(), nullptr, &Writer::write_packet, &Writer::seek) : nullptr;
+	if (!ctx) {
+		av_free(buf);
+		return AVERROR(ENOMEM);
+	}
+
+	writer.release();
+	*pb = ctx;
+	return 0;
+}
+
+int VDFFAsyncWriter::Close(AVIOContext** pb)
+{
+	AVIOContext* ctx = *pb;
+	if (!ctx) {
+		return 0;
+	}
+
+	avio_flush(ctx);
+	Writer* writer = static_cast<Writer*>(ctx->opaque);
+	int err = writer->Close();
+	delete writer;
+	if (err >= 0) {
+		err = ctx->error;
+	}
+
+	av_freep(&ctx->buffer);
+	avio_context_free(pb);
+	return err;
+}
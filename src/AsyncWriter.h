@@ -0,0 +1,37 @@
+/*
+ * Copyright (C) 2026 v0lt
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#pragma once
+
+extern "C"
+{
+#include <libavformat/avio.h>
+}
+
+// Write-behind output for the muxers: an AVIOContext that copies the data into large aligned
+// blocks, a writer thread writes the full blocks while the muxing thread goes on.
+// Seeking back (header rewrites) is supported: data for the block that is being filled is
+// patched in memory, older data is queued as a small positioned write.
+// The direct mode opens the file unbuffered (FILE_FLAG_NO_BUFFERING, O_DIRECT), so that
+// large outputs do not push the sources out of the system cache. The last block is written
+// padded and the file is truncated to its size when it is closed.
+// The data is on disk only after Close, so it is not for muxers that read back their output
+// (mov/mp4 with faststart).
+
+namespace VDFFAsyncWriter
+{
+	struct Options {
+		int buffer_size = 16 << 20; // bytes queued for the writer thread
+		int block_size = 1 << 20;   // size of the writes, rounded up to 4096
+		bool direct = false;        // unbuffered I/O
+	};
+
+	// path is UTF-8
+	int Open(AVIOContext** pb, const char* path, const Options& options);
+	// writes the rest, waits for the writer thread and closes the file,
+	// returns the first write error
+	int Close(AVIOContext** pb);
+}
@@ -0,0 +1,201 @@
+/*
+ * Copyright (C) 2026 v0lt
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include "stdafx.h"
+
+#include "AudioCache.h"
+#include <algorithm>
+
+namespace {
+	// memory budget of one audio stream
+	constexpr size_t kMaxCacheBytes = 128 * 1024 * 1024;
+	// pages that are always allowed, Read and read_packet work with a few pages at a time
+	constexpr size_t kMinPages = 4;
+}
+
+VDFFAudioCache::~VDFFAudioCache()
+{
+	free_pages();
+}
+
+void VDFFAudioCache::free_pages()
+{
+	for (const int i : m_used_pages) {
+		free(m_pages[i].data);
+	}
+	m_used_pages.clear();
+	m_pages.clear();
+	m_ranges.clear();
+}
+
+void VDFFAudioCache::Reset(int64_t sample_count, int sample_size)
+{
+	free_pages();
+
+	m_sample_count = std::max<int64_t>(sample_count, 0);
+	m_sample_size = sample_size;
+	m_pages.resize((size_t)((m_sample_count + page_size - 1) / page_size));
+
+	const size_t page_bytes = (size_t)page_size * std::max(sample_size, 1);
+	m_max_pages = std::max(kMaxCacheBytes / page_bytes, kMinPages);
+	m_use_counter = 0;
+}
+
+std::map<int64_t, int64_t>::iterator VDFFAudioCache::find_range(int64_t pos)
+{
+	auto it = m_ranges.upper_bound(pos);
+	if (it == m_ranges.begin()) {
+		return m_ranges.end();
+	}
+	--it;
+	return (it->second > pos) ? it : m_ranges.end();
+}
+
+void VDFFAudioCache::add_range(int64_t start, int64_t end)
+{
+	auto it = m_ranges.upper_bound(start);
+	if (it != m_ranges.begin() && std::prev(it)->second >= start) {
+		--it;
+	}
+	// join all ranges that overlap or touch the new one
+	while (it != m_ranges.end() && it->first <= end) {
+		start = std::min(start, it->first);
+		end = std::max(end, it->second);
+		it = m_ranges.erase(it);
+	}
+	m_ranges.emplace(start, end);
+}
+
+void VDFFAudioCache::remove_range(int64_t start, int64_t end)
+{
+	auto it = m_ranges.upper_bound(start);
+	if (it != m_ranges.begin() && std::prev(it)->second > start) {
+		--it;
+	}
+	while (it != m_ranges.end() && it->first < end) {
+		const int64_t r0 = it->first;
+		const int64_t r1 = it->second;
+		it = m_ranges.erase(it);
+		if (r0 < start) {
+			m_ranges.emplace(r0, start);
+		}
+		if (r1 > end) {
+			m_ranges.emplace(end, r1);
+			break;
+		}
+	}
+}
+
+uint8_t* VDFFAudioCache::alloc_page(int i)
+{
+	Page& page = m_pages[i];
+	if (page.data) {
+		page.last_use = ++m_use_counter;
+		return page.data;
+	}
+
+	uint8_t* data = nullptr;
+
+	if (m_used_pages.size() < m_max_pages) {
+		data = (uint8_t*)malloc((size_t)page_size * m_sample_size);
+		if (!data) {
+			if (m_used_pages.empty()) {
+				return nullptr;
+			}
+			// out of memory (32-bit address space), the cache keeps the pages it has
+			m_max_pages = m_used_pages.size();
+		}
+	}
+	if (!data) {
+		// reuse the least recently used page
+		auto lru = std::min_element(m_used_pages.begin(), m_used_pages.end(), [this](int a, int b) {
+			return m_pages[a].last_use < m_pages[b].last_use;
+		});
+		const int old = *lru;
+		m_used_pages.erase(lru);
+		data = m_pages[old].data;
+		m_pages[old] = {};
+		remove_range((int64_t)old * page_size, (int64_t)(old + 1) * page_size);
+	}
+
+	page.data = data;
+	page.last_use = ++m_use_counter;
+	m_used_pages.push_back(i);
+
+	return data;
+}
+
+int VDFFAudioCache::Copy(int64_t start, uint32_t count, void* dst)
+{
+	auto it = find_range(start);
+	if (it == m_ranges.end()) {
+		return 0;
+	}
+
+	const int64_t end = std::min(start + (int64_t)count, it->second);
+	uint8_t* out = (uint8_t*)dst;
+	int64_t pos = start;
+
+	while (pos < end) {
+		const int px = (int)(pos / page_size);
+		const int s0 = pos % page_size;
+		const int n = (int)std::min(end - pos, (int64_t)(page_size - s0));
+
+		Page& page = m_pages[px];
+		page.last_use = ++m_use_counter;
+		memcpy(out, page.data + (size_t)s0 * m_sample_size, (size_t)n * m_sample_size);
+
+		out += (size_t)n * m_sample_size;
+		pos += n;
+	}
+
+	return int(end - start);
+}
+
+int VDFFAudioCache::Missing(int64_t start, uint32_t count)
+{
+	if (find_range(start) != m_ranges.end()) {
+		return 0;
+	}
+	auto next = m_ranges.upper_bound(start);
+	if (next != m_ranges.end() && next->first < start + (int64_t)count) {
+		return int(next->first - start);
+	}
+	return count;
+}
+
+uint8_t* VDFFAudioCache::Alloc(int64_t start, uint32_t count, int& n, bool& changed)
+{
+	n = 0;
+	changed = false;
+
+	const int px = (int)(start / page_size);
+	if (start < 0 || px >= (int)m_pages.size()) {
+		return nullptr;
+	}
+
+	const int s0 = start % page_size;
+	n = std::min((int)count, page_size - s0);
+
+	uint8_t* data = alloc_page(px);
+	if (!data) {
+		n = 0;
+		return nullptr;
+	}
+
+	auto it = find_range(start);
+	if (it == m_ranges.end() || it->second < start + n) {
+		changed = true;
+		add_range(start, start + n);
+	}
+
+	return data + (size_t)s0 * m_sample_size;
+}
+
+void VDFFAudioCache::Invalidate(int64_t start, uint32_t count)
+{
+	remove_range(start, start + count);
+}
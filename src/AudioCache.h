@@ -0,0 +1,64 @@
+/*
+ * Copyright (C) 2026 v0lt
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <map>
+
+// Cache of decoded audio samples.
+// Samples are stored in pages of a fixed size, the decoded ranges are kept as a set of
+// disjoint intervals that are joined when they touch. Any number of ranges can be cached,
+// the least recently used pages are dropped when the memory budget is exceeded.
+
+class VDFFAudioCache
+{
+public:
+	enum { page_size = 0x8000 }; // samples
+
+	VDFFAudioCache() = default;
+	~VDFFAudioCache();
+
+	VDFFAudioCache(const VDFFAudioCache&) = delete;
+	VDFFAudioCache& operator=(const VDFFAudioCache&) = delete;
+
+	// drops all samples, sample_size is the size of a sample in bytes (block align)
+	void Reset(int64_t sample_count, int sample_size);
+
+	// copies cached samples from start, returns the number of samples copied (0 if start is not cached)
+	int Copy(int64_t start, uint32_t count, void* dst);
+	// returns the number of samples from start that are not cached, up to count
+	int Missing(int64_t start, uint32_t count);
+	// returns memory for n samples at start, n is limited to the end of the page.
+	// changed is false if the samples are already cached and should not be written.
+	// returns nullptr if start is outside of the stream or there is no memory for the page
+	uint8_t* Alloc(int64_t start, uint32_t count, int& n, bool& changed);
+	// removes samples from the cached ranges
+	void Invalidate(int64_t start, uint32_t count);
+
+private:
+	struct Page {
+		uint8_t* data = nullptr;
+		uint64_t last_use = 0;
+	};
+
+	std::vector<Page> m_pages;
+	std::vector<int> m_used_pages; // indices of pages with data
+	std::map<int64_t, int64_t> m_ranges; // start -> end of cached samples
+	int64_t m_sample_count = 0;
+	int m_sample_size = 0;
+	size_t m_max_pages = 0;
+	uint64_t m_use_counter = 0;
+
+	void free_pages();
+	uint8_t* alloc_page(int i);
+	void add_range(int64_t start, int64_t end);
+	void remove_range(int64_t start, int64_t end);
+	// returns the cached range that contains pos, m_ranges.end() if there is none
+	std::map<int64_t, int64_t>::iterator find_range(int64_t pos);
+};
@@ -45,6 +45,7 @@ void VDFFAudio::cleanup()
 	if (swr) {
 		swr_free(&swr);
 	}
+	sample_conv.Reset();
 	if (sample_buf) {
 		av_freep(&sample_buf[0]);
 		free(sample_buf);
@@ -266,22 +267,25 @@ void VDFFAudio::SetInputFormat(VDXWAVEFORMATEX* format)
 		return;
 	}
 
-	swr = swr_alloc();
+	// the layout and rate are the same, only the sample format is converted
+	if (!sample_conv.Init(in_fmt, avctx->sample_fmt, avctx->ch_layout.nb_channels)) {
+		swr = swr_alloc();
 
-	ret = av_opt_set_chlayout(swr, "in_chlayout", &avctx->ch_layout, 0);
-	ret = av_opt_set_int(swr, "in_sample_rate", avctx->sample_rate, 0);
-	ret = av_opt_set_sample_fmt(swr, "in_sample_fmt", in_fmt, 0);
+		ret = av_opt_set_chlayout(swr, "in_chlayout", &avctx->ch_layout, 0);
+		ret = av_opt_set_int(swr, "in_sample_rate", avctx->sample_rate, 0);
+		ret = av_opt_set_sample_fmt(swr, "in_sample_fmt", in_fmt, 0);
 
-	ret = av_opt_set_chlayout(swr, "out_chlayout", &avctx->ch_layout, 0);
-	ret = av_opt_set_int(swr, "out_sample_rate", avctx->sample_rate, 0);
-	ret = av_opt_set_sample_fmt(swr, "out_sample_fmt", avctx->sample_fmt, 0);
+		ret = av_opt_set_chlayout(swr, "out_chlayout", &avctx->ch_layout, 0);
+		ret = av_opt_set_int(swr, "out_sample_rate", avctx->sample_rate, 0);
+		ret = av_opt_set_sample_fmt(swr, "out_sample_fmt", avctx->sample_fmt, 0);
 
-	ret = swr_init(swr);
-	if (ret < 0) {
-		errstr = AVError2Str(ret);
-		mContext.mpCallbacks->SetError("FFMPEG: Audio resampler error (%s).", errstr.c_str());
-		cleanup();
-		return;
+		ret = swr_init(swr);
+		if (ret < 0) {
+			errstr = AVError2Str(ret);
+			mContext.mpCallbacks->SetError("FFMPEG: Audio resampler error (%s).", errstr.c_str());
+			cleanup();
+			return;
+		}
 	}
 
 	frame = av_frame_alloc();
@@ -337,7 +341,11 @@ bool VDFFAudio::Convert(bool flush, bool requireOutput)
 
 	if (in_pos >= frame_size || (in_pos > 0 && flush)) {
 		const uint8_t* src[] = { in_buf };
-		int done_swr = swr_convert(swr, sample_buf, frame_size, src, in_pos);
+		if (sample_conv.IsValid()) {
+			sample_conv.Convert(sample_buf, src, in_pos);
+		} else {
+			swr_convert(swr, sample_buf, frame_size, src, in_pos);
+		}
 
 		frame->pts += frame->nb_samples;
 		frame->nb_samples = in_pos;
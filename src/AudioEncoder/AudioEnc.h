@@ -18,6 +18,7 @@ extern "C" {
 #include <libavcodec/packet.h>
 #include <libswresample/swresample.h>
 }
+#include "../audioconv.h"
 
 struct WAVEFORMATEX_VDFF : public WAVEFORMATEXTENSIBLE {
 	enum AVCodecID codec_id;
@@ -40,6 +41,7 @@ public:
 	AVCodecContext* avctx = nullptr;
 	AVFrame* frame        = nullptr;
 	SwrContext* swr       = nullptr;
+	SampleConverter sample_conv; // instead of swr for trivial conversions
 	uint8_t** sample_buf  = nullptr;
 	uint8_t* in_buf       = nullptr;
 	unsigned frame_size   = 0;
@@ -0,0 +1,456 @@
+/*
+ * Copyright (C) 2026 v0lt
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include "stdafx.h"
+
+#include "AudioPeaks.h"
+#include "Helper.h"
+#include "FileStore.h"
+#include <algorithm>
+#include <cmath>
+
+extern "C"
+{
+#include <libavcodec/avcodec.h>
+}
+
+namespace {
+	constexpr uint32_t kMagic   = 0x4B505641; // 'AVPK'
+	constexpr uint32_t kVersion = 2;
+
+	constexpr int kMaxChannels = 32;
+	constexpr int kMaxEntries = 500;
+
+	struct FileHeader {
+		uint32_t magic;
+		uint32_t version;
+		uint64_t size;
+		uint64_t write_time;
+		int32_t stream;
+		int32_t channels;
+		int64_t time_adjust;
+		int64_t samples;
+		int64_t blocks;
+	};
+
+	int64_t level_size(const int level)
+	{
+		int64_t size = VDFFAudioPeaks::kBlockSize;
+		for (int i = 0; i < level; i++) {
+			size *= VDFFAudioPeaks::kLevelRatio;
+		}
+		return size;
+	}
+
+	int16_t to_int16(const float v)
+	{
+		return (int16_t)std::clamp(std::lround(v * 32767.0f), -32767l, 32767l);
+	}
+
+	std::wstring get_entry_path(const std::wstring& dir, const std::wstring& path, const int stream)
+	{
+		return std::format(L"{}\\{:016x}_{}.bin", dir, VDFFFileStore::HashPath(path), stream);
+	}
+
+	// converts samples of a decoded frame to interleaved float
+	void frame_to_float(const AVFrame* frame, const int channels, std::vector<float>& out)
+	{
+		const AVSampleFormat fmt = (AVSampleFormat)frame->format;
+		const bool planar = av_sample_fmt_is_planar(fmt);
+		const int bps = av_get_bytes_per_sample(fmt);
+		const int count = frame->nb_samples;
+
+		out.resize((size_t)count * channels);
+
+		for (int ch = 0; ch < channels; ch++) {
+			const uint8_t* src = planar ? frame->extended_data[ch] : frame->extended_data[0] + ch * bps;
+			const int step = planar ? bps : bps * channels;
+			float* dst = out.data() + ch;
+
+			switch (av_get_packed_sample_fmt(fmt)) {
+			case AV_SAMPLE_FMT_U8:
+				for (int i = 0; i < count; i++, src += step) {
+					dst[i * channels] = (src[0] - 128) * (1.0f / 128);
+				}
+				break;
+			case AV_SAMPLE_FMT_S16:
+				for (int i = 0; i < count; i++, src += step) {
+					dst[i * channels] = *(const int16_t*)src * (1.0f / 32768);
+				}
+				break;
+			case AV_SAMPLE_FMT_S32:
+				for (int i = 0; i < count; i++, src += step) {
+					dst[i * channels] = *(const int32_t*)src * (1.0f / 2147483648.0f);
+				}
+				break;
+			case AV_SAMPLE_FMT_S64:
+				for (int i = 0; i < count; i++, src += step) {
+					dst[i * channels] = float(*(const int64_t*)src * (1.0 / 9223372036854775808.0));
+				}
+				break;
+			case AV_SAMPLE_FMT_FLT:
+				for (int i = 0; i < count; i++, src += step) {
+					dst[i * channels] = *(const float*)src;
+				}
+				break;
+			case AV_SAMPLE_FMT_DBL:
+				for (int i = 0; i < count; i++, src += step) {
+					dst[i * channels] = (float)*(const double*)src;
+				}
+				break;
+			default:
+				for (int i = 0; i < count; i++) {
+					dst[i * channels] = 0;
+				}
+			}
+		}
+	}
+}
+
+VDFFAudioPeaks::~VDFFAudioPeaks()
+{
+	m_stop = true;
+	if (m_thread.joinable()) {
+		m_thread.join();
+	}
+}
+
+void VDFFAudioPeaks::Start(const std::wstring& path, AVFormatContext* fmt, const int stream, const AVRational time_base, const int64_t time_adjust)
+{
+	m_started = true;
+
+	if (!fmt) {
+		return;
+	}
+	m_thread = std::thread([this, path, fmt, stream, time_base, time_adjust]() {
+		scan(path, fmt, stream, time_base, time_adjust);
+	});
+}
+
+int VDFFAudioPeaks::GetChannels()
+{
+	std::lock_guard lock(m_mutex);
+	return m_channels;
+}
+
+int64_t VDFFAudioPeaks::GetProgress(int64_t* sample_count)
+{
+	std::lock_guard lock(m_mutex);
+	if (sample_count) {
+		*sample_count = m_complete ? m_samples : -1;
+	}
+	return m_samples;
+}
+
+void VDFFAudioPeaks::join_blocks(const int level, const size_t first, const size_t count, Block* out)
+{
+	const std::vector<Block>& v = m_levels[level];
+	for (int ch = 0; ch < m_channels; ch++) {
+		int mn = INT16_MAX, mx = INT16_MIN;
+		double sq = 0;
+		for (size_t i = first; i < first + count; i++) {
+			const Block& b = v[i * m_channels + ch];
+			mn = std::min<int>(mn, b.min);
+			mx = std::max<int>(mx, b.max);
+			sq += double(b.rms) * b.rms;
+		}
+		out[ch] = { (int16_t)mn, (int16_t)mx, (int16_t)std::lround(std::sqrt(sq / count)) };
+	}
+}
+
+void VDFFAudioPeaks::add_block(const int level, const Block* blocks)
+{
+	std::vector<Block>& v = m_levels[level];
+	v.insert(v.end(), blocks, blocks + m_channels);
+
+	const size_t count = v.size() / m_channels;
+	if (level + 1 < kLevels && count % kLevelRatio == 0) {
+		Block joined[kMaxChannels];
+		join_blocks(level, count - kLevelRatio, kLevelRatio, joined);
+		add_block(level + 1, joined);
+	}
+}
+
+void VDFFAudioPeaks::finish()
+{
+	// the last blocks of the coarser levels cover the rest of the stream
+	for (int level = 1; level < kLevels; level++) {
+		const size_t count = m_levels[level - 1].size() / m_channels;
+		const size_t joined = m_levels[level].size() / m_channels * kLevelRatio;
+		if (count > joined) {
+			Block blocks[kMaxChannels];
+			join_blocks(level - 1, joined, count - joined, blocks);
+			m_levels[level].insert(m_levels[level].end(), blocks, blocks + m_channels);
+		}
+	}
+	m_complete = true;
+}
+
+void VDFFAudioPeaks::scan(std::wstring path, AVFormatContext* fmt, const int stream, const AVRational time_base, const int64_t time_adjust)
+{
+	for (unsigned i = 0; i < fmt->nb_streams; i++) {
+		fmt->streams[i]->discard = ((int)i == stream) ? AVDISCARD_DEFAULT : AVDISCARD_ALL;
+	}
+
+	AVCodecContext* avctx = nullptr;
+	const AVCodec* codec = avcodec_find_decoder(fmt->streams[stream]->codecpar->codec_id);
+	if (codec) {
+		avctx = avcodec_alloc_context3(codec);
+	}
+	if (!avctx || avcodec_parameters_to_context(avctx, fmt->streams[stream]->codecpar) < 0 || avcodec_open2(avctx, codec, nullptr) < 0) {
+		avcodec_free_context(&avctx);
+		avformat_close_input(&fmt);
+		return;
+	}
+
+	const int channels = avctx->ch_layout.nb_channels;
+	if (channels < 1 || channels > kMaxChannels) {
+		avcodec_free_context(&avctx);
+		avformat_close_input(&fmt);
+		return;
+	}
+	{
+		std::lock_guard lock(m_mutex);
+		m_channels = channels;
+	}
+
+	AVPacket* pkt = av_packet_alloc();
+	AVFrame* frame = av_frame_alloc();
+	std::vector<float> samples;
+	int64_t pos = AV_NOPTS_VALUE; // of the next frame
+
+	// the block being filled
+	float mn[kMaxChannels], mx[kMaxChannels];
+	double sq[kMaxChannels];
+	int n = 0;
+
+	auto flush_block = [&]() {
+		Block blocks[kMaxChannels];
+		for (int ch = 0; ch < channels; ch++) {
+			blocks[ch] = { to_int16(mn[ch]), to_int16(mx[ch]), to_int16((float)std::sqrt(sq[ch] / n)) };
+		}
+		std::lock_guard lock(m_mutex);
+		add_block(0, blocks);
+		m_samples += n;
+		n = 0;
+	};
+
+	auto add_samples = [&](const float* p, const int count) {
+		for (int i = 0; i < count; i++, p += channels) {
+			if (n == 0) {
+				for (int ch = 0; ch < channels; ch++) {
+					mn[ch] = mx[ch] = p[ch];
+					sq[ch] = 0;
+				}
+			}
+			for (int ch = 0; ch < channels; ch++) {
+				mn[ch] = std::min(mn[ch], p[ch]);
+				mx[ch] = std::max(mx[ch], p[ch]);
+				sq[ch] += double(p[ch]) * p[ch];
+			}
+			if (++n == kBlockSize) {
+				flush_block();
+			}
+		}
+	};
+
+	bool eof = false;
+	bool valid = true;
+	while (!m_stop && valid) {
+		int ret = 0;
+		if (!eof) {
+			ret = av_read_frame(fmt, pkt);
+			if (ret < 0) {
+				eof = true;
+				avcodec_send_packet(avctx, nullptr);
+			}
+			else {
+				if (pkt->stream_index == stream) {
+					avcodec_send_packet(avctx, pkt);
+				}
+				av_packet_unref(pkt);
+			}
+		}
+
+		while (!m_stop) {
+			ret = avcodec_receive_frame(avctx, frame);
+			if (ret < 0) {
+				break;
+			}
+			if (frame->ch_layout.nb_channels != channels) {
+				// the summary can't change the channels
+				valid = false;
+				break;
+			}
+
+			// the position of the first frame as VDFFAudioSource::read_packet finds it, the frames
+			// after it follow without gaps
+			if (pos == AV_NOPTS_VALUE) {
+				pos = 0;
+				if (frame->pts != AV_NOPTS_VALUE) {
+					pos = (frame->pts + time_adjust) * time_base.num / time_base.den;
+				}
+				// the leading silence of the source
+				const std::vector<float> zeros((size_t)kBlockSize * channels);
+				for (int64_t i = 0; i < pos && !m_stop; i += kBlockSize) {
+					add_samples(zeros.data(), (int)std::min<int64_t>(pos - i, kBlockSize));
+				}
+			}
+			// the source ignores the samples before 0
+			const int skip = (int)std::clamp<int64_t>(-pos, 0, frame->nb_samples);
+			pos += frame->nb_samples;
+
+			frame_to_float(frame, channels, samples);
+			add_samples(samples.data() + (size_t)skip * channels, frame->nb_samples - skip);
+			av_frame_unref(frame);
+		}
+
+		if (eof) {
+			break;
+		}
+	}
+
+	av_frame_free(&frame);
+	av_packet_free(&pkt);
+	avcodec_free_context(&avctx);
+	avformat_close_input(&fmt);
+
+	if (m_stop || !valid) {
+		return;
+	}
+	if (n > 0) {
+		flush_block();
+	}
+
+	{
+		std::lock_guard lock(m_mutex);
+		finish();
+	}
+	store(path, stream, time_adjust);
+	DLog(L"VDFFAudioPeaks: stream {}, {} samples", stream, m_samples);
+}
+
+int VDFFAudioPeaks::GetPeaks(int64_t start, int64_t length, int count, IVDFFAudioPeaks::Peak* peaks)
+{
+	std::lock_guard lock(m_mutex);
+	if (!m_channels || count <= 0 || length <= 0 || !peaks) {
+		return 0;
+	}
+
+	// the coarsest level that still has a block per bucket
+	const int64_t bucket = length / count;
+	int level = 0;
+	while (level + 1 < kLevels && level_size(level + 1) <= bucket && !m_levels[level + 1].empty()) {
+		level++;
+	}
+	const int64_t size = level_size(level);
+	const std::vector<Block>& v = m_levels[level];
+	const int64_t blocks = v.size() / m_channels;
+
+	for (int i = 0; i < count; i++) {
+		const int64_t s0 = start + length * i / count;
+		const int64_t s1 = start + length * (i + 1) / count;
+		const int64_t b0 = std::max<int64_t>(s0, 0) / size;
+		const int64_t b1 = std::max((s1 + size - 1) / size, b0 + 1);
+		if (b0 >= blocks) {
+			if (!m_complete) {
+				return i;
+			}
+			// after the end of the stream
+			for (int ch = 0; ch < m_channels; ch++) {
+				peaks[i * m_channels + ch] = {};
+			}
+			continue;
+		}
+		if (b1 > blocks && !m_complete) {
+			return i;
+		}
+
+		for (int ch = 0; ch < m_channels; ch++) {
+			int mn = INT16_MAX, mx = INT16_MIN;
+			double sq = 0;
+			const int64_t end = std::min(b1, blocks);
+			for (int64_t b = b0; b < end; b++) {
+				const Block& blk = v[b * m_channels + ch];
+				mn = std::min<int>(mn, blk.min);
+				mx = std::max<int>(mx, blk.max);
+				sq += double(blk.rms) * blk.rms;
+			}
+			IVDFFAudioPeaks::Peak& pk = peaks[i * m_channels + ch];
+			pk.min = mn / 32767.0f;
+			pk.max = mx / 32767.0f;
+			pk.rms = float(std::sqrt(sq / double(end - b0)) / 32767.0);
+		}
+	}
+
+	return count;
+}
+
+bool VDFFAudioPeaks::Load(const std::wstring& path, const int stream, const int64_t time_adjust)
+{
+	const std::wstring dir = VDFFFileStore::GetDir(L"peaks");
+	uint64_t size, write_time;
+	if (dir.empty() || !VDFFFileStore::GetFileStamp(path.c_str(), size, write_time)) {
+		return false;
+	}
+
+	HANDLE h = CreateFileW(get_entry_path(dir, path, stream).c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (h == INVALID_HANDLE_VALUE) {
+		return false;
+	}
+
+	bool ret = false;
+	FileHeader hdr = {};
+	DWORD read = 0;
+	if (ReadFile(h, &hdr, sizeof(hdr), &read, nullptr) && read == sizeof(hdr)
+			&& hdr.magic == kMagic && hdr.version == kVersion && hdr.size == size && hdr.write_time == write_time
+			&& hdr.stream == stream && hdr.time_adjust == time_adjust && hdr.channels > 0 && hdr.channels <= kMaxChannels
+			&& hdr.blocks >= 0 && hdr.blocks * hdr.channels < INT32_MAX / (int)sizeof(Block)) {
+		std::vector<Block> blocks((size_t)(hdr.blocks * hdr.channels));
+		const DWORD bytes = DWORD(blocks.size() * sizeof(Block));
+		if (ReadFile(h, blocks.data(), bytes, &read, nullptr) && read == bytes) {
+			std::lock_guard lock(m_mutex);
+			m_channels = hdr.channels;
+			for (int64_t i = 0; i < hdr.blocks; i++) {
+				add_block(0, &blocks[i * m_channels]);
+			}
+			m_samples = hdr.samples;
+			finish();
+			m_started = true;
+			ret = true;
+		}
+	}
+	CloseHandle(h);
+
+	return ret;
+}
+
+void VDFFAudioPeaks::store(const std::wstring& path, const int stream, const int64_t time_adjust)
+{
+	const std::wstring dir = VDFFFileStore::GetDir(L"peaks");
+	FileHeader hdr = { kMagic, kVersion };
+	if (dir.empty() || !VDFFFileStore::GetFileStamp(path.c_str(), hdr.size, hdr.write_time)) {
+		return;
+	}
+
+	// the header and the blocks of the finest level, the coarser levels are joined on load
+	std::vector<uint8_t> data;
+	{
+		std::lock_guard lock(m_mutex);
+		hdr.stream = stream;
+		hdr.time_adjust = time_adjust;
+		hdr.channels = m_channels;
+		hdr.samples = m_samples;
+		hdr.blocks = m_levels[0].size() / m_channels;
+
+		data.resize(sizeof(hdr) + m_levels[0].size() * sizeof(Block));
+		memcpy(data.data(), &hdr, sizeof(hdr));
+		memcpy(data.data() + sizeof(hdr), m_levels[0].data(), m_levels[0].size() * sizeof(Block));
+	}
+	if (VDFFFileStore::StoreFile(get_entry_path(dir, path, stream), data.data(), data.size())) {
+		VDFFFileStore::Trim(dir, L"*.bin", kMaxEntries);
+	}
+}
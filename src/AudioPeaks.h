@@ -0,0 +1,93 @@
+/*
+ * Copyright (C) 2026 v0lt
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#pragma once
+
+#include <vd2/plugin/vdinputdriver.h>
+#include <string>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <atomic>
+
+extern "C"
+{
+#include <libavformat/avformat.h>
+}
+
+// Peak summary of an audio stream for drawing waveforms.
+// Available to hosts from the audio source with AsInterface(IVDFFAudioPeaks::kIID), the plugin
+// itself does not draw waveforms.
+// Sample positions are those of IVDXAudioSource::Read: the leading silence of a stream that
+// starts after the video is part of the summary.
+// The first call starts a background scan of the stream, the result is stored
+// in %LOCALAPPDATA%\avlib\peaks and loaded when the file is opened again.
+
+class IVDFFAudioPeaks : public IVDXUnknown
+{
+public:
+	enum { kIID = VDXMAKEFOURCC('F', 'F', 'p', 'k') };
+
+	struct Peak {
+		float min;
+		float max;
+		float rms;
+	};
+
+	// number of channels of the summary, 0 if the stream can't be summarized
+	virtual int VDXAPIENTRY GetPeakChannels() = 0;
+	// number of samples summarized so far, sample_count is set to the length of the stream
+	// (known only when the scan is complete, -1 before)
+	virtual int64_t VDXAPIENTRY GetPeakProgress(int64_t* sample_count) = 0;
+	// fills peaks[count * channels], bucket i covers samples [start + length * i / count, start + length * (i + 1) / count).
+	// Returns the number of buckets that are summarized.
+	virtual int VDXAPIENTRY GetPeaks(int64_t start, int64_t length, int count, Peak* peaks) = 0;
+};
+
+class VDFFAudioPeaks
+{
+public:
+	// samples of a block of the finest level, each coarser level joins kLevelRatio blocks
+	enum { kBlockSize = 512, kLevelRatio = 8, kLevels = 4 };
+
+	VDFFAudioPeaks() = default;
+	~VDFFAudioPeaks();
+
+	VDFFAudioPeaks(const VDFFAudioPeaks&) = delete;
+	VDFFAudioPeaks& operator=(const VDFFAudioPeaks&) = delete;
+
+	// loads the stored summary of the unchanged file
+	bool Load(const std::wstring& path, const int stream, const int64_t time_adjust);
+	// takes ownership of fmt (a separate context of the file) and starts the scan.
+	// The first frame starts at sample (pts + time_adjust) * time_base, as in VDFFAudioSource.
+	void Start(const std::wstring& path, AVFormatContext* fmt, const int stream, const AVRational time_base, const int64_t time_adjust);
+	bool IsStarted() const { return m_started; }
+
+	int GetChannels();
+	int64_t GetProgress(int64_t* sample_count);
+	int GetPeaks(int64_t start, int64_t length, int count, IVDFFAudioPeaks::Peak* peaks);
+
+private:
+	struct Block {
+		int16_t min, max, rms; // scaled by 32767
+	};
+
+	std::thread m_thread;
+	std::atomic<bool> m_stop = false;
+	bool m_started = false;
+
+	std::mutex m_mutex; // guards everything below
+	int m_channels = 0;
+	int64_t m_samples = 0; // summarized samples
+	bool m_complete = false;
+	std::vector<Block> m_levels[kLevels]; // blocks of all channels, interleaved
+
+	void scan(std::wstring path, AVFormatContext* fmt, const int stream, const AVRational time_base, const int64_t time_adjust);
+	void join_blocks(const int level, const size_t first, const size_t count, Block* out);
+	void add_block(const int level, const Block* blocks);
+	void finish();
+	void store(const std::wstring& path, const int stream, const int64_t time_adjust);
+};
@@ -0,0 +1,98 @@
+/*
+ * Copyright (C) 2026 v0lt
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include "stdafx.h"
+
+#include "AudioSeekTable.h"
+#include "Helper.h"
+#include <algorithm>
+
+VDFFAudioSeekTable::~VDFFAudioSeekTable()
+{
+	m_stop = true;
+	if (m_thread.joinable()) {
+		m_thread.join();
+	}
+}
+
+void VDFFAudioSeekTable::Build(AVFormatContext* fmt, const int stream)
+{
+	m_thread = std::thread([this, fmt, stream]() {
+		scan(fmt, stream);
+	});
+}
+
+void VDFFAudioSeekTable::scan(AVFormatContext* fmt, const int stream)
+{
+	for (unsigned i = 0; i < fmt->nb_streams; i++) {
+		fmt->streams[i]->discard = ((int)i == stream) ? AVDISCARD_DEFAULT : AVDISCARD_ALL;
+	}
+
+	std::unique_ptr<AVPacket, std::function<void(AVPacket*)>> pkt{ av_packet_alloc(), [](AVPacket* p) { av_packet_free(&p); } };
+
+	bool valid = true;
+	int64_t pts = AV_NOPTS_VALUE;
+
+	while (!m_stop) {
+		if (av_read_frame(fmt, pkt.get()) < 0) {
+			break;
+		}
+		if (pkt->stream_index != stream) {
+			av_packet_unref(pkt.get());
+			continue;
+		}
+		if (pkt->duration <= 0) {
+			// timestamps can't be accumulated
+			valid = false;
+			break;
+		}
+
+		if (pts == AV_NOPTS_VALUE) {
+			pts = pkt->pts;
+			if (pts == AV_NOPTS_VALUE) {
+				const int64_t start_time = fmt->streams[stream]->start_time;
+				pts = (start_time != AV_NOPTS_VALUE) ? start_time : 0;
+			}
+		}
+		// several packets can be taken from one block of the file, only the first one is stored
+		if (pkt->pos >= 0 && (m_entries.empty() || pkt->pos > m_entries.back().pos)) {
+			m_entries.push_back({ pkt->pos, pts });
+		}
+		pts += pkt->duration;
+
+		av_packet_unref(pkt.get());
+	}
+
+	avformat_close_input(&fmt);
+
+	if (valid && !m_stop && !m_entries.empty()) {
+		m_entries.shrink_to_fit();
+		DLog(L"VDFFAudioSeekTable: stream {}, {} entries", stream, m_entries.size());
+		m_ready = true;
+	}
+}
+
+const VDFFAudioSeekTable::Entry* VDFFAudioSeekTable::FindPts(const int64_t pts) const
+{
+	auto it = std::upper_bound(m_entries.begin(), m_entries.end(), pts, [](const int64_t v, const Entry& e) {
+		return v < e.pts;
+	});
+	if (it == m_entries.begin()) {
+		return nullptr;
+	}
+	return &*std::prev(it);
+}
+
+const VDFFAudioSeekTable::Entry* VDFFAudioSeekTable::FindPos(const int64_t pos) const
+{
+	auto it = std::lower_bound(m_entries.begin(), m_entries.end(), pos, [](const Entry& e, const int64_t v) {
+		return e.pos < v;
+	});
+	if (it == m_entries.end() || it->pos != pos) {
+		return nullptr;
+	}
+	return &*it;
+}
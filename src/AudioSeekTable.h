@@ -0,0 +1,55 @@
+/*
+ * Copyright (C) 2026 v0lt
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#pragma once
+
+#include <vector>
+#include <thread>
+#include <atomic>
+
+extern "C"
+{
+#include <libavformat/avformat.h>
+}
+
+// Table of packet positions and timestamps of one audio stream.
+// It is built in the background by reading the whole stream once. The timestamps are
+// accumulated from packet durations, so they are exact even if the demuxer only
+// estimates them after a seek (VBR MP3, ADTS AAC, Ogg without an index).
+
+class VDFFAudioSeekTable
+{
+public:
+	struct Entry {
+		int64_t pos; // byte position of the first packet that starts there
+		int64_t pts; // stream time base
+	};
+
+	VDFFAudioSeekTable() = default;
+	~VDFFAudioSeekTable();
+
+	VDFFAudioSeekTable(const VDFFAudioSeekTable&) = delete;
+	VDFFAudioSeekTable& operator=(const VDFFAudioSeekTable&) = delete;
+
+	// takes ownership of fmt (a separate context of the same file) and starts the scan
+	void Build(AVFormatContext* fmt, const int stream);
+
+	// true when the scan is complete and the table can be used
+	bool IsReady() const { return m_ready; }
+
+	// last entry with entry.pts <= pts, nullptr if there is none
+	const Entry* FindPts(const int64_t pts) const;
+	// entry with entry.pos == pos, nullptr if there is none
+	const Entry* FindPos(const int64_t pos) const;
+
+private:
+	std::thread m_thread;
+	std::atomic<bool> m_stop = false;
+	std::atomic<bool> m_ready = false;
+	std::vector<Entry> m_entries; // sorted by pos and pts, written only by the scan
+
+	void scan(AVFormatContext* fmt, const int stream);
+};
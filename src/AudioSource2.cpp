@@ -20,6 +20,7 @@ VDFFAudioSource::VDFFAudioSource(const VDXInputDriverContext& context)
 
 VDFFAudioSource::~VDFFAudioSource()
 {
+	stop_decode_ahead();
 	if (m_pFrame) {
 		av_frame_free(&m_pFrame);
 	}
@@ -29,11 +30,8 @@ VDFFAudioSource::~VDFFAudioSource()
 	if (m_pSwrCtx) {
 		swr_free(&m_pSwrCtx);
 	}
-	if (m_pFormatCtx) {
-		avformat_close_input(&m_pFormatCtx);
-	}
-	for (auto& page : buffer) {
-		free(page.aud_data);
+	if (m_pDemuxer) {
+		m_pDemuxer->Detach(m_client);
 	}
 }
 
@@ -51,10 +49,46 @@ void* VDXAPIENTRY VDFFAudioSource::AsInterface(uint32_t iid)
 {
 	if (iid == IVDXAudioSource::kIID)
 		return static_cast<IVDXAudioSource*>(this);
+	if (iid == IVDFFAudioPeaks::kIID)
+		return static_cast<IVDFFAudioPeaks*>(this);
 
 	return vdxunknown<IVDXStreamSource>::AsInterface(iid);
 }
 
+void VDFFAudioSource::start_peaks()
+{
+	if (m_peaks.IsStarted()) {
+		return;
+	}
+	// the summary uses the sample positions of Read
+	if (start_time == AV_NOPTS_VALUE) {
+		stop_decode_ahead();
+		init_start_time();
+	}
+	if (!m_peaks.Load(m_pSource->m_path, m_streamIndex, time_adjust)) {
+		// the stream is read once more by its own context, the sources are not disturbed
+		m_peaks.Start(m_pSource->m_path, m_pDemuxer->OpenClone(), m_streamIndex, time_base, time_adjust);
+	}
+}
+
+int VDFFAudioSource::GetPeakChannels()
+{
+	start_peaks();
+	return m_peaks.GetChannels();
+}
+
+int64_t VDFFAudioSource::GetPeakProgress(int64_t* sample_count)
+{
+	start_peaks();
+	return m_peaks.GetProgress(sample_count);
+}
+
+int VDFFAudioSource::GetPeaks(int64_t start, int64_t length, int count, Peak* peaks)
+{
+	start_peaks();
+	return m_peaks.GetPeaks(start, length, count, peaks);
+}
+
 uint64_t GetChannelLayout(AVCodecContext* pCodecCtx)
 {
 	if (pCodecCtx->ch_layout.order == AV_CHANNEL_ORDER_NATIVE) {
@@ -71,8 +105,11 @@ uint64_t GetChannelLayout(AVCodecContext* pCodecCtx)
 
 int VDFFAudioSource::initStream(VDFFInputFile* pSource, int streamIndex)
 {
-	m_pFormatCtx = OpenAudioFile(pSource->m_path, streamIndex);
-	if (!m_pFormatCtx) {
+	// packets come from the demuxer shared with the video source
+	m_pDemuxer = pSource->m_demuxer;
+	m_pFormatCtx = pSource->getContext();
+	m_client = m_pDemuxer->Attach(streamIndex);
+	if (!m_client) {
 		return -1;
 	}
 
@@ -139,17 +176,25 @@ int VDFFAudioSource::initStream(VDFFInputFile* pSource, int streamIndex)
 		// works for MKV and FLV
 		const AVIndexEntry* ie = avformat_index_get_entry(m_pStream, nb_index_entries - 1);
 		if (ie) {
-			seek_frame(m_pFormatCtx, m_streamIndex, ie->pos, AVSEEK_FLAG_BACKWARD);
-			seek_frame(m_pFormatCtx, m_streamIndex, AV_SEEK_START, AVSEEK_FLAG_BACKWARD);
-			// get the number of index entries again
-			nb_index_entries = avformat_index_get_entries_count(m_pStream);
+			m_pDemuxer->Seek(m_client, ie->pos, AVSEEK_FLAG_BACKWARD);
+			// the seek may be done by another reader of the demuxer, check its index
+			AVStream* st = m_pDemuxer->GetStream(m_client);
+			nb_index_entries = avformat_index_get_entries_count(st);
+			for (int i = 0; i < nb_index_entries; i++) {
+				if (avformat_index_get_entry(st, i)->flags & AVINDEX_KEYFRAME) {
+					use_keys = true;
+					break;
+				}
+			}
+			m_pDemuxer->Seek(m_client, AV_SEEK_START, AVSEEK_FLAG_BACKWARD);
 		}
 	}
-
-	for (int i = 0; i < nb_index_entries; i++) {
-		if (avformat_index_get_entry(m_pStream, i)->flags & AVINDEX_KEYFRAME) {
-			use_keys = true;
-			break;
+	else {
+		for (int i = 0; i < nb_index_entries; i++) {
+			if (avformat_index_get_entry(m_pStream, i)->flags & AVINDEX_KEYFRAME) {
+				use_keys = true;
+				break;
+			}
 		}
 	}
 
@@ -176,52 +221,12 @@ int VDFFAudioSource::initStream(VDFFInputFile* pSource, int streamIndex)
 
 	m_pFrame = av_frame_alloc();
 
-	first_page     = 0;
-	last_page      = 0;
-	used_pages     = 0;
-	used_pages_max = 1024;
-	size_t buffer_size = (int)((sample_count + BufferPage::size - 1) / BufferPage::size);
-	buffer.clear();
-	buffer.resize(buffer_size);
-
 	next_sample = AV_NOPTS_VALUE;
 	SetTargetFormat(0);
 
 	return 0;
 }
 
-AVFormatContext* VDFFAudioSource::OpenAudioFile(std::wstring_view path, int streamIndex)
-{
-	assert(streamIndex >= 0);
-
-	std::string ff_path = ConvertWideToUtf8(path);
-
-	AVFormatContext* fmt = nullptr;
-	int err = avformat_open_input(&fmt, ff_path.c_str(), nullptr, nullptr);
-	if (err < 0) {
-		mContext.mpCallbacks->SetError("FFMPEG open failure:\n%s", get_last_av_error().c_str());
-		return nullptr;
-	}
-
-	err = avformat_find_stream_info(fmt, nullptr);
-	if (err < 0) {
-		mContext.mpCallbacks->SetError("FFMPEG: Couldn't find stream information of file.");
-		avformat_close_input(&fmt);
-		return nullptr;
-	}
-
-	// disable unwanted streams
-	for (int i = 0; i < (int)fmt->nb_streams; i++) {
-		if (i == streamIndex) {
-			continue;
-		}
-		// this has minor impact on performance, ~10% for video
-		fmt->streams[i]->discard = AVDISCARD_ALL;
-	}
-
-	return fmt;
-}
-
 void VDFFAudioSource::SetTargetFormat(const VDXWAVEFORMATEX* target)
 {
 	const uint64_t in_layout = GetChannelLayout(m_pCodecCtx);
@@ -267,6 +272,8 @@ void VDFFAudioSource::SetTargetFormat(const VDXWAVEFORMATEX* target)
 		return;
 	}
 
+	stop_decode_ahead();
+
 	out_layout = layout;
 	out_fmt = fmt;
 
@@ -325,10 +332,17 @@ int VDFFAudioSource::reset_swr()
 	if (m_pSwrCtx) {
 		swr_free(&m_pSwrCtx);
 	}
-	m_pSwrCtx = swr_alloc();
 
 	const int in_ch = av_popcount64(in_layout);
 	const int out_ch = av_popcount64(out_layout);
+
+	// without downmix the resampler is not needed
+	if (in_layout == out_layout && m_sampleconv.Init(m_pCodecCtx->sample_fmt, out_fmt, out_ch)) {
+		return 0;
+	}
+	m_sampleconv.Reset();
+
+	m_pSwrCtx = swr_alloc();
 	const AVChannelLayout in_ch_layout = { AV_CHANNEL_ORDER_NATIVE, in_ch, in_layout };
 	const AVChannelLayout out_ch_layout = { AV_CHANNEL_ORDER_NATIVE, out_ch, out_layout };
 
@@ -352,20 +366,15 @@ int VDFFAudioSource::reset_swr()
 void VDFFAudioSource::init_start_time()
 {
 	int64_t first_pts = AV_NOPTS_VALUE;
-	while (1) {
-		std::unique_ptr<AVPacket, std::function<void(AVPacket*)>> pkt{ av_packet_alloc(), [](AVPacket* p) { av_packet_free(&p); } };
-		
-		int ret = av_read_frame(m_pFormatCtx, pkt.get());
-		if (ret < 0) {
-			break;
-		}
-		if (pkt->stream_index == m_streamIndex) {
-			first_pts = pkt->pts;
-			av_packet_unref(pkt.get());
-			break;
-		}
+	std::unique_ptr<AVPacket, std::function<void(AVPacket*)>> pkt{ av_packet_alloc(), [](AVPacket* p) { av_packet_free(&p); } };
+
+	// the shared reader can be anywhere, the following Read will seek anyway
+	m_pDemuxer->Seek(m_client, AV_SEEK_START, AVSEEK_FLAG_BACKWARD);
+	if (m_pDemuxer->ReadPacket(m_client, pkt.get()) == 0) {
+		first_pts = pkt->pts;
 		av_packet_unref(pkt.get());
 	}
+	next_sample = AV_NOPTS_VALUE;
 
 	start_time = m_pStream->start_time;
 	if (start_time == AV_NOPTS_VALUE) {
@@ -420,14 +429,13 @@ bool VDFFAudioSource::Read(int64_t start, uint32_t count, void* lpBuffer, uint32
 		return false;
 	}
 
+	stop_decode_ahead();
+
 	if (start_time == AV_NOPTS_VALUE) {
 		init_start_time();
 	}
 
-	int px = (int)(start / BufferPage::size);
-	int s0 = start % BufferPage::size;
-
-	if (px < 0 || px >= (int)buffer.size()) {
+	if (start < 0 || start >= sample_count) {
 		*lBytesRead = 0;
 		*lSamplesRead = 0;
 		return false;
@@ -453,25 +461,41 @@ bool VDFFAudioSource::Read(int64_t start, uint32_t count, void* lpBuffer, uint32
 		}
 	}
 
-	int n = buffer[px].copy(s0, count, lpBuffer, mRawFormat.Format.nBlockAlign);
+	const bool sequential = (start == m_read_end);
+
+	int n = m_cache.Copy(start, count, lpBuffer);
 	if (n > 0) {
 		*lBytesRead = n * mRawFormat.Format.nBlockAlign;
 		*lSamplesRead = n;
+		m_read_end = start + n;
+		if (sequential) {
+			start_decode_ahead();
+		}
 		return true;
 	}
 
+	if (m_pDemuxer->TakeResync(m_client)) {
+		// packets were lost while the shared reader served other streams
+		next_sample = AV_NOPTS_VALUE;
+	}
+
 	if (next_sample == AV_NOPTS_VALUE || start > next_sample + m_pCodecCtx->sample_rate || start < next_sample) {
 		// required to seek
-		discard_samples = int(start >= 4096 ? 4096 : start);
-		int64_t pos = (start - discard_samples) * time_base.den / time_base.num - time_adjust;
-		if (start == 0) {
-			pos = AV_SEEK_START;
-			discard_samples = 0;
-		}
 		avcodec_flush_buffers(m_pCodecCtx);
-		int flags = use_keys ? 0 : AVSEEK_FLAG_ANY;
-		seek_frame(m_pFormatCtx, m_streamIndex, pos, AVSEEK_FLAG_BACKWARD | flags);
+		if (!seek_exact(start)) {
+			discard_samples = int(start >= 4096 ? 4096 : start);
+			int64_t pos = (start - discard_samples) * time_base.den / time_base.num - time_adjust;
+			if (start == 0) {
+				pos = AV_SEEK_START;
+				discard_samples = 0;
+			}
+			int flags = use_keys ? 0 : AVSEEK_FLAG_ANY;
+			m_pDemuxer->Seek(m_client, pos, AVSEEK_FLAG_BACKWARD | flags);
+			m_table_pts = AV_NOPTS_VALUE;
+			m_preroll_end = -1;
+		}
 		next_sample = AV_NOPTS_VALUE;
+		m_stream_end = false;
 	}
 
 	std::unique_ptr<AVPacket, std::function<void(AVPacket*)>> pkt{ av_packet_alloc(), [](AVPacket* p) { av_packet_free(&p); } };
@@ -479,35 +503,13 @@ bool VDFFAudioSource::Read(int64_t start, uint32_t count, void* lpBuffer, uint32
 	ReadInfo ri;
 
 	while (1) {
-		int ret = av_read_frame(m_pFormatCtx, pkt.get());
+		int ret = decode_packet(pkt.get(), ri);
 		if (ret < 0) {
 			// typically end of stream
 			// may result from inexact sample_count too
 			//insert_silence(start,count);
 			ri.last_sample = start;
 		}
-		else {
-			if (pkt->stream_index != m_streamIndex) {
-				av_packet_unref(pkt.get());
-				continue;
-			}
-
-			auto pkt_data_orig = pkt->data;
-			auto pkt_size_orig = pkt->size;
-
-			do {
-				int s = read_packet(pkt.get(), ri);
-				if (s < 0) {
-					break;
-				}
-				pkt->data += s;
-				pkt->size -= s;
-			} while (pkt->size > 0);
-
-			pkt->data = pkt_data_orig;
-			pkt->size = pkt_size_orig;
-			av_packet_unref(pkt.get());
-		}
 
 		if (ri.last_sample < start) {
 			continue;
@@ -521,20 +523,19 @@ bool VDFFAudioSource::Read(int64_t start, uint32_t count, void* lpBuffer, uint32
 			}
 		}
 
-		n = buffer[px].copy(s0, count, lpBuffer, mRawFormat.Format.nBlockAlign);
-		if (n > 0) {
-			*lBytesRead = n * mRawFormat.Format.nBlockAlign;
-			*lSamplesRead = n;
-			return true;
-		}
-		else {
+		n = m_cache.Copy(start, count, lpBuffer);
+		if (n <= 0) {
 			// seek/decode missed required sample
-			n = buffer[px].empty(s0, count);
+			n = m_cache.Missing(start, count);
 			write_silence(lpBuffer, n);
-			*lBytesRead = n * mRawFormat.Format.nBlockAlign;
-			*lSamplesRead = n;
-			return true;
 		}
+		*lBytesRead = n * mRawFormat.Format.nBlockAlign;
+		*lSamplesRead = n;
+		m_read_end = start + n;
+		if (sequential) {
+			start_decode_ahead();
+		}
+		return true;
 	}
 
 	*lBytesRead = 0;
@@ -542,64 +543,185 @@ bool VDFFAudioSource::Read(int64_t start, uint32_t count, void* lpBuffer, uint32
 	return false;
 }
 
-void VDFFAudioSource::write_silence(void* dst, uint32_t count)
+int VDFFAudioSource::decode_packet(AVPacket* pkt, ReadInfo& ri)
 {
-	int src = mRawFormat.Format.wBitsPerSample == 8 ? 0x80 : 0;
-	memset(dst, src, count * mRawFormat.Format.nBlockAlign);
+	while (1) {
+		int ret = m_pDemuxer->ReadPacket(m_client, pkt);
+		if (ret < 0) {
+			m_stream_end = true;
+			return ret;
+		}
+		if (pkt->stream_index != m_streamIndex) {
+			av_packet_unref(pkt);
+			continue;
+		}
+
+		if (m_table_pts != AV_NOPTS_VALUE) {
+			// timestamps after a byte seek are not reliable, they continue from the seek table
+			if (pkt->pos >= 0 && pkt->pos != m_table_pos) {
+				const VDFFAudioSeekTable::Entry* e = m_seek_table->FindPos(pkt->pos);
+				if (e) {
+					m_table_pts = e->pts;
+				}
+				else if (m_table_pos < 0) {
+					// the demuxer did not stop at the position of the table
+					m_table_pts = AV_NOPTS_VALUE;
+				}
+				m_table_pos = pkt->pos;
+			}
+			if (m_table_pts != AV_NOPTS_VALUE && pkt->duration > 0) {
+				pkt->pts = m_table_pts;
+				pkt->dts = m_table_pts;
+				m_table_pts += pkt->duration;
+			}
+			else {
+				m_table_pts = AV_NOPTS_VALUE;
+			}
+		}
+
+		auto pkt_data_orig = pkt->data;
+		auto pkt_size_orig = pkt->size;
+
+		do {
+			int s = read_packet(pkt, ri);
+			if (s < 0) {
+				break;
+			}
+			pkt->data += s;
+			pkt->size -= s;
+		} while (pkt->size > 0);
+
+		pkt->data = pkt_data_orig;
+		pkt->size = pkt_size_orig;
+		av_packet_unref(pkt);
+
+		return 0;
+	}
 }
 
-void VDFFAudioSource::insert_silence(int64_t start, uint32_t count)
+// samples to decode before the target so that the decoder output is complete
+static int get_preroll(const AVCodecID codec_id, const int sample_rate)
 {
-	while (count) {
-		int px = (int)(start / BufferPage::size);
-		int s0 = start % BufferPage::size;
+	switch (codec_id) {
+	case AV_CODEC_ID_PCM_S16LE:
+	case AV_CODEC_ID_PCM_S16BE:
+	case AV_CODEC_ID_PCM_S24LE:
+	case AV_CODEC_ID_PCM_S24BE:
+	case AV_CODEC_ID_PCM_S32LE:
+	case AV_CODEC_ID_PCM_F32LE:
+	case AV_CODEC_ID_PCM_U8:
+	case AV_CODEC_ID_FLAC:
+	case AV_CODEC_ID_ALAC:
+	case AV_CODEC_ID_WAVPACK:
+		return 0;
+	case AV_CODEC_ID_MP1:
+	case AV_CODEC_ID_MP2:
+	case AV_CODEC_ID_MP3:
+		return 2 * 1152; // bit reservoir and overlap
+	case AV_CODEC_ID_AAC:
+		return 2 * 1024;
+	case AV_CODEC_ID_AC3:
+	case AV_CODEC_ID_EAC3:
+		return 1536;
+	case AV_CODEC_ID_OPUS:
+		return sample_rate * 80 / 1000; // recommended by RFC 7845
+	case AV_CODEC_ID_VORBIS:
+		return 2 * 2048;
+	default:
+		return 4096;
+	}
+}
 
-		if (px >= (int)buffer.size()) {
-			break;
+bool VDFFAudioSource::seek_exact(int64_t start)
+{
+	if (start == 0 || use_keys) {
+		return false;
+	}
+	if (!m_seek_table) {
+		// built once the stream is sought, until then the demuxer seeks by itself
+		m_seek_table = std::make_unique<VDFFAudioSeekTable>();
+		AVFormatContext* fmt = m_pDemuxer->OpenClone();
+		if (fmt) {
+			m_seek_table->Build(fmt, m_streamIndex);
 		}
-		alloc_page(px);
-		BufferPage& bp = buffer[px];
+		return false;
+	}
+	if (!m_seek_table->IsReady()) {
+		return false;
+	}
 
-		int changed = 0;
-		int n = bp.alloc(s0, count, changed);
-		if (changed) {
-			uint8_t* dst = bp.aud_data + s0 * mRawFormat.Format.nBlockAlign;
-			write_silence(dst, n);
+	const int preroll = get_preroll(m_pCodecCtx->codec_id, m_pCodecCtx->sample_rate);
+	const int64_t target = (start - preroll) * time_base.den / time_base.num - time_adjust;
+	const VDFFAudioSeekTable::Entry* e = m_seek_table->FindPts(target);
+	if (!e) {
+		return false;
+	}
+	if (m_pDemuxer->Seek(m_client, e->pos, AVSEEK_FLAG_BYTE) < 0) {
+		return false;
+	}
+
+	discard_samples = 0;
+	m_table_pts = e->pts;
+	m_table_pos = -1;
+	m_preroll_end = (e->pts + time_adjust) * time_base.num / time_base.den + preroll;
+
+	return true;
+}
+
+void VDFFAudioSource::start_decode_ahead()
+{
+	if (next_sample == AV_NOPTS_VALUE || m_stream_end) {
+		return;
+	}
+	// about one second ahead of the host, a new job starts when half of it is used up
+	const int64_t lead = m_pCodecCtx->sample_rate;
+	if (next_sample >= m_read_end + lead / 2 || next_sample >= sample_count) {
+		return;
+	}
+	const int64_t target = std::min(m_read_end + lead, sample_count);
+
+	m_ahead_stop = false;
+	m_decode_ahead = std::async(std::launch::async, [this, target]() {
+		std::unique_ptr<AVPacket, std::function<void(AVPacket*)>> pkt{ av_packet_alloc(), [](AVPacket* p) { av_packet_free(&p); } };
+		ReadInfo ri;
+		while (!m_ahead_stop && next_sample != AV_NOPTS_VALUE && next_sample < target) {
+			if (m_pDemuxer->TakeResync(m_client)) {
+				// Read has to seek, the decoded samples would not continue the cached ones
+				next_sample = AV_NOPTS_VALUE;
+				break;
+			}
+			if (decode_packet(pkt.get(), ri) < 0) {
+				break;
+			}
 		}
+	});
+}
 
-		start += n;
-		count -= n;
+void VDFFAudioSource::stop_decode_ahead()
+{
+	if (m_decode_ahead.valid()) {
+		m_ahead_stop = true;
+		m_decode_ahead.get();
 	}
 }
 
-void VDFFAudioSource::invalidate(int64_t start, uint32_t count)
+void VDFFAudioSource::write_silence(void* dst, uint32_t count)
 {
-	while (count) {
-		int px = (int)(start / BufferPage::size);
-		int s0 = start % BufferPage::size;
+	int src = mRawFormat.Format.wBitsPerSample == 8 ? 0x80 : 0;
+	memset(dst, src, count * mRawFormat.Format.nBlockAlign);
+}
 
-		if (px >= (int)buffer.size()) {
+void VDFFAudioSource::insert_silence(int64_t start, uint32_t count)
+{
+	while (count) {
+		int n;
+		bool changed;
+		uint8_t* dst = m_cache.Alloc(start, count, n, changed);
+		if (!dst) {
 			break;
 		}
-		BufferPage& bp = buffer[px];
-		int n = s0 + count < BufferPage::size ? count : BufferPage::size - s0;
-		if (bp.a0 && s0 <= bp.a0) {
-			bp.a0 = 0;
-			bp.a1 = 0;
-			bp.b0 = 0;
-			bp.b1 = 0;
-		}
-		else if (s0 < bp.a1) {
-			bp.a1 = s0;
-			bp.b0 = 0;
-			bp.b1 = 0;
-		}
-		else if (bp.b0 && s0 <= bp.b0) {
-			bp.b0 = 0;
-			bp.b1 = 0;
-		}
-		else if (s0 < bp.b1) {
-			bp.b1 = s0;
+		if (changed) {
+			write_silence(dst, n);
 		}
 
 		start += n;
@@ -660,6 +782,14 @@ int VDFFAudioSource::read_packet(AVPacket* pkt, ReadInfo& ri)
 			}
 		}
 
+		// decoder warm-up after a seek by the table
+		if (start < m_preroll_end) {
+			const int n = (int)std::min<int64_t>(m_preroll_end - start, count);
+			src_pos += n;
+			start += n;
+			count -= n;
+		}
+
 		// ignore samples before start
 		if (start < 0) {
 			int64_t n = -start;
@@ -703,21 +833,22 @@ int VDFFAudioSource::read_packet(AVPacket* pkt, ReadInfo& ri)
 		}
 
 		while (count) {
-			int px = (int)(start / BufferPage::size);
-			int s0 = start % BufferPage::size;
-
-			alloc_page(px);
-			BufferPage& bp = buffer[px];
-
-			int changed = 0;
-			int n = bp.alloc(s0, count, changed);
+			int n;
+			bool changed;
+			uint8_t* dst = m_cache.Alloc(start, count, n, changed);
+			if (!dst) {
+				break;
+			}
 			if (changed) {
-				uint8_t* dst = bp.aud_data + s0 * mRawFormat.Format.nBlockAlign;
 				const uint8_t* src[32];
 				for (int i = 0; i < m_pFrame->ch_layout.nb_channels; i++) {
 					src[i] = m_pFrame->extended_data[i] + src_pos * src_linesize;
 				}
-				swr_convert(m_pSwrCtx, &dst, n, src, n);
+				if (m_sampleconv.IsValid()) {
+					m_sampleconv.Convert(&dst, src, n);
+				} else {
+					swr_convert(m_pSwrCtx, &dst, n, src, n);
+				}
 			}
 
 			src_pos += n;
@@ -730,7 +861,7 @@ int VDFFAudioSource::read_packet(AVPacket* pkt, ReadInfo& ri)
 		// we cannot reliably join cached regions
 		// so create gap to force to continue decoding
 		if (!trust_sample_pos && next_sample > 0) {
-			invalidate(next_sample, 1);
+			m_cache.Invalidate(next_sample, 1);
 		}
 	}
 
@@ -739,174 +870,6 @@ int VDFFAudioSource::read_packet(AVPacket* pkt, ReadInfo& ri)
 
 void VDFFAudioSource::reset_cache()
 {
-	for (auto& page : buffer) {
-		free(page.aud_data);
-		page = {};
-	}
-
-	first_page  = 0;
-	last_page   = 0;
-	used_pages  = 0;
+	m_cache.Reset(sample_count, mRawFormat.Format.nBlockAlign);
 	next_sample = AV_NOPTS_VALUE;
 }
-
-void VDFFAudioSource::alloc_page(int i)
-{
-	BufferPage& bp = buffer[i];
-	if (bp.aud_data) {
-		return;
-	}
-
-	uint8_t* data = nullptr;
-
-	if (used_pages > used_pages_max) {
-		while (1) {
-			if (last_page > i) {
-				if (buffer[last_page].aud_data) {
-					if (data) {
-						break;
-					}
-					data = buffer[last_page].aud_data;
-					buffer[last_page] = {};
-					used_pages--;
-				}
-				last_page--;
-			}
-			else if (first_page < i) {
-				if (buffer[first_page].aud_data) {
-					if (data) {
-						break;
-					}
-					data = buffer[first_page].aud_data;
-					buffer[first_page] = {};
-					used_pages--;
-				}
-				first_page++;
-			}
-		}
-	}
-
-	if (data) {
-		bp.aud_data = data;
-	} else {
-		bp.aud_data = (uint8_t*)malloc(BufferPage::size * mRawFormat.Format.nBlockAlign);
-	}
-
-	if (i < first_page) {
-		first_page = i;
-	}
-	if (i > last_page) {
-		last_page = i;
-	}
-	used_pages++;
-}
-
-int VDFFAudioSource::BufferPage::copy(int s0, uint32_t count, void* dst, int sample_size)
-{
-	if (a0 <= s0 && a1 > s0) {
-		// copy from range a
-		int n = s0 + count < a1 ? count : a1 - s0;
-		memcpy(dst, aud_data + s0 * sample_size, n * sample_size);
-		return n;
-	}
-	if (b0 <= s0 && b1 > s0) {
-		// copy from range b
-		int n = s0 + count < b1 ? count : b1 - s0;
-		memcpy(dst, aud_data + s0 * sample_size, n * sample_size);
-		return n;
-	}
-	return 0;
-}
-
-int VDFFAudioSource::BufferPage::empty(int s0, uint32_t count)
-{
-	if (a0 <= s0 && a1 > s0) {
-		return 0;
-	}
-	if (b0 <= s0 && b1 > s0) {
-		return 0;
-	}
-	if (a0 > s0) {
-		return s0 + count < a0 ? count : a0 - s0;
-	}
-	if (b0 > s0) {
-		return s0 + count < b0 ? count : b0 - s0;
-	}
-	if (b1 <= s0) {
-		return s0 + count < size ? count : size - s0;
-	}
-	return 0;
-}
-
-int VDFFAudioSource::BufferPage::alloc(int s0, uint32_t count, int& changed)
-{
-	int n = s0 + count < size ? count : size - s0;
-	if (a0 <= s0 && a1 >= s0 + n) {
-		// already in range a
-		changed = 0;
-		return n;
-	}
-	if (b0 <= s0 && b1 >= s0 + n) {
-		// already in range b
-		changed = 0;
-		return n;
-	}
-
-	changed = 1;
-
-	if (a1 == 0) {
-		// empty page, just initialize
-		a0 = s0;
-		a1 = s0 + n;
-		return n;
-	}
-
-	if (a0 <= s0 + n && a1 >= s0 + n) {
-		// extend range a down
-		a0 = s0;
-		return n;
-	}
-
-	if (a0 <= s0 && a1 >= s0) {
-		// extend range a up
-		a1 = s0 + n;
-		if (b0 && a1 >= b0) {
-			a1 = b1;
-			b0 = 0;
-			b1 = 0;
-		}
-		return n;
-	}
-
-	if (b0) {
-		if (b0 <= s0 + n && b1 >= s0 + n) {
-			// extend range b down
-			b0 = s0;
-			return n;
-		}
-
-		if (b0 <= s0 && b1 >= s0) {
-			// extend range b up
-			b1 = s0 + n;
-			return n;
-		}
-
-		// going to drop range b, possibly interesting for logging
-		changed = 2;
-	}
-
-	if (a1 < s0) {
-		// insert after range a
-		b0 = s0;
-		b1 = s0 + n;
-	}
-	else {
-		// insert before range a
-		b0 = a0;
-		b1 = a1;
-		a0 = s0;
-		a1 = s0 + n;
-	}
-
-	return n;
-}
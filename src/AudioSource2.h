@@ -10,6 +10,8 @@
 #include <vd2/plugin/vdinputdriver.h>
 #include <vd2/VDXFrame/Unknown.h>
 #include <vector>
+#include <future>
+#include <atomic>
 #include <mmreg.h>
 #include "stdint.h"
 
@@ -21,10 +23,15 @@ extern "C"
 #include <libavformat/avformat.h>
 #include <libswresample/swresample.h>
 }
+#include "Demuxer.h"
+#include "AudioCache.h"
+#include "AudioSeekTable.h"
+#include "AudioPeaks.h"
+#include "audioconv.h"
 
 class VDFFInputFile;
 
-class VDFFAudioSource : public vdxunknown<IVDXStreamSource>, public IVDXAudioSource
+class VDFFAudioSource : public vdxunknown<IVDXStreamSource>, public IVDXAudioSource, public IVDFFAudioPeaks
 {
 public:
 	VDFFAudioSource(const VDXInputDriverContext& context);
@@ -51,6 +58,10 @@ public:
 
 	void VDXAPIENTRY GetAudioSourceInfo(VDXAudioSourceInfo& info) override { info.mFlags = 0; }
 
+	int VDXAPIENTRY GetPeakChannels() override;
+	int64_t VDXAPIENTRY GetPeakProgress(int64_t* sample_count) override;
+	int VDXAPIENTRY GetPeaks(int64_t start, int64_t length, int count, Peak* peaks) override;
+
 private:
 	const VDXInputDriverContext& mContext;
 	WAVEFORMATEXTENSIBLE mRawFormat = {};
@@ -61,6 +72,8 @@ private:
 	int64_t time_adjust  = 0;
 
 	AVFormatContext* m_pFormatCtx = nullptr;
+	std::shared_ptr<VDFFDemuxer> m_pDemuxer;
+	VDFFDemuxer::Client* m_client = nullptr;
 public:
 	AVStream*       m_pStream   = nullptr;
 	AVCodecContext* m_pCodecCtx = nullptr;
@@ -69,6 +82,7 @@ public:
 	int64_t sample_count = 0;
 private:
 	SwrContext*      m_pSwrCtx    = nullptr;
+	SampleConverter  m_sampleconv; // instead of m_pSwrCtx when the channels are not changed
 	AVFrame*         m_pFrame     = nullptr;
 	int src_linesize       = 0;
 	uint64_t out_layout    = 0;
@@ -77,23 +91,7 @@ private:
 	int swr_rate           = 0;
 	AVSampleFormat swr_fmt = AV_SAMPLE_FMT_NONE;
 
-	struct BufferPage {
-		enum { size = 0x8000 }; // max usable value 0xFFFF
-
-		uint16_t a0 = 0, a1 = 0; // range a
-		uint16_t b0 = 0, b1 = 0; // range b
-		uint8_t* aud_data = nullptr;
-
-		int copy(int s0, uint32_t count, void* dst, int sample_size);
-		int alloc(int s0, uint32_t count, int& changed);
-		int empty(int s0, uint32_t count);
-	};
-
-	std::vector<BufferPage> buffer;
-	int used_pages     = 0;
-	int used_pages_max = 0;
-	int first_page     = 0;
-	int last_page      = 0;
+	VDFFAudioCache m_cache;
 
 	int64_t next_sample  = 0;
 	int64_t first_sample = AV_NOPTS_VALUE;
@@ -101,6 +99,20 @@ private:
 	bool trust_sample_pos = false;;
 	bool use_keys = false;
 
+	// decoding ahead of sequential reads, the decoder state is used by one thread at a time
+	std::future<void> m_decode_ahead;
+	std::atomic<bool> m_ahead_stop = false;
+	int64_t m_read_end = -1;  // end of the previous Read
+	bool m_stream_end = false; // no more packets since the last seek
+
+	// exact seeking for streams without an index
+	std::unique_ptr<VDFFAudioSeekTable> m_seek_table;
+	int64_t m_table_pts   = AV_NOPTS_VALUE; // timestamp of the next packet after a seek by the table
+	int64_t m_table_pos   = -1;
+	int64_t m_preroll_end = -1; // samples before it are decoder warm-up
+
+	VDFFAudioPeaks m_peaks;
+
 	struct ReadInfo {
 		int64_t first_sample = -1;
 		int64_t last_sample  = -1;
@@ -108,14 +120,16 @@ private:
 
 public:
 	int initStream(VDFFInputFile* pSource, int streamIndex);
-	AVFormatContext* OpenAudioFile(std::wstring_view path, int streamIndex);
 private:
 	void init_start_time();
 	int read_packet(AVPacket* pkt, ReadInfo& ri);
+	int decode_packet(AVPacket* pkt, ReadInfo& ri);
+	void start_decode_ahead();
+	bool seek_exact(int64_t start);
+	void start_peaks();
+	void stop_decode_ahead();
 	void insert_silence(int64_t start, uint32_t count);
 	void write_silence(void* dst, uint32_t count);
-	void invalidate(int64_t start, uint32_t count);
-	void alloc_page(int i);
 	void reset_cache();
 	int reset_swr();
 	int64_t frame_to_pts(int64_t start, AVStream* video);
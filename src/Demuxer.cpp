@@ -0,0 +1,532 @@
+/*
+ * Copyright (C) 2026 v0lt
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include "stdafx.h"
+
+#include "Demuxer.h"
+#include "InputFile2.h"
+#include "Helper.h"
+
+namespace {
+	using clock = std::chrono::steady_clock;
+
+	// a client that read recently is not interrupted by seeks of other clients
+	constexpr auto kActiveTime = std::chrono::seconds(2);
+
+	// limits of packets waiting for a client that does not read
+	constexpr size_t  kMaxQueuePackets = 8192;
+	constexpr int64_t kMaxQueueBytes   = 64 * 1024 * 1024;
+
+	// how far (AV_TIME_BASE units) a client can seek from the reader position and still share it
+	constexpr int64_t kRewindWindow  = 10 * AV_TIME_BASE;
+	constexpr int64_t kForwardWindow = 5 * AV_TIME_BASE;
+	// packets of different streams with the same timestamp can be this far apart in the file
+	constexpr int64_t kInterleaveMargin = 1 * AV_TIME_BASE;
+
+	constexpr size_t kMaxReaders = 8;
+
+	int64_t packet_ts(const AVPacket* pkt)
+	{
+		return pkt->dts != AV_NOPTS_VALUE ? pkt->dts : pkt->pts;
+	}
+}
+
+struct VDFFDemuxer::Reader {
+	AVFormatContext* fmt = nullptr;
+	std::mutex mutex; // fmt and queues of attached clients
+	std::vector<Client*> clients;
+	int64_t position = AV_NOPTS_VALUE; // last read or seek position, AV_TIME_BASE units
+};
+
+struct VDFFDemuxer::Client {
+	int  stream = -1;
+	bool audio  = false;
+	Reader* reader = nullptr;
+
+	std::deque<AVPacket*> queue;
+	int64_t queue_bytes = 0;
+
+	int64_t last_dts = AV_NOPTS_VALUE; // last packet returned or queued
+	int64_t skip_dts = AV_NOPTS_VALUE; // reader was rewound: drop packets already seen
+	clock::time_point last_read;
+
+	bool suspended = false; // queue overflow, no packets are routed until next read or seek
+	bool resync    = false;
+
+	bool accept(const int64_t ts)
+	{
+		if (skip_dts != AV_NOPTS_VALUE) {
+			if (ts == AV_NOPTS_VALUE || ts <= skip_dts) {
+				return false;
+			}
+			skip_dts = AV_NOPTS_VALUE;
+		}
+		if (ts != AV_NOPTS_VALUE) {
+			last_dts = ts;
+		}
+		return true;
+	}
+};
+
+VDFFDemuxer::VDFFDemuxer(AVFormatContext* fmt, const AVDictionary* options)
+{
+	av_dict_copy(&m_options, options, 0);
+
+	Reader* r = new Reader;
+	r->fmt = fmt;
+	m_readers.push_back(r);
+}
+
+VDFFDemuxer::~VDFFDemuxer()
+{
+	for (Reader* r : m_readers) {
+		for (Client* c : r->clients) {
+			flush_queue(c);
+			delete c;
+		}
+		avformat_close_input(&r->fmt);
+		delete r;
+	}
+	av_dict_free(&m_options);
+}
+
+AVFormatContext* VDFFDemuxer::GetFormatContext()
+{
+	return m_readers[0]->fmt;
+}
+
+VDFFDemuxer::Client* VDFFDemuxer::Attach(const int streamIndex)
+{
+	std::lock_guard lock(m_mutex);
+	Reader* r = m_readers[0];
+	if (streamIndex < 0 || streamIndex >= (int)r->fmt->nb_streams) {
+		return nullptr;
+	}
+
+	Client* c = new Client;
+	c->stream = streamIndex;
+	c->audio = (r->fmt->streams[streamIndex]->codecpar->codec_type == AVMEDIA_TYPE_AUDIO);
+
+	std::lock_guard rlock(r->mutex);
+	c->reader = r;
+	r->clients.push_back(c);
+	update_discard(r);
+
+	return c;
+}
+
+void VDFFDemuxer::Detach(Client* c)
+{
+	if (!c) {
+		return;
+	}
+
+	std::lock_guard lock(m_mutex);
+	Reader* r = c->reader;
+	{
+		std::lock_guard rlock(r->mutex);
+		std::erase(r->clients, c);
+		flush_queue(c);
+		update_discard(r);
+	}
+	if (r != m_readers[0] && r->clients.empty()) {
+		close_reader(r);
+	}
+	delete c;
+}
+
+int VDFFDemuxer::ReadPacket(Client* c, AVPacket* pkt)
+{
+	Reader* r = c->reader; // only changed by Seek of the same client
+	std::lock_guard lock(r->mutex);
+
+	c->last_read = clock::now();
+	if (c->suspended) {
+		c->suspended = false;
+		update_discard(r);
+	}
+
+	if (!c->queue.empty()) {
+		AVPacket* q = c->queue.front();
+		c->queue.pop_front();
+		c->queue_bytes -= q->size;
+		av_packet_move_ref(pkt, q);
+		av_packet_free(&q);
+		return 0;
+	}
+
+	while (1) {
+		int ret = av_read_frame(r->fmt, pkt);
+		if (ret < 0) {
+			return ret;
+		}
+
+		const int64_t ts = packet_ts(pkt);
+		if (ts != AV_NOPTS_VALUE && pkt->stream_index < (int)r->fmt->nb_streams) {
+			r->position = av_rescale_q(ts, r->fmt->streams[pkt->stream_index]->time_base, AV_TIME_BASE_Q);
+		}
+
+		route_packet(r, c, pkt);
+
+		if (pkt->stream_index == c->stream && c->accept(ts)) {
+			return 0;
+		}
+		av_packet_unref(pkt);
+	}
+}
+
+int VDFFDemuxer::Seek(Client* c, int64_t timestamp, int flags)
+{
+	std::lock_guard lock(m_mutex);
+	int ret = 0;
+
+	// prefer to share a reader which is already used near the target
+	if (try_join(c->reader, c, timestamp, flags, ret)) {
+		return ret;
+	}
+	for (size_t i = 0; i < m_readers.size(); i++) {
+		Reader* r = m_readers[i];
+		if (r != c->reader && try_join(r, c, timestamp, flags, ret)) {
+			return ret;
+		}
+	}
+
+	Reader* r = c->reader;
+	bool busy;
+	{
+		std::lock_guard rlock(r->mutex);
+		busy = has_active(r, c);
+	}
+	if (busy) {
+		// do not take the reader away from an active client
+		Reader* idle = nullptr;
+		for (Reader* r1 : m_readers) {
+			if (r1 == r) {
+				continue;
+			}
+			std::lock_guard rlock(r1->mutex);
+			if (!has_active(r1, c)) {
+				idle = r1;
+				break;
+			}
+		}
+		if (!idle && m_readers.size() < kMaxReaders) {
+			idle = open_reader();
+		}
+		// if no reader is available the active clients will have to resync
+		if (idle) {
+			move_client(c, idle);
+			r = idle;
+		}
+	}
+
+	std::lock_guard rlock(r->mutex);
+	return seek_reader(r, c, timestamp, flags, false);
+}
+
+bool VDFFDemuxer::TakeResync(Client* c)
+{
+	std::lock_guard lock(c->reader->mutex);
+	const bool resync = c->resync;
+	c->resync = false;
+	return resync;
+}
+
+AVStream* VDFFDemuxer::GetStream(Client* c)
+{
+	return c->reader->fmt->streams[c->stream];
+}
+
+int VDFFDemuxer::ShareIndex(Client* c)
+{
+	std::lock_guard lock(m_mutex);
+	Reader* primary = m_readers[0];
+	AVStream* dst = primary->fmt->streams[c->stream];
+	if (c->reader == primary) {
+		std::lock_guard rlock(primary->mutex);
+		return avformat_index_get_entries_count(dst);
+	}
+
+	std::scoped_lock rlock(c->reader->mutex, primary->mutex);
+	AVStream* src = c->reader->fmt->streams[c->stream];
+	const int count = avformat_index_get_entries_count(src);
+	if (count > avformat_index_get_entries_count(dst)) {
+		for (int i = 0; i < count; i++) {
+			const AVIndexEntry* e = avformat_index_get_entry(src, i);
+			av_add_index_entry(dst, e->pos, e->timestamp, e->size, e->min_distance, e->flags);
+		}
+	}
+	return avformat_index_get_entries_count(dst);
+}
+
+AVFormatContext* VDFFDemuxer::OpenClone()
+{
+	AVFormatContext* primary = m_readers[0]->fmt;
+
+	AVFormatContext* fmt = nullptr;
+	AVDictionary* options = nullptr;
+	av_dict_copy(&options, m_options, 0);
+	int err = avformat_open_input(&fmt, primary->url, primary->iformat, &options);
+	av_dict_free(&options);
+	if (err < 0) {
+		DLog("VDFFDemuxer: failed to open the file again");
+		return nullptr;
+	}
+	fmt->max_index_size = primary->max_index_size;
+
+	// the codec parameters are taken from the primary context,
+	// a full probe is only needed when the streams are created while reading
+	bool probe = false;
+	unsigned nb_streams;
+	{
+		std::lock_guard lock(m_readers[0]->mutex);
+		nb_streams = primary->nb_streams;
+		probe = (fmt->nb_streams < nb_streams);
+		for (unsigned i = 0; i < fmt->nb_streams && i < nb_streams && !probe; i++) {
+			const AVStream* s = fmt->streams[i];
+			const AVStream* ps = primary->streams[i];
+			if (s->codecpar->codec_id != ps->codecpar->codec_id || av_cmp_q(s->time_base, ps->time_base) != 0) {
+				probe = true;
+			}
+		}
+		if (!probe) {
+			for (unsigned i = 0; i < nb_streams; i++) {
+				AVStream* s = fmt->streams[i];
+				const AVStream* ps = primary->streams[i];
+				avcodec_parameters_copy(s->codecpar, ps->codecpar);
+				s->sample_aspect_ratio = ps->sample_aspect_ratio;
+				s->avg_frame_rate = ps->avg_frame_rate;
+				s->r_frame_rate = ps->r_frame_rate;
+				if (s->start_time == AV_NOPTS_VALUE) s->start_time = ps->start_time;
+				if (s->duration == AV_NOPTS_VALUE) s->duration = ps->duration;
+			}
+		}
+	}
+	if (probe) {
+		err = avformat_find_stream_info(fmt, nullptr);
+		if (err < 0 || fmt->nb_streams < nb_streams) {
+			avformat_close_input(&fmt);
+			return nullptr;
+		}
+	}
+
+	return fmt;
+}
+
+VDFFDemuxer::Reader* VDFFDemuxer::open_reader()
+{
+	AVFormatContext* fmt = OpenClone();
+	if (!fmt) {
+		DLog("VDFFDemuxer: failed to open additional reader");
+		return nullptr;
+	}
+
+	for (unsigned i = 0; i < fmt->nb_streams; i++) {
+		fmt->streams[i]->discard = AVDISCARD_ALL;
+	}
+
+	Reader* r = new Reader;
+	r->fmt = fmt;
+	m_readers.push_back(r);
+	DLog("VDFFDemuxer: opened reader {}", m_readers.size());
+
+	return r;
+}
+
+void VDFFDemuxer::close_reader(Reader* r)
+{
+	std::erase(m_readers, r);
+	avformat_close_input(&r->fmt);
+	delete r;
+}
+
+void VDFFDemuxer::move_client(Client* c, Reader* r)
+{
+	Reader* r0 = c->reader;
+	if (r0 == r) {
+		return;
+	}
+	{
+		std::lock_guard lock(r0->mutex);
+		std::erase(r0->clients, c);
+		flush_queue(c);
+		update_discard(r0);
+	}
+	{
+		std::lock_guard lock(r->mutex);
+		c->reader = r;
+		r->clients.push_back(c);
+		update_discard(r);
+	}
+	if (r0 != m_readers[0] && r0->clients.empty()) {
+		close_reader(r0);
+	}
+}
+
+// r->mutex must be locked
+int VDFFDemuxer::seek_reader(Reader* r, Client* c, int64_t timestamp, int flags, bool rewind)
+{
+	int ret = seek_frame(r->fmt, c->stream, timestamp, flags);
+
+	for (Client* o : r->clients) {
+		if (o == c) {
+			continue;
+		}
+		if (rewind && (o->last_dts != AV_NOPTS_VALUE || o->audio)) {
+			// the reader goes back to a position the client has already passed,
+			// everything up to the last delivered packet comes again and is dropped
+			o->skip_dts = o->last_dts;
+		}
+		else {
+			flush_queue(o);
+			o->skip_dts = AV_NOPTS_VALUE;
+			o->resync = true;
+		}
+	}
+
+	flush_queue(c);
+	c->last_dts = AV_NOPTS_VALUE;
+	c->skip_dts = AV_NOPTS_VALUE;
+	c->suspended = false;
+	c->resync = false;
+	c->last_read = clock::now();
+
+	// a byte position can't be compared with the timestamps, the next packet sets it
+	r->position = (flags & AVSEEK_FLAG_BYTE) ? AV_NOPTS_VALUE : to_position(c->stream, timestamp);
+	update_discard(r);
+
+	return ret;
+}
+
+bool VDFFDemuxer::try_join(Reader* r, Client* c, int64_t timestamp, int flags, int& ret)
+{
+	if (flags & AVSEEK_FLAG_BYTE) {
+		return false;
+	}
+
+	const int64_t target = to_position(c->stream, timestamp);
+	{
+		std::lock_guard lock(r->mutex);
+		if (r->position == AV_NOPTS_VALUE || !has_active(r, c)) {
+			return false;
+		}
+		const int64_t d = target - r->position;
+		if (d < -kRewindWindow) {
+			return false;
+		}
+		// any audio packet can start decoding, video must seek exactly
+		if (c->audio ? d > kForwardWindow : d > -kInterleaveMargin) {
+			return false;
+		}
+	}
+
+	move_client(c, r);
+
+	// position only grows while the lock was released
+	std::lock_guard lock(r->mutex);
+	const int64_t d = target - r->position;
+	if (c->audio && d >= kInterleaveMargin) {
+		// the reader did not reach the target yet, take the packets from here
+		flush_queue(c);
+		c->last_dts = AV_NOPTS_VALUE;
+		c->skip_dts = AV_NOPTS_VALUE;
+		c->suspended = false;
+		c->last_read = clock::now();
+		update_discard(r);
+		ret = 0;
+		return true;
+	}
+	if (c->audio && d > -kInterleaveMargin) {
+		// step back so that no interleaved packet of the other clients is missed
+		const AVRational tb = m_readers[0]->fmt->streams[c->stream]->time_base;
+		const int64_t start = to_position(c->stream, AV_SEEK_START);
+		const int64_t pos = r->position - kInterleaveMargin;
+		timestamp = (pos <= start) ? AV_SEEK_START : av_rescale_q(pos, AV_TIME_BASE_Q, tb);
+	}
+
+	DLog("VDFFDemuxer: stream {} joins reader at {}", c->stream, r->position);
+	ret = seek_reader(r, c, timestamp, flags, true);
+	return true;
+}
+
+// r->mutex must be locked
+bool VDFFDemuxer::has_active(Reader* r, Client* c)
+{
+	const auto now = clock::now();
+	for (Client* o : r->clients) {
+		if (o != c && !o->suspended && now - o->last_read < kActiveTime) {
+			return true;
+		}
+	}
+	return false;
+}
+
+int64_t VDFFDemuxer::to_position(const int stream, const int64_t timestamp)
+{
+	const AVFormatContext* fmt = m_readers[0]->fmt;
+	if (timestamp <= AV_SEEK_START) {
+		return fmt->start_time != AV_NOPTS_VALUE ? fmt->start_time : 0;
+	}
+	return av_rescale_q(timestamp, fmt->streams[stream]->time_base, AV_TIME_BASE_Q);
+}
+
+void VDFFDemuxer::update_discard(Reader* r)
+{
+	for (unsigned i = 0; i < r->fmt->nb_streams; i++) {
+		bool used = false;
+		for (const Client* o : r->clients) {
+			if (o->stream == (int)i && !o->suspended) {
+				used = true;
+				break;
+			}
+		}
+		r->fmt->streams[i]->discard = used ? AVDISCARD_DEFAULT : AVDISCARD_ALL;
+	}
+}
+
+void VDFFDemuxer::flush_queue(Client* c)
+{
+	for (AVPacket* q : c->queue) {
+		av_packet_free(&q);
+	}
+	c->queue.clear();
+	c->queue_bytes = 0;
+}
+
+// r->mutex must be locked
+void VDFFDemuxer::route_packet(Reader* r, Client* c, AVPacket* pkt)
+{
+	const int64_t ts = packet_ts(pkt);
+	bool changed = false;
+
+	for (Client* o : r->clients) {
+		if (o == c || o->stream != pkt->stream_index || o->suspended) {
+			continue;
+		}
+		if (!o->accept(ts)) {
+			continue;
+		}
+		AVPacket* q = av_packet_clone(pkt);
+		if (!q) {
+			continue;
+		}
+		o->queue.push_back(q);
+		o->queue_bytes += q->size;
+
+		if (o->queue.size() > kMaxQueuePackets || o->queue_bytes > kMaxQueueBytes) {
+			// the client is idle, it has to seek when it comes back
+			DLog("VDFFDemuxer: queue overflow for stream {}", o->stream);
+			flush_queue(o);
+			o->suspended = true;
+			o->resync = true;
+			changed = true;
+		}
+	}
+
+	if (changed) {
+		update_discard(r);
+	}
+}
@@ -0,0 +1,71 @@
+/*
+ * Copyright (C) 2026 v0lt
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#pragma once
+
+#include <mutex>
+#include <deque>
+#include <vector>
+#include <chrono>
+
+extern "C"
+{
+#include <libavformat/avformat.h>
+}
+
+// Shared demuxer for all streams of one file.
+// Every source (video, audio tracks) attaches as a client for its stream.
+// Clients that read close to each other share one reader, packets of the other
+// streams are routed to bounded per-client queues. An extra reader (a clone of
+// the primary context) is opened only when the read positions diverge too far.
+
+class VDFFDemuxer
+{
+public:
+	struct Client;
+
+	// takes ownership of fmt, options are used to open clones
+	VDFFDemuxer(AVFormatContext* fmt, const AVDictionary* options);
+	~VDFFDemuxer();
+
+	AVFormatContext* GetFormatContext();
+	// opens the file again without a full probe, the stream parameters are taken from the primary context.
+	// All streams are enabled, the caller owns the context.
+	AVFormatContext* OpenClone();
+
+	Client* Attach(const int streamIndex);
+	void Detach(Client* c);
+
+	// same contract as av_read_frame, but only packets of the client stream are returned
+	int ReadPacket(Client* c, AVPacket* pkt);
+	// same contract as av_seek_frame (timestamp in the client stream time base, AV_SEEK_START is allowed)
+	int Seek(Client* c, int64_t timestamp, int flags);
+	// returns true once after the client lost packets because its reader was moved by another client
+	bool TakeResync(Client* c);
+	// stream of the reader currently used by the client (index entries may differ from the primary context)
+	AVStream* GetStream(Client* c);
+	// copies the index of the client stream from the reader used by the client to the primary context,
+	// an index loaded by a seek on a clone is then also used by the primary. Returns the number of entries.
+	int ShareIndex(Client* c);
+
+private:
+	struct Reader;
+
+	std::mutex m_mutex; // reader list and client membership
+	std::vector<Reader*> m_readers; // [0] is the primary context, never closed before destruction
+	AVDictionary* m_options = nullptr;
+
+	Reader* open_reader();
+	void close_reader(Reader* r);
+	void move_client(Client* c, Reader* r);
+	int  seek_reader(Reader* r, Client* c, int64_t timestamp, int flags, bool rewind);
+	bool try_join(Reader* r, Client* c, int64_t timestamp, int flags, int& ret);
+	bool has_active(Reader* r, Client* c);
+	int64_t to_position(const int stream, const int64_t timestamp);
+	static void update_discard(Reader* r);
+	static void flush_queue(Client* c);
+	static void route_packet(Reader* r, Client* c, AVPacket* pkt);
+};
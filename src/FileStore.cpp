@@ -0,0 +1,136 @@
+/*
+ * Copyright (C) 2026 v0lt
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include "stdafx.h"
+
+#include "FileStore.h"
+#include "Utils/StringUtil.h"
+
+namespace {
+	uint64_t to_uint64(const FILETIME& ft)
+	{
+		return (uint64_t(ft.dwHighDateTime) << 32) | ft.dwLowDateTime;
+	}
+}
+
+std::wstring VDFFFileStore::GetDir(const wchar_t* subdir)
+{
+	wchar_t buf[MAX_PATH];
+	const DWORD len = GetEnvironmentVariableW(L"LOCALAPPDATA", buf, MAX_PATH);
+	if (len == 0 || len >= MAX_PATH) {
+		return {};
+	}
+	std::wstring dir = std::wstring(buf) + L"\\avlib";
+	if (subdir) {
+		dir += L'\\';
+		dir += subdir;
+	}
+	return dir;
+}
+
+bool VDFFFileStore::GetFileStamp(const wchar_t* path, uint64_t& size, uint64_t& write_time)
+{
+	WIN32_FILE_ATTRIBUTE_DATA fad;
+	if (!GetFileAttributesExW(path, GetFileExInfoStandard, &fad)) {
+		return false;
+	}
+	size = (uint64_t(fad.nFileSizeHigh) << 32) | fad.nFileSizeLow;
+	write_time = to_uint64(fad.ftLastWriteTime);
+	return true;
+}
+
+uint64_t VDFFFileStore::HashPath(const std::wstring& path)
+{
+	std::wstring lower(path);
+	str_tolower_all(lower);
+
+	// FNV-1a
+	uint64_t hash = 0xcbf29ce484222325ull;
+	const uint8_t* p = (const uint8_t*)lower.data();
+	for (size_t i = 0; i < lower.size() * sizeof(wchar_t); i++) {
+		hash = (hash ^ p[i]) * 0x100000001b3ull;
+	}
+	return hash;
+}
+
+bool VDFFFileStore::LoadFile(const std::wstring& path, std::vector<uint8_t>& data, const size_t max_size)
+{
+	HANDLE h = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (h == INVALID_HANDLE_VALUE) {
+		return false;
+	}
+	bool ret = false;
+	LARGE_INTEGER size;
+	if (GetFileSizeEx(h, &size) && (uint64_t)size.QuadPart <= max_size) {
+		data.resize((size_t)size.QuadPart);
+		DWORD read = 0;
+		ret = ReadFile(h, data.data(), (DWORD)data.size(), &read, nullptr) && read == data.size();
+	}
+	CloseHandle(h);
+	return ret;
+}
+
+bool VDFFFileStore::StoreFile(const std::wstring& path, const void* data, const size_t size)
+{
+	const std::wstring dir = path.substr(0, path.rfind(L'\\'));
+	CreateDirectoryW(dir.substr(0, dir.rfind(L'\\')).c_str(), nullptr);
+	CreateDirectoryW(dir.c_str(), nullptr);
+
+	// the thread id keeps the temporary files of concurrent writers apart
+	const std::wstring tmp_path = path + std::format(L".{}", GetCurrentThreadId());
+	HANDLE h = CreateFileW(tmp_path.c_str(), GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, 0, nullptr);
+	if (h == INVALID_HANDLE_VALUE) {
+		return false;
+	}
+	DWORD written = 0;
+	const bool ok = WriteFile(h, data, (DWORD)size, &written, nullptr) && written == size;
+	CloseHandle(h);
+	if (!ok || !MoveFileExW(tmp_path.c_str(), path.c_str(), MOVEFILE_REPLACE_EXISTING)) {
+		DeleteFileW(tmp_path.c_str());
+		return false;
+	}
+	return true;
+}
+
+void VDFFFileStore::Touch(const std::wstring& path)
+{
+	HANDLE h = CreateFileW(path.c_str(), FILE_WRITE_ATTRIBUTES, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING, 0, nullptr);
+	if (h == INVALID_HANDLE_VALUE) {
+		return;
+	}
+	FILETIME ft;
+	GetSystemTimeAsFileTime(&ft);
+	SetFileTime(h, nullptr, nullptr, &ft);
+	CloseHandle(h);
+}
+
+size_t VDFFFileStore::Trim(const std::wstring& dir, const wchar_t* mask, const size_t max_files)
+{
+	struct Item {
+		std::wstring name;
+		uint64_t time;
+	};
+	std::vector<Item> items;
+
+	WIN32_FIND_DATAW fd;
+	HANDLE h = FindFirstFileW((dir + L"\\" + mask).c_str(), &fd);
+	if (h == INVALID_HANDLE_VALUE) {
+		return 0;
+	}
+	do {
+		items.push_back({ fd.cFileName, to_uint64(fd.ftLastWriteTime) });
+	} while (FindNextFileW(h, &fd));
+	FindClose(h);
+
+	if (items.size() <= max_files) {
+		return items.size();
+	}
+	std::sort(items.begin(), items.end(), [](const Item& a, const Item& b) { return a.time < b.time; });
+	for (size_t i = 0; i < items.size() - max_files; i++) {
+		DeleteFileW((dir + L"\\" + items[i].name).c_str());
+	}
+	return max_files;
+}
@@ -0,0 +1,40 @@
+/*
+ * Copyright (C) 2026 v0lt
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Files that the plugin keeps between sessions in %LOCALAPPDATA%\avlib
+// (probe results, audio peaks, muxer compatibility).
+
+namespace VDFFFileStore
+{
+	// %LOCALAPPDATA%\avlib or a subfolder of it, empty if there is no local application data folder
+	std::wstring GetDir(const wchar_t* subdir = nullptr);
+
+	// size and last write time of a file
+	bool GetFileStamp(const wchar_t* path, uint64_t& size, uint64_t& write_time);
+
+	// hash of the case-insensitive path, names the entry of a file
+	uint64_t HashPath(const std::wstring& path);
+
+	// reads a whole file that is not larger than max_size
+	bool LoadFile(const std::wstring& path, std::vector<uint8_t>& data, const size_t max_size);
+
+	// writes a temporary file and renames it, another process never reads a partial file.
+	// The folder of the file and its parent are created.
+	bool StoreFile(const std::wstring& path, const void* data, const size_t size);
+
+	// sets the write time of a stored file to now, Trim keeps the files that were used recently
+	void Touch(const std::wstring& path);
+
+	// removes the files of dir matching mask that were written or touched longest ago when
+	// there are more than max_files. Returns the number of the files that are left.
+	size_t Trim(const std::wstring& dir, const wchar_t* mask, const size_t max_files);
+}
@@ -0,0 +1,581 @@
+/*
+ * Copyright (C) 2026 v0lt
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include "stdafx.h"
+#include "FormatMap.h"
+
+extern "C" {
+#include <libavutil/imgutils.h>
+#include <libavutil/pixdesc.h>
+}
+
+bool MapTargetFormat(const AVPixelFormat frame_fmt, const nsVDXPixmap::VDXPixmapFormat opt_format,
+	const bool full_range, const bool bt709, FormatMapping& m)
+{
+	// this function will select one of the modes:
+	// 1) XRGB - works slow
+	// 2) convert to arbitrary rgb
+	// 3) direct decoded format - usually some sort of yuv
+	// 4) upsample arbitrary yuv to 444
+
+	// yuv->rgb has chance to apply correct source color space matrix, range etc 
+	// but! currently I notice huge color upsampling error
+
+	// which is best default? rgb afraid to use; sws can do either fast-bad or slow-good, but vd can do good-fast-enough
+	using namespace nsVDXPixmap;
+
+	const bool default_rgb = false;
+
+	VDXPixmapFormat base_format    = kPixFormat_Null;
+	VDXPixmapFormat trigger        = kPixFormat_Null;
+	VDXPixmapFormat perfect_format = kPixFormat_Null;
+	AVPixelFormat perfect_av_fmt   = frame_fmt;
+	AVPixelFormat src_fmt          = frame_fmt;
+	bool perfect_bitexact = false;
+
+	m = FormatMapping();
+
+	const AVPixFmtDescriptor* desc = av_pix_fmt_desc_get(frame_fmt);
+	if (!desc) {
+		return false;
+	}
+	m.in_yuv = !(desc->flags & AV_PIX_FMT_FLAG_RGB) && desc->nb_components >= 3;
+	m.in_subs = m.in_yuv && (desc->log2_chroma_w + desc->log2_chroma_h) > 0;
+
+	switch (frame_fmt) {
+	case AV_PIX_FMT_AYUV64LE:
+	case AV_PIX_FMT_AYUV64BE:
+		perfect_format = kPixFormat_YUV444_Alpha_Planar;
+		perfect_av_fmt = AV_PIX_FMT_YUVA444P;
+		trigger = kPixFormat_YUV444_Planar;
+		break;
+
+	case AV_PIX_FMT_YUVA444P:
+		perfect_format = kPixFormat_YUV444_Alpha_Planar;
+		perfect_av_fmt = AV_PIX_FMT_YUVA444P;
+		trigger = kPixFormat_YUV444_Planar;
+		perfect_bitexact = true;
+		break;
+
+	case AV_PIX_FMT_YUVA422P:
+		perfect_format = kPixFormat_YUV422_Alpha_Planar;
+		perfect_av_fmt = AV_PIX_FMT_YUVA422P;
+		trigger = kPixFormat_YUV422_Planar;
+		perfect_bitexact = true;
+		break;
+
+	case AV_PIX_FMT_YUVA420P:
+		perfect_format = kPixFormat_YUV420_Alpha_Planar;
+		perfect_av_fmt = AV_PIX_FMT_YUVA420P;
+		trigger = kPixFormat_YUV420_Planar;
+		perfect_bitexact = true;
+		break;
+
+	case AV_PIX_FMT_YUVA444P9LE:
+	case AV_PIX_FMT_YUVA444P10LE:
+	case AV_PIX_FMT_YUVA444P16LE:
+		perfect_format = kPixFormat_YUV444_Alpha_Planar16;
+		perfect_av_fmt = AV_PIX_FMT_YUVA444P16LE;
+		trigger = kPixFormat_YUV444_Planar16;
+		perfect_bitexact = true;
+		break;
+
+	case AV_PIX_FMT_YUVA422P9LE:
+	case AV_PIX_FMT_YUVA422P10LE:
+	case AV_PIX_FMT_YUVA422P16LE:
+		perfect_format = kPixFormat_YUV422_Alpha_Planar16;
+		perfect_av_fmt = AV_PIX_FMT_YUVA422P16LE;
+		trigger = kPixFormat_YUV422_Planar16;
+		perfect_bitexact = true;
+		break;
+
+	case AV_PIX_FMT_YUVA420P9LE:
+	case AV_PIX_FMT_YUVA420P10LE:
+	case AV_PIX_FMT_YUVA420P16LE:
+		perfect_format = kPixFormat_YUV420_Alpha_Planar16;
+		perfect_av_fmt = AV_PIX_FMT_YUVA420P16LE;
+		trigger = kPixFormat_YUV420_Planar16;
+		perfect_bitexact = true;
+		break;
+
+	case AV_PIX_FMT_YUV420P9LE:
+	case AV_PIX_FMT_YUV420P10LE:
+	case AV_PIX_FMT_YUV420P12LE:
+	case AV_PIX_FMT_YUV420P14LE:
+	case AV_PIX_FMT_YUV420P16LE:
+		perfect_format = kPixFormat_YUV420_Planar16;
+		trigger = kPixFormat_YUV420_Planar16;
+		perfect_bitexact = true;
+		break;
+
+	case AV_PIX_FMT_YUV422P9LE:
+	case AV_PIX_FMT_YUV422P10LE:
+	case AV_PIX_FMT_YUV422P12LE:
+	case AV_PIX_FMT_YUV422P14LE:
+	case AV_PIX_FMT_YUV422P16LE:
+		perfect_format = kPixFormat_YUV422_Planar16;
+		trigger = kPixFormat_YUV422_Planar16;
+		perfect_bitexact = true;
+		break;
+
+	case AV_PIX_FMT_YUV444P9LE:
+	case AV_PIX_FMT_YUV444P10LE:
+	case AV_PIX_FMT_YUV444P12LE:
+	case AV_PIX_FMT_YUV444P14LE:
+	case AV_PIX_FMT_YUV444P16LE:
+		perfect_format = kPixFormat_YUV444_Planar16;
+		trigger = kPixFormat_YUV444_Planar16;
+		perfect_bitexact = true;
+		break;
+
+	case AV_PIX_FMT_YUV420P:
+	case AV_PIX_FMT_YUVJ420P:
+		src_fmt = AV_PIX_FMT_YUV420P;
+		perfect_format = kPixFormat_YUV420_Planar;
+		trigger = kPixFormat_YUV420_Planar;
+		perfect_bitexact = true;
+		// examples: xvid
+		// examples: gopro avc (FR)
+		break;
+
+	case AV_PIX_FMT_YUV422P:
+	case AV_PIX_FMT_YUVJ422P:
+		src_fmt = AV_PIX_FMT_YUV422P;
+		perfect_format = kPixFormat_YUV422_Planar;
+		trigger = kPixFormat_YUV422_Planar;
+		perfect_bitexact = true;
+		// examples: jpeg (FR)
+		break;
+
+	case AV_PIX_FMT_YUV440P:
+	case AV_PIX_FMT_YUVJ440P:
+		src_fmt = AV_PIX_FMT_YUV440P;
+		perfect_format = kPixFormat_YUV444_Planar;
+		perfect_av_fmt = AV_PIX_FMT_YUV444P;
+		trigger = kPixFormat_YUV444_Planar;
+		perfect_bitexact = false;
+		// examples: 422 jpeg lossless-transposed (FR)
+		break;
+
+	case AV_PIX_FMT_UYVY422:
+		perfect_format = kPixFormat_YUV422_UYVY;
+		trigger = kPixFormat_YUV422_UYVY;
+		perfect_bitexact = true;
+		//! not tested at all
+		break;
+
+	case AV_PIX_FMT_YUYV422:
+		perfect_format = kPixFormat_YUV422_YUYV;
+		trigger = kPixFormat_YUV422_YUYV;
+		perfect_bitexact = true;
+		// examples: cineform
+		break;
+
+	case AV_PIX_FMT_YUV444P:
+	case AV_PIX_FMT_YUVJ444P:
+		src_fmt = AV_PIX_FMT_YUV444P;
+		perfect_format = kPixFormat_YUV444_Planar;
+		perfect_av_fmt = AV_PIX_FMT_YUV444P;
+		trigger = kPixFormat_YUV444_Planar;
+		perfect_bitexact = true;
+		// examples: 444 jpeg by photoshop (FR)
+		break;
+
+	case AV_PIX_FMT_YUV411P:
+		src_fmt = AV_PIX_FMT_YUV411P;
+		perfect_format = kPixFormat_YUV411_Planar;
+		perfect_av_fmt = AV_PIX_FMT_YUV411P;
+		trigger = kPixFormat_YUV411_Planar;
+		perfect_bitexact = true;
+		// examples: DV
+		break;
+
+	case AV_PIX_FMT_BGR24:
+		perfect_format = kPixFormat_RGB888;
+		trigger = kPixFormat_RGB888;
+		perfect_bitexact = true;
+		// examples: tga24
+		break;
+
+	case AV_PIX_FMT_BGRA:
+	case AV_PIX_FMT_BGR0:
+		perfect_format = kPixFormat_XRGB8888;
+		trigger = kPixFormat_XRGB8888;
+		perfect_bitexact = true;
+		// examples: tga32
+		break;
+
+	case AV_PIX_FMT_BGRA64:
+		perfect_format = (VDXPixmapFormat)kPixFormat_XRGB64;
+		perfect_av_fmt = AV_PIX_FMT_BGRA64;
+		trigger = kPixFormat_XRGB64;
+		perfect_bitexact = true;
+		break;
+
+	case AV_PIX_FMT_GRAY8:
+		perfect_format = (VDXPixmapFormat)kPixFormat_Y8;
+		perfect_av_fmt = AV_PIX_FMT_GRAY8;
+		trigger = kPixFormat_Y8;
+		perfect_bitexact = true;
+		break;
+
+	case AV_PIX_FMT_GRAY16:
+		perfect_format = (VDXPixmapFormat)kPixFormat_Y16;
+		perfect_av_fmt = AV_PIX_FMT_GRAY16;
+		trigger = kPixFormat_Y16;
+		perfect_bitexact = true;
+		break;
+
+	default:
+		perfect_format = kPixFormat_XRGB8888;
+		perfect_av_fmt = AV_PIX_FMT_BGRA;
+		trigger = kPixFormat_XRGB8888;
+		perfect_bitexact = false;
+		// examples: utvideo rgb (AV_PIX_FMT_RGB24) 
+
+		if (desc->flags & AV_PIX_FMT_FLAG_RGB && desc->comp[0].depth > 8) {
+			// examples: sgi - RGB48BE, tiff - RGB48LE/BE, RGBA64LE/BE
+			perfect_format = (VDXPixmapFormat)kPixFormat_XRGB64;
+			perfect_av_fmt = AV_PIX_FMT_BGRA64;
+			trigger = (VDXPixmapFormat)kPixFormat_XRGB64;
+			perfect_bitexact = false;
+		}
+	}
+
+	if (opt_format == 0) {
+		if (default_rgb) {
+			base_format = kPixFormat_XRGB8888;
+			m.av_fmt = AV_PIX_FMT_BGRA;
+			if (base_format == perfect_format) m.direct_copy = perfect_bitexact;
+		}
+		else {
+			base_format = perfect_format;
+			m.av_fmt = perfect_av_fmt;
+			m.direct_copy = perfect_bitexact;
+		}
+
+	}
+	else {
+		switch (opt_format) {
+		case kPixFormat_YUV420_Planar:
+		case kPixFormat_YUV422_Planar:
+		case kPixFormat_YUV411_Planar:
+		case kPixFormat_YUV422_UYVY:
+		case kPixFormat_YUV422_YUYV:
+			if (opt_format == trigger) {
+				base_format = perfect_format;
+				m.av_fmt = perfect_av_fmt;
+				m.direct_copy = perfect_bitexact;
+			}
+			else return false;
+			break;
+
+		case kPixFormat_YUV444_Planar:
+			if (opt_format == trigger) {
+				base_format = perfect_format;
+				m.av_fmt = perfect_av_fmt;
+				m.direct_copy = perfect_bitexact;
+
+			}
+			else if (m.in_yuv) {
+				base_format = kPixFormat_YUV444_Planar;
+				m.av_fmt = AV_PIX_FMT_YUV444P;
+			}
+			else return false;
+			break;
+
+		case kPixFormat_YUV444_Planar16:
+			if (opt_format == trigger) {
+				base_format = perfect_format;
+				m.av_fmt = perfect_av_fmt;
+				m.direct_copy = perfect_bitexact;
+
+			}
+			else if (m.in_yuv) {
+				base_format = kPixFormat_YUV444_Planar16;
+				m.av_fmt = AV_PIX_FMT_YUV444P16;
+			}
+			else return false;
+			break;
+
+		case kPixFormat_XRGB64:
+			if (opt_format == perfect_format) {
+				base_format = perfect_format;
+				m.av_fmt = perfect_av_fmt;
+				m.direct_copy = perfect_bitexact;
+			}
+			else {
+				base_format = kPixFormat_XRGB64;
+				m.av_fmt = AV_PIX_FMT_BGRA64;
+				m.direct_copy = false;
+			}
+			break;
+
+		case kPixFormat_XRGB1555:
+			if (opt_format == perfect_format) {
+				base_format = perfect_format;
+				m.av_fmt = perfect_av_fmt;
+				m.direct_copy = perfect_bitexact;
+			}
+			else {
+				base_format = kPixFormat_XRGB1555;
+				m.av_fmt = AV_PIX_FMT_RGB555;
+				m.direct_copy = false;
+			}
+			break;
+
+		case kPixFormat_RGB565:
+			if (opt_format == perfect_format) {
+				base_format = perfect_format;
+				m.av_fmt = perfect_av_fmt;
+				m.direct_copy = perfect_bitexact;
+			}
+			else {
+				base_format = kPixFormat_RGB565;
+				m.av_fmt = AV_PIX_FMT_RGB565;
+				m.direct_copy = false;
+			}
+			break;
+
+		case kPixFormat_RGB888:
+			if (opt_format == perfect_format) {
+				base_format = perfect_format;
+				m.av_fmt = perfect_av_fmt;
+				m.direct_copy = perfect_bitexact;
+			}
+			else {
+				base_format = kPixFormat_RGB888;
+				m.av_fmt = AV_PIX_FMT_BGR24;
+				m.direct_copy = false;
+			}
+			break;
+
+		case kPixFormat_XRGB8888:
+			if (opt_format == perfect_format) {
+				base_format = perfect_format;
+				m.av_fmt = perfect_av_fmt;
+				m.direct_copy = perfect_bitexact;
+			}
+			else {
+				base_format = kPixFormat_XRGB8888;
+				m.av_fmt = AV_PIX_FMT_BGRA;
+				m.direct_copy = false;
+			}
+			break;
+
+		default:
+			return false;
+		}
+	}
+
+	const AVPixFmtDescriptor* out_desc = av_pix_fmt_desc_get(m.av_fmt);
+	m.out_rgb = (out_desc->flags & AV_PIX_FMT_FLAG_RGB) && out_desc->nb_components >= 3;
+
+	// tweak output yuv formats for VD here
+	VDXPixmapFormat format = base_format;
+
+	/*if (format==kPixFormat_YUV420_Planar && m.av_fmt==AV_PIX_FMT_YUV420P && opt_format!=kPixFormat_YUV420_Planar) {
+		AVFieldOrder fo = m_pCodecCtx->field_order;
+		if(fo==AV_FIELD_TT) format = kPixFormat_YUV420it_Planar;
+		if(fo==AV_FIELD_BB) format = kPixFormat_YUV420ib_Planar;
+	}*/
+
+	if (full_range) {
+		switch (format) {
+		case kPixFormat_YUV420_Planar:
+			format = kPixFormat_YUV420_Planar_FR;
+			break;
+		case kPixFormat_YUV420it_Planar:
+			format = kPixFormat_YUV420it_Planar_FR;
+			break;
+		case kPixFormat_YUV420ib_Planar:
+			format = kPixFormat_YUV420ib_Planar_FR;
+			break;
+		case kPixFormat_YUV422_Planar:
+			format = kPixFormat_YUV422_Planar_FR;
+			break;
+		case kPixFormat_YUV444_Planar:
+			format = kPixFormat_YUV444_Planar_FR;
+			break;
+		case kPixFormat_YUV422_UYVY:
+			format = kPixFormat_YUV422_UYVY_FR;
+			break;
+		case kPixFormat_YUV422_YUYV:
+			format = kPixFormat_YUV422_YUYV_FR;
+			break;
+		case kPixFormat_Y8:
+			format = kPixFormat_Y8_FR;
+			break;
+		}
+	}
+
+	if (bt709) {
+		switch (format) {
+		case kPixFormat_YUV420_Planar:
+			format = kPixFormat_YUV420_Planar_709;
+			break;
+		case kPixFormat_YUV420_Planar_FR:
+			format = kPixFormat_YUV420_Planar_709_FR;
+			break;
+		case kPixFormat_YUV420it_Planar:
+			format = kPixFormat_YUV420it_Planar_709;
+			break;
+		case kPixFormat_YUV420it_Planar_FR:
+			format = kPixFormat_YUV420it_Planar_709_FR;
+			break;
+		case kPixFormat_YUV420ib_Planar:
+			format = kPixFormat_YUV420ib_Planar_709;
+			break;
+		case kPixFormat_YUV420ib_Planar_FR:
+			format = kPixFormat_YUV420ib_Planar_709_FR;
+			break;
+		case kPixFormat_YUV422_Planar:
+			format = kPixFormat_YUV422_Planar_709;
+			break;
+		case kPixFormat_YUV422_Planar_FR:
+			format = kPixFormat_YUV422_Planar_709_FR;
+			break;
+		case kPixFormat_YUV444_Planar:
+			format = kPixFormat_YUV444_Planar_709;
+			break;
+		case kPixFormat_YUV444_Planar_FR:
+			format = kPixFormat_YUV444_Planar_709_FR;
+			break;
+		case kPixFormat_YUV422_UYVY:
+			format = kPixFormat_YUV422_UYVY_709;
+			break;
+		case kPixFormat_YUV422_UYVY_FR:
+			format = kPixFormat_YUV422_UYVY_709_FR;
+			break;
+		case kPixFormat_YUV422_YUYV:
+			format = kPixFormat_YUV422_YUYV_709;
+			break;
+		case kPixFormat_YUV422_YUYV_FR:
+			format = kPixFormat_YUV422_YUYV_709_FR;
+			break;
+		}
+	}
+
+	m.format = format;
+	m.src_fmt = src_fmt;
+
+	return true;
+}
+
+AVPixelFormat GetRgbProxyFormat(const AVPixelFormat src_fmt, int& max_value)
+{
+	int proxy_max_value = 0;
+	AVPixelFormat proxy_fmt = AV_PIX_FMT_NONE;
+	switch (src_fmt) {
+	case AV_PIX_FMT_GBRP9LE:
+		proxy_max_value = 0x01FF;
+		proxy_fmt = AV_PIX_FMT_GBRP16LE;
+		break;
+	case AV_PIX_FMT_GBRP10LE:
+		proxy_max_value = 0x03FF;
+		proxy_fmt = AV_PIX_FMT_GBRP16LE;
+		break;
+	case AV_PIX_FMT_GBRP12LE:
+		proxy_max_value = 0x0FFF;
+		proxy_fmt = AV_PIX_FMT_GBRP16LE;
+		break;
+	case AV_PIX_FMT_GBRP14LE:
+		proxy_max_value = 0x3FFF;
+		proxy_fmt = AV_PIX_FMT_GBRP16LE;
+		break;
+	case AV_PIX_FMT_GBRP16LE:
+		proxy_max_value = 0xFFFF;
+		proxy_fmt = AV_PIX_FMT_GBRP16LE;
+		break;
+
+	case AV_PIX_FMT_GBRP9BE:
+		proxy_max_value = 0x01FF;
+		proxy_fmt = AV_PIX_FMT_GBRP16BE;
+		break;
+	case AV_PIX_FMT_GBRP10BE:
+		proxy_max_value = 0x03FF;
+		proxy_fmt = AV_PIX_FMT_GBRP16BE;
+		break;
+	case AV_PIX_FMT_GBRP12BE:
+		proxy_max_value = 0x0FFF;
+		proxy_fmt = AV_PIX_FMT_GBRP16BE;
+		break;
+	case AV_PIX_FMT_GBRP14BE:
+		proxy_max_value = 0x3FFF;
+		proxy_fmt = AV_PIX_FMT_GBRP16BE;
+		break;
+	case AV_PIX_FMT_GBRP16BE:
+		proxy_max_value = 0xFFFF;
+		proxy_fmt = AV_PIX_FMT_GBRP16BE;
+		break;
+
+	case AV_PIX_FMT_GBRAP10LE:
+		proxy_max_value = 0x03FF;
+		proxy_fmt = AV_PIX_FMT_GBRAP16LE;
+		break;
+	case AV_PIX_FMT_GBRAP12LE:
+		proxy_max_value = 0x0FFF;
+		proxy_fmt = AV_PIX_FMT_GBRAP16LE;
+		break;
+	case AV_PIX_FMT_GBRAP16LE:
+		proxy_max_value = 0xFFFF;
+		proxy_fmt = AV_PIX_FMT_GBRAP16LE;
+		break;
+
+	case AV_PIX_FMT_GBRAP10BE:
+		proxy_max_value = 0x03FF;
+		proxy_fmt = AV_PIX_FMT_GBRAP16BE;
+		break;
+	case AV_PIX_FMT_GBRAP12BE:
+		proxy_max_value = 0x0FFF;
+		proxy_fmt = AV_PIX_FMT_GBRAP16BE;
+		break;
+	case AV_PIX_FMT_GBRAP16BE:
+		proxy_max_value = 0xFFFF;
+		proxy_fmt = AV_PIX_FMT_GBRAP16BE;
+		break;
+	}
+
+	max_value = proxy_max_value;
+	return proxy_fmt;
+}
+
+void FillPixmapLayout(VDXPixmapAlpha& pixmap, const uint8_t* p, const AVPixelFormat av_fmt, const int line_align, const bool bottom_up)
+{
+	const int w = pixmap.w;
+	const int h = pixmap.h;
+
+	uint8_t* data[4] = {};
+	int linesize[4] = {};
+	av_image_fill_arrays(data, linesize, p, av_fmt, w, h, line_align);
+
+	if (pixmap.format == nsVDXPixmap::kPixFormat_YUV422_V210) {
+		int row = (w + 47) / 48 * 128;
+		linesize[0] = row;
+	}
+
+	pixmap.palette = nullptr;
+	pixmap.data   = data[0];
+	pixmap.data2  = data[1];
+	pixmap.data3  = data[2];
+	pixmap.data4  = data[3];
+	pixmap.pitch  = linesize[0];
+	pixmap.pitch2 = linesize[1];
+	pixmap.pitch3 = linesize[2];
+	pixmap.pitch4 = linesize[3];
+
+	if (bottom_up) {
+		switch (pixmap.format) {
+		case nsVDXPixmap::kPixFormat_XRGB1555:
+		case nsVDXPixmap::kPixFormat_RGB565:
+		case nsVDXPixmap::kPixFormat_RGB888:
+		case nsVDXPixmap::kPixFormat_XRGB8888:
+			pixmap.data = data[0] + linesize[0] * (h - 1);
+			pixmap.pitch = -linesize[0];
+			break;
+		}
+	}
+}
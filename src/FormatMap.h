@@ -0,0 +1,38 @@
+/*
+ * Copyright (C) 2026 v0lt
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#pragma once
+
+#include <vd2/plugin/vdplugin.h>
+
+extern "C"
+{
+#include <libavutil/pixfmt.h>
+}
+
+// Target format selection of VDFFVideoSource::SetTargetFormat.
+// Does not depend on Windows or on the source, also used by bench/convert_bench.
+
+struct FormatMapping {
+	nsVDXPixmap::VDXPixmapFormat format = nsVDXPixmap::kPixFormat_Null; // host format with FR/709 variants applied
+	AVPixelFormat av_fmt  = AV_PIX_FMT_NONE; // output format
+	AVPixelFormat src_fmt = AV_PIX_FMT_NONE; // input format for the converter (J formats are mapped)
+	bool direct_copy = false;
+	bool in_yuv      = false;
+	bool in_subs     = false;
+	bool out_rgb     = false;
+};
+
+// returns false if opt_format can not be produced from frame_fmt, kPixFormat_Null selects the best format
+bool MapTargetFormat(const AVPixelFormat frame_fmt, const nsVDXPixmap::VDXPixmapFormat opt_format,
+	const bool full_range, const bool bt709, FormatMapping& m);
+
+// 16-bit proxy for planar RGB sources with XRGB64 output, AV_PIX_FMT_NONE if not used
+AVPixelFormat GetRgbProxyFormat(const AVPixelFormat src_fmt, int& max_value);
+
+// planes of the av_fmt picture at p as the host gets it (pixmap.format, w and h are set).
+// V210 has its own row size, the rows of DIB RGB formats are bottom-up if bottom_up is set.
+void FillPixmapLayout(VDXPixmapAlpha& pixmap, const uint8_t* p, const AVPixelFormat av_fmt, const int line_align, const bool bottom_up);
@@ -0,0 +1,219 @@
+/*
+ * Copyright (C) 2026 v0lt
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include "stdafx.h"
+#include "FrameConverter.h"
+
+extern "C"
+{
+#include <libavutil/opt.h>
+#include <libavutil/pixdesc.h>
+}
+
+VDFFFrameConverter::~VDFFFrameConverter()
+{
+	Reset();
+}
+
+void VDFFFrameConverter::Reset()
+{
+	if (m_pSwsCtx) {
+		sws_freeContext(m_pSwsCtx);
+		m_pSwsCtx = nullptr;
+	}
+	m_pixconv.Reset();
+	m_bands = 1;
+	m_src_fmt = AV_PIX_FMT_NONE;
+	m_dst_fmt = AV_PIX_FMT_NONE;
+	m_proxy_max_value = 0;
+}
+
+bool VDFFFrameConverter::Init(const FormatMapping& m, const int width, const int height,
+	const AVColorSpace colorspace, const bool full_range, const AVChromaLocation chroma_loc,
+	const bool flip, const bool fast_rgb)
+{
+	Reset();
+	m_width = width;
+	m_height = height;
+	m_flip = flip;
+
+	AVPixelFormat src_fmt = m.src_fmt;
+
+	// range and color space only makes sence for yuv->rgb
+	// rgb->rgb is always exact
+	// rgb->yuv is useless as input
+	// yuv->yuv better keep unchanged to save precision
+	// rgb output is always full range
+	const int* src_matrix = sws_getCoefficients(colorspace);
+	int src_range = full_range ? 1 : 0;
+
+	if (m.in_yuv && m.out_rgb && !flip && !fast_rgb) {
+		// common decoder formats are converted without swscale, the result is the same within rounding
+		if (m_pixconv.Init(src_fmt, m.av_fmt, width, height, src_matrix, src_range != 0, chroma_loc)) {
+			init_bands();
+			return true;
+		}
+	}
+
+	int flags = 0;
+	if (m.in_subs) {
+		// bicubic is needed to best preserve detail, ex color_420.jpg
+		// bilinear also not bad if the material is blurry
+		flags |= SWS_BICUBIC;
+	}
+	else {
+		// this is needed to fight smearing when no upsampling is actually used, ex color_444.jpg
+		flags |= SWS_POINT;
+	}
+
+	// these flags are needed to avoid really bad optimized conversion resulting in corrupt image, ex color_420.jpg
+	// however this is also 5x slower!
+	flags |= SWS_FULL_CHR_H_INT | SWS_ACCURATE_RND;
+	if (fast_rgb) flags = SWS_POINT;
+#ifdef _DEBUG
+	flags |= SWS_PRINT_INFO;
+#endif
+
+	if (m.format == nsVDXPixmap::kPixFormat_XRGB64) {
+		int proxy_max_value = 0;
+		const AVPixelFormat proxy_fmt = GetRgbProxyFormat(src_fmt, proxy_max_value);
+		if (proxy_fmt != AV_PIX_FMT_NONE) {
+			m_proxy_max_value = proxy_max_value;
+			src_fmt = proxy_fmt;
+
+			// planar RGB to XRGB64 only needs interleaving, the values are scaled by ref_r/ref_g/ref_b
+			if (!flip && m_pixconv.Init(src_fmt, m.av_fmt, width, height, nullptr, false, AVCHROMA_LOC_UNSPECIFIED)) {
+				init_bands();
+				return true;
+			}
+		}
+	}
+
+	m_pSwsCtx = sws_alloc_context();
+	if (!m_pSwsCtx) {
+		return false;
+	}
+	m_src_fmt = src_fmt;
+	m_dst_fmt = m.av_fmt;
+	// swscale slices the picture on its own threads, with as many bands as pixconv
+	m_bands = get_bands();
+	av_opt_set_int(m_pSwsCtx, "threads", m_bands, 0);
+	av_opt_set_int(m_pSwsCtx, "srcw", width, 0);
+	av_opt_set_int(m_pSwsCtx, "srch", height, 0);
+	av_opt_set_int(m_pSwsCtx, "src_format", src_fmt, 0);
+	av_opt_set_int(m_pSwsCtx, "dstw", width, 0);
+	av_opt_set_int(m_pSwsCtx, "dsth", height, 0);
+	av_opt_set_int(m_pSwsCtx, "dst_format", m.av_fmt, 0);
+	av_opt_set_int(m_pSwsCtx, "sws_flags", flags, 0);
+	// an explicit chroma siting is honored as by pixconv, in luma samples * 256
+	int xpos, ypos;
+	if (m.in_yuv && av_chroma_location_enum_to_pos(&xpos, &ypos, chroma_loc) == 0) {
+		const AVPixFmtDescriptor* desc = av_pix_fmt_desc_get(src_fmt);
+		if (desc->log2_chroma_w) {
+			av_opt_set_int(m_pSwsCtx, "src_h_chr_pos", xpos, 0);
+		}
+		if (desc->log2_chroma_h) {
+			av_opt_set_int(m_pSwsCtx, "src_v_chr_pos", ypos, 0);
+		}
+	}
+	if (sws_init_context(m_pSwsCtx, nullptr, nullptr) < 0) {
+		sws_freeContext(m_pSwsCtx);
+		m_pSwsCtx = nullptr;
+		return false;
+	}
+	if (m.in_yuv && m.out_rgb) {
+		int* t1; int* t2; int r1, r2; int p0, p1, p2;
+		sws_getColorspaceDetails(m_pSwsCtx, &t1, &r1, &t2, &r2, &p0, &p1, &p2);
+		sws_setColorspaceDetails(m_pSwsCtx, src_matrix, src_range, t2, r2, p0, p1, p2);
+	}
+
+	return true;
+}
+
+int VDFFFrameConverter::get_bands() const
+{
+	// small frames are not worth the synchronization
+	const int min_band_pixels = 256 * 1024;
+	int bands = std::min(int(std::thread::hardware_concurrency()), 16);
+	bands = std::min(bands, (m_width * m_height) / min_band_pixels);
+	bands = std::min(bands, m_height / 16);
+	return std::max(bands, 1);
+}
+
+void VDFFFrameConverter::init_bands()
+{
+	const int bands = get_bands();
+
+	m_bands = 1;
+	if (bands > 1) {
+		if (!m_pool || int(m_pool->GetThreadCount()) < bands) {
+			m_pool = std::make_unique<ThreadPool>(bands - 1);
+		}
+		m_bands = bands;
+	}
+}
+
+void VDFFFrameConverter::Convert(const uint8_t* const src[4], const int src_stride[4], uint8_t* const dst[4], const int dst_stride[4]) const
+{
+	const int h = m_height;
+
+	const uint8_t* data[4];
+	int linesize[4];
+	for (int i = 0; i < 4; i++) {
+		data[i] = src[i];
+		linesize[i] = src_stride[i];
+	}
+	if (m_flip) {
+		data[0] = data[0] + linesize[0] * (h - 1);
+		linesize[0] = -linesize[0];
+	}
+
+	if (m_pixconv.IsValid()) {
+		if (m_bands > 1) {
+			const int bands = m_bands;
+			m_pool->ParallelFor(bands, [&](int i) {
+				m_pixconv.Convert(data, linesize, dst[0], dst_stride[0], h * i / bands, h * (i + 1) / bands);
+			});
+		} else {
+			m_pixconv.Convert(data, linesize, dst[0], dst_stride[0], 0, h);
+		}
+	} else if (m_pSwsCtx) {
+		if (m_bands > 1 && !m_flip) {
+			scale_frame(data, linesize, dst, dst_stride);
+		} else {
+			sws_scale(m_pSwsCtx, data, linesize, 0, h, dst, dst_stride);
+		}
+	}
+}
+
+// sws_scale converts on the calling thread only, sws_scale_frame uses the threads of the context
+void VDFFFrameConverter::scale_frame(const uint8_t* const src[4], const int src_stride[4], uint8_t* const dst[4], const int dst_stride[4]) const
+{
+	// the planes are not owned by the frames
+	auto no_free = [](void*, uint8_t*) {};
+
+	AVFrame* src_frame = av_frame_alloc();
+	AVFrame* dst_frame = av_frame_alloc();
+	if (src_frame && dst_frame) {
+		src_frame->format = m_src_fmt;
+		dst_frame->format = m_dst_fmt;
+		src_frame->width = dst_frame->width = m_width;
+		src_frame->height = dst_frame->height = m_height;
+		for (int i = 0; i < 4; i++) {
+			src_frame->data[i] = (uint8_t*)src[i];
+			src_frame->linesize[i] = src_stride[i];
+			dst_frame->data[i] = dst[i];
+			dst_frame->linesize[i] = dst_stride[i];
+		}
+		src_frame->buf[0] = av_buffer_create(src_frame->data[0], 1, no_free, nullptr, AV_BUFFER_FLAG_READONLY);
+		dst_frame->buf[0] = av_buffer_create(dst_frame->data[0], 1, no_free, nullptr, 0);
+	}
+	if (!src_frame || !dst_frame || !src_frame->buf[0] || !dst_frame->buf[0] || sws_scale_frame(m_pSwsCtx, dst_frame, src_frame) < 0) {
+		sws_scale(m_pSwsCtx, src, src_stride, 0, m_height, dst, dst_stride);
+	}
+	av_frame_free(&src_frame);
+	av_frame_free(&dst_frame);
+}
@@ -0,0 +1,60 @@
+/*
+ * Copyright (C) 2026 v0lt
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#pragma once
+
+#include <memory>
+#include "FormatMap.h"
+#include "pixconv.h"
+#include "Utils/ThreadPool.h"
+
+extern "C"
+{
+#include <libswscale/swscale.h>
+}
+
+// Converts decoded pictures to the format selected by MapTargetFormat.
+// Uses pixconv when it handles the pair, swscale otherwise. Large frames are split into bands,
+// on a pool for pixconv and on the threads of the context for swscale.
+
+class VDFFFrameConverter
+{
+public:
+	VDFFFrameConverter() = default;
+	~VDFFFrameConverter();
+
+	VDFFFrameConverter(const VDFFFrameConverter&) = delete;
+	VDFFFrameConverter& operator=(const VDFFFrameConverter&) = delete;
+
+	// m.src_fmt, m.av_fmt and m.format must be final (after any override of the caller)
+	bool Init(const FormatMapping& m, const int width, const int height,
+		const AVColorSpace colorspace, const bool full_range, const AVChromaLocation chroma_loc,
+		const bool flip, const bool fast_rgb);
+	void Reset();
+
+	bool IsValid() const { return m_pixconv.IsValid() || m_pSwsCtx; }
+	bool IsSwscale() const { return m_pSwsCtx != nullptr; }
+	// reference white of XRGB64 output for 9..14-bit planar RGB sources, 0 if not scaled
+	int GetProxyMaxValue() const { return m_proxy_max_value; }
+
+	void Convert(const uint8_t* const src[4], const int src_stride[4], uint8_t* const dst[4], const int dst_stride[4]) const;
+
+private:
+	SwsContext* m_pSwsCtx = nullptr;
+	PixelConverter m_pixconv;
+	std::unique_ptr<ThreadPool> m_pool;
+	int m_bands = 1; // horizontal bands converted in parallel
+	int m_width  = 0;
+	int m_height = 0;
+	int m_proxy_max_value = 0;
+	AVPixelFormat m_src_fmt = AV_PIX_FMT_NONE; // swscale
+	AVPixelFormat m_dst_fmt = AV_PIX_FMT_NONE;
+	bool m_flip = false;
+
+	int get_bands() const;
+	void init_bands();
+	void scale_frame(const uint8_t* const src[4], const int src_stride[4], uint8_t* const dst[4], const int dst_stride[4]) const;
+};
@@ -11,7 +11,11 @@
 #include "FileInfo2.h"
 #include "VideoSource2.h"
 #include "AudioSource2.h"
+#include "Demuxer.h"
+#include "ProbeCache.h"
+#include "ProbeStore.h"
 #include "mov_mp4.h"
+#include "signature.h"
 #include "export.h"
 #include <vfw.h>
 #include <aviriff.h>
@@ -20,6 +24,7 @@
 #include "ffmpeg_helper.h"
 #include "iobuffer.h"
 #include "Utils/StringUtil.h"
+#include "Utils/ThreadPool.h"
 extern "C" {
 #include <libavutil/error.h>
 }
@@ -361,22 +366,26 @@ IVDXInputFileDriver::DetectionConfidence detect_ff(VDXMediaInfo& info, const voi
 		return IVDXInputFileDriver::kDC_None;
 	}
 
-	err = avformat_find_stream_info(ctx, nullptr);
+	// same as in OpenVideoFile, the context is used there if the file is opened
+	ctx->max_index_size = 512 * 1024 * 1024;
+
+	err = VDFFProbeStore::FindStreamInfo(fileName, &ctx);
 	if (err < 0) {
 		avformat_close_input(&ctx);
 		return IVDXInputFileDriver::kDC_None;
 	}
 	fmt = ctx->iformat;
 	copyCharToWchar(info.format_name, std::size(info.format_name), fmt->name);
-	avformat_close_input(&ctx);
+	VDFFProbeCache::Put(fileName, ctx);
 
 	return IVDXInputFileDriver::kDC_Moderate;
 }
 
 //----------------------------------------------------------------------------------------------
 
-VDFFInputFileDriver::VDFFInputFileDriver(const VDXInputDriverContext& context)
+VDFFInputFileDriver::VDFFInputFileDriver(const VDXInputDriverContext& context, bool audio_only)
 	: mContext(context)
+	, m_audio_only(audio_only)
 {
 }
 
@@ -435,6 +444,12 @@ int VDXAPIENTRY VDFFInputFileDriver::DetectBySignature3(VDXMediaInfo& info, cons
 		return detConf;
 	}
 
+	// known signatures do not need FFmpeg probing
+	detConf = detect_signature(info, pHeader, nHeaderSize);
+	if (detConf >= kDC_Moderate) {
+		return detConf;
+	}
+
 	detConf = detect_ff(info, pHeader, nHeaderSize, fileName);
 
 	return detConf;
@@ -443,6 +458,7 @@ int VDXAPIENTRY VDFFInputFileDriver::DetectBySignature3(VDXMediaInfo& info, cons
 bool VDXAPIENTRY VDFFInputFileDriver::CreateInputFile(uint32_t flags, IVDXInputFile** ppFile)
 {
 	VDFFInputFile* p = new VDFFInputFile(mContext);
+	p->audio_only = m_audio_only;
 
 	if (flags & kOF_AutoSegmentScan) p->auto_append = true;
 	if (flags & kOF_SingleFile) p->single_file_mode = true;
@@ -543,9 +559,9 @@ VDFFInputFile::~VDFFInputFile()
 	if (audio_source) {
 		audio_source->Release();
 	}
-	if (m_pFormatCtx) {
-		avformat_close_input(&m_pFormatCtx);
-	}
+	m_demuxer.reset();
+	m_pFormatCtx = nullptr;
+	av_dict_free(&m_open_options);
 }
 
 void VDFFInputFile::DisplayInfo(VDXHWND hwndParent)
@@ -559,7 +575,7 @@ void VDFFInputFile::Init(const wchar_t* szFile, IVDXInputOptions* in_opts)
 	DLog(L"VDFFInputFile::Init - {}", szFile);
 
 	if (!szFile) {
-		mContext.mpCallbacks->SetError("No File Given");
+		set_error("No File Given");
 		return;
 	}
 
@@ -577,9 +593,11 @@ void VDFFInputFile::Init(const wchar_t* szFile, IVDXInputOptions* in_opts)
 	m_path = szFile;
 
 	init_av();
-	//! this context instance is granted to video stream: wasted in audio-only mode
-	// audio will manage its own
-	m_pFormatCtx = OpenVideoFile();
+	// one demuxer is shared by the video and all audio sources
+	m_pFormatCtx = audio_only ? OpenAudioFile() : OpenVideoFile();
+	if (m_pFormatCtx) {
+		m_demuxer = std::make_shared<VDFFDemuxer>(m_pFormatCtx, m_open_options);
+	}
 
 	if (auto_append) {
 		do_auto_append(szFile);
@@ -593,8 +611,14 @@ int VDFFInputFile::GetFileFlags()
 	return flags;
 }
 
+// auto-append segments opened at the same time
+static constexpr int kMaxAppendThreads = 8;
+
 void VDFFInputFile::do_auto_append(const wchar_t* szFile)
 {
+	if (!m_pFormatCtx) {
+		return;
+	}
 	const wchar_t* ext = GetFileExt(szFile);
 	if (!ext) {
 		return;
@@ -602,20 +626,58 @@ void VDFFInputFile::do_auto_append(const wchar_t* szFile)
 	if (ext - szFile < 3) {
 		return;
 	}
-	if (ext[-3] == '.' && ext[-2] == '0' && ext[-1] == '0') {
-		int x = 1;
-		const std::wstring base(szFile, ext - szFile - 3);
-		while (1) {
-			std::wstring filepath = base + std::format(L".{:02}", x) + ext;
-			if (!FileExist(filepath.c_str())) {
-				break;
-			}
-			if (!Append(filepath.c_str())) {
-				break;
-			}
-			x++;
+	if (!(ext[-3] == '.' && ext[-2] == '0' && ext[-1] == '0')) {
+		return;
+	}
+
+	std::vector<std::wstring> paths;
+	const std::wstring base(szFile, ext - szFile - 3);
+	for (int x = 1; ; x++) {
+		std::wstring filepath = base + std::format(L".{:02}", x) + ext;
+		if (!FileExist(filepath.c_str())) {
+			break;
+		}
+		paths.emplace_back(std::move(filepath));
+	}
+	if (paths.empty()) {
+		return;
+	}
+
+	VDFFInputFile* head = head_segment ? head_segment : this;
+	const int count = (int)paths.size();
+
+	// the same flags as Append, errors are reported when the segment is linked
+	std::vector<VDFFInputFile*> segments(count);
+	for (int i = 0; i < count; i++) {
+		VDFFInputFile* f = new VDFFInputFile(mContext);
+		f->head_segment = head;
+		f->audio_only = audio_only;
+		f->auto_append = false;
+		f->single_file_mode = true;
+		f->m_defer_errors = true;
+		segments[i] = f;
+	}
+
+	// the open time is mostly latency of the file system, the segments are opened concurrently
+	{
+		ThreadPool pool(std::min(count, kMaxAppendThreads) - 1);
+		pool.ParallelFor(count, [&](int i) {
+			segments[i]->Init(paths[i].c_str(), 0);
+		});
+	}
+
+	// segments are linked in order up to the first one that fails
+	int i = 0;
+	while (i < count) {
+		VDFFInputFile* f = segments[i++];
+		f->m_defer_errors = false;
+		if (!attach_segment(f)) {
+			break;
 		}
 	}
+	for (; i < count; i++) {
+		delete segments[i];
+	}
 }
 
 bool VDFFInputFile::test_append(VDFFInputFile* f0, VDFFInputFile* f1)
@@ -650,16 +712,27 @@ bool VDXAPIENTRY VDFFInputFile::Append2(const wchar_t* szFile, int flags, IVDXIn
 	if (!szFile) return true;
 
 	VDFFInputFile* head = head_segment ? head_segment : this;
-	VDFFInputFile* last = head;
-	while (last->next_segment) last = last->next_segment;
 
 	VDFFInputFile* f = new VDFFInputFile(mContext);
 	f->head_segment = head;
+	f->audio_only = audio_only;
 	if (flags & VDFFInputFileDriver::kOF_AutoSegmentScan) f->auto_append = true; else f->auto_append = false;
 	if (flags & VDFFInputFileDriver::kOF_SingleFile) f->single_file_mode = true; else f->single_file_mode = false;
 	f->Init(szFile, 0);
 
+	return attach_segment(f);
+}
+
+bool VDFFInputFile::attach_segment(VDFFInputFile* f)
+{
+	VDFFInputFile* head = head_segment ? head_segment : this;
+	VDFFInputFile* last = head;
+	while (last->next_segment) last = last->next_segment;
+
 	if (!f->m_pFormatCtx) {
+		if (!f->m_error.empty()) {
+			mContext.mpCallbacks->SetError("%s", f->m_error.c_str());
+		}
 		delete f;
 		return false;
 	}
@@ -715,43 +788,135 @@ bool VDXAPIENTRY VDFFInputFile::Append2(const wchar_t* szFile, int flags, IVDXIn
 	return true;
 }
 
-AVFormatContext* VDFFInputFile::OpenVideoFile()
+void VDFFInputFile::set_error(const char* format, ...)
 {
-	std::string ff_path = ConvertWideToUtf8(m_path);
+	char buf[1024];
+	va_list args;
+	va_start(args, format);
+	vsnprintf(buf, std::size(buf), format, args);
+	va_end(args);
+
+	if (!m_defer_errors) {
+		mContext.mpCallbacks->SetError("%s", buf);
+	}
+	else if (m_error.empty()) {
+		// only the first error is kept, the same as the host does
+		m_error = buf;
+	}
+}
+
+// The header of a PCM, FLAC or MP3 (with a Xing/Info tag) file describes the stream completely,
+// avformat_find_stream_info would only decode the first packets to confirm it.
+static bool header_is_complete(AVFormatContext* fmt)
+{
+	const char* name = fmt->iformat->name;
+	const bool pcm_format = !strcmp(name, "wav") || !strcmp(name, "w64") || !strcmp(name, "aiff");
+	const bool flac_mp3 = !strcmp(name, "flac") || !strcmp(name, "mp3");
+	if (!(pcm_format || flac_mp3) || fmt->nb_streams == 0) {
+		return false;
+	}
 
+	int64_t duration = 0;
+	for (unsigned i = 0; i < fmt->nb_streams; i++) {
+		const AVStream* st = fmt->streams[i];
+		const AVCodecParameters* par = st->codecpar;
+		if (par->codec_type != AVMEDIA_TYPE_AUDIO || par->sample_rate <= 0 || par->ch_layout.nb_channels <= 0) {
+			return false;
+		}
+		// compressed audio in wav (or spdif) needs the probe
+		if (pcm_format ? av_get_exact_bits_per_sample(par->codec_id) <= 0 : (par->codec_id != AV_CODEC_ID_FLAC && par->codec_id != AV_CODEC_ID_MP3)) {
+			return false;
+		}
+		if (st->duration == AV_NOPTS_VALUE) {
+			return false;
+		}
+		duration = std::max(duration, av_rescale_q(st->duration, st->time_base, AV_TIME_BASE_Q));
+	}
+	// otherwise set by avformat_find_stream_info
+	fmt->duration = duration;
+
+	return true;
+}
+
+AVFormatContext* VDFFInputFile::open_file(const std::string& ff_path)
+{
 	AVFormatContext* fmt = nullptr;
 	int err = 0;
 	try {
 		err = avformat_open_input(&fmt, ff_path.c_str(), nullptr, nullptr);
 	}
 	catch (const std::system_error& e) {
-		mContext.mpCallbacks->SetError("FFMPEG caught std::system_error: %s\nCode: %d", e.what(), e.code().value());
+		set_error("FFMPEG caught std::system_error: %s\nCode: %d", e.what(), e.code().value());
 		return nullptr;
 	}
 	catch (const std::exception& e) {
-		mContext.mpCallbacks->SetError("FFMPEG caught a general std::exception: %s", e.what());
+		set_error("FFMPEG caught a general std::exception: %s", e.what());
 		return nullptr;
 	}
 	catch (...) {
-		mContext.mpCallbacks->SetError("FFMPEG caught an unknown exception.");
+		set_error("FFMPEG caught an unknown exception.");
 		return nullptr;
 	}
 
 	if (err != 0) {
-		mContext.mpCallbacks->SetError("FFMPEG open failure:\n%s", get_last_av_error().c_str());
+		set_error("FFMPEG open failure:\n%s", AVError2Str(err).c_str());
 		return nullptr;
 	}
 
 	// I absolutely do not want index getting condensed
 	fmt->max_index_size = 512 * 1024 * 1024;
 
-	err = avformat_find_stream_info(fmt, nullptr);
+	if (header_is_complete(fmt)) {
+		DLog(L"VDFFInputFile: stream information is taken from the header of {}", m_path);
+		return fmt;
+	}
+
+	// a short probe is enough if the result of a previous open is stored
+	err = VDFFProbeStore::FindStreamInfo(m_path.c_str(), &fmt);
 	if (err < 0) {
-		mContext.mpCallbacks->SetError("FFMPEG: Couldn't find stream information of file.");
+		set_error("FFMPEG: Couldn't find stream information of file.");
 		avformat_close_input(&fmt);
 		return nullptr;
 	}
 
+	return fmt;
+}
+
+AVFormatContext* VDFFInputFile::OpenAudioFile()
+{
+	// the file may be already probed by detect_ff
+	AVFormatContext* fmt = VDFFProbeCache::Take(m_path.c_str());
+	if (!fmt) {
+		fmt = open_file(ConvertWideToUtf8(m_path));
+		if (!fmt) {
+			return nullptr;
+		}
+	}
+
+	// no image or image sequence detection, other streams are not read
+	for (unsigned i = 0; i < fmt->nb_streams; i++) {
+		if (fmt->streams[i]->codecpar->codec_type != AVMEDIA_TYPE_AUDIO) {
+			fmt->streams[i]->discard = AVDISCARD_ALL;
+		}
+	}
+
+	return fmt;
+}
+
+AVFormatContext* VDFFInputFile::OpenVideoFile()
+{
+	std::string ff_path = ConvertWideToUtf8(m_path);
+
+	// the file may be already probed by detect_ff
+	AVFormatContext* fmt = VDFFProbeCache::Take(m_path.c_str());
+	int err = 0;
+	if (!fmt) {
+		fmt = open_file(ff_path);
+		if (!fmt) {
+			return nullptr;
+		}
+	}
+
 	is_image = false;
 	is_image_list = false;
 	is_anim_image = false;
@@ -820,16 +985,18 @@ AVFormatContext* VDFFInputFile::OpenVideoFile()
 					std::string str = std::format("{}/{}", r_fr.num, r_fr.den);
 					av_dict_set(&options, "framerate", str.c_str(), 0);
 				}
+				av_dict_free(&m_open_options);
+				av_dict_copy(&m_open_options, options, 0);
 				err = avformat_open_input(&fmt, ff_path.c_str(), fmt_image2, &options);
 				av_dict_free(&options);
 				if (err != 0) {
-					mContext.mpCallbacks->SetError("FFMPEG: Unable to open image sequence.");
+					set_error("FFMPEG: Unable to open image sequence.");
 					avformat_close_input(&fmt);
 					return nullptr;
 				}
 				err = avformat_find_stream_info(fmt, nullptr);
 				if (err < 0) {
-					mContext.mpCallbacks->SetError("FFMPEG: Couldn't find stream information of file.");
+					set_error("FFMPEG: Couldn't find stream information of file.");
 					avformat_close_input(&fmt);
 					return nullptr;
 				}
@@ -940,6 +1107,7 @@ bool VDFFInputFile::GetVideoSource(int index, IVDXVideoSource** ppVS)
 
 	if (!m_pFormatCtx) return false;
 	if (index != 0) return false;
+	if (audio_only) return false;
 
 	index = find_stream(m_pFormatCtx, AVMEDIA_TYPE_VIDEO);
 
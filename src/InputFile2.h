@@ -18,6 +18,7 @@ extern "C"
 
 class VDFFVideoSource;
 class VDFFAudioSource;
+class VDFFDemuxer;
 
 class VDFFInputFileDriver : public vdxunknown<IVDXInputFileDriver>
 {
@@ -36,7 +37,7 @@ public:
 		kFF_AppendSequence = 2,
 	};
 
-	VDFFInputFileDriver(const VDXInputDriverContext& context);
+	VDFFInputFileDriver(const VDXInputDriverContext& context, bool audio_only = false);
 	~VDFFInputFileDriver();
 
 	int		VDXAPIENTRY DetectBySignature(const void* pHeader, int32_t nHeaderSize, const void* pFooter, int32_t nFooterSize, int64_t nFileSize) override;;
@@ -46,6 +47,7 @@ public:
 
 protected:
 	const VDXInputDriverContext& mContext;
+	bool m_audio_only; // the driver of audio files, the files are opened without video
 };
 
 class VDFFInputFileOptions : public vdxunknown<IVDXInputOptions>
@@ -97,6 +99,7 @@ public:
 	int64_t video_start_time = 0;
 	bool auto_append         = false;
 	bool single_file_mode    = false;
+	bool audio_only          = false; // only audio sources are created
 
 	bool is_image_list = false;
 	bool is_image      = false;
@@ -107,7 +110,8 @@ public:
 	int  cfg_frame_buffers = 0;
 	bool cfg_disable_cache = false;
 
-	AVFormatContext* m_pFormatCtx = nullptr;
+	AVFormatContext* m_pFormatCtx = nullptr; // primary context of m_demuxer
+	std::shared_ptr<VDFFDemuxer> m_demuxer;
 	VDFFVideoSource* video_source = nullptr;
 	VDFFAudioSource* audio_source = nullptr;
 	VDFFInputFile*   next_segment = nullptr;
@@ -152,12 +156,20 @@ public:
 	AVFormatContext* getContext(void) { return m_pFormatCtx; }
 	int find_stream(AVFormatContext* fmt, AVMediaType type);
 	AVFormatContext* OpenVideoFile();
+	AVFormatContext* OpenAudioFile();
 	bool detect_image_list(wchar_t* dst, int dst_count, int* start, int* count);
 	void do_auto_append(const wchar_t* szFile);
 
 protected:
 	const VDXInputDriverContext& mContext;
+	AVDictionary* m_open_options = nullptr; // used to open the same file again (image sequence)
+	bool m_defer_errors = false; // set while the segment is opened by another thread
+	std::string m_error;         // the first deferred error
+
+	void set_error(const char* format, ...);
+	AVFormatContext* open_file(const std::string& ff_path);
 	static bool test_append(VDFFInputFile* f0, VDFFInputFile* f1);
+	bool attach_segment(VDFFInputFile* f);
 };
 
 // Don't use INT64_MIN because av_seek_frame may not work correctly. INT32_MIN seems to work fine.
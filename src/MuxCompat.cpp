@@ -0,0 +1,172 @@
+/*
+ * Copyright (C) 2026 v0lt
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include "stdafx.h"
+
+#include "MuxCompat.h"
+#include "Helper.h"
+#include "FileStore.h"
+#include "iobuffer.h"
+#include "Utils/StringUtil.h"
+#include <mutex>
+#include <string>
+#include <vector>
+#include <unordered_set>
+
+namespace {
+	std::mutex s_mutex;
+	std::unordered_set<std::string> s_supported;
+	// failures are kept for the session only and by the extradata too, a muxer can reject
+	// the extradata of a single file
+	std::unordered_set<std::string> s_failed;
+	bool s_loaded = false;
+
+	// the version of the key is part of it, results with other keys are dropped
+	std::string get_version()
+	{
+		return std::format("3 avformat {} avcodec {}", avformat_version(), avcodec_version());
+	}
+
+	std::wstring get_store_path()
+	{
+		const std::wstring dir = VDFFFileStore::GetDir();
+		return dir.empty() ? dir : dir + L"\\muxcompat.txt";
+	}
+
+	std::string make_key(const AVOutputFormat* oformat, const AVStream* st)
+	{
+		const AVCodecParameters* par = st->codecpar;
+		return std::format("{}|{}|{}|{:08x}|{}|{}x{}|{}:{}|{}:{}|{}/{}|{}/{}|{}|{}|{}|{}|{}|{}|{}|{}|{}|{}/{}",
+			oformat->name, (int)par->codec_type, avcodec_get_name(par->codec_id), par->codec_tag,
+			par->format, par->width, par->height,
+			par->sample_aspect_ratio.num, par->sample_aspect_ratio.den, st->sample_aspect_ratio.num, st->sample_aspect_ratio.den,
+			st->avg_frame_rate.num, st->avg_frame_rate.den, st->r_frame_rate.num, st->r_frame_rate.den,
+			par->profile, par->level, (int)par->field_order,
+			par->sample_rate, par->ch_layout.nb_channels, par->block_align, par->frame_size,
+			par->bits_per_coded_sample, (par->extradata_size > 0) ? 1 : 0, st->time_base.num, st->time_base.den);
+	}
+
+	std::string make_failed_key(const std::string& key, const AVCodecParameters* par)
+	{
+		// FNV-1a
+		uint64_t hash = 0xcbf29ce484222325ull;
+		for (int i = 0; i < par->extradata_size; i++) {
+			hash = (hash ^ par->extradata[i]) * 0x100000001b3ull;
+		}
+		return std::format("{}|{:016x}", key, hash);
+	}
+
+	// a line per supported combination: key, tab, 1. The first line is the version of the libraries.
+	void load_results()
+	{
+		const std::wstring path = get_store_path();
+		if (path.empty()) {
+			return;
+		}
+		std::vector<uint8_t> file;
+		if (!VDFFFileStore::LoadFile(path, file, 1024 * 1024)) {
+			return;
+		}
+		const std::string data(file.begin(), file.end());
+
+		size_t pos = data.find('\n');
+		if (pos == std::string::npos || data.compare(0, pos, get_version()) != 0) {
+			return;
+		}
+		while (++pos < data.size()) {
+			const size_t end = data.find('\n', pos);
+			const size_t tab = data.find('\t', pos);
+			if (end == std::string::npos || tab == std::string::npos || tab + 2 != end) {
+				break;
+			}
+			if (data[tab + 1] == '1') {
+				s_supported.insert(data.substr(pos, tab - pos));
+			}
+			pos = end;
+		}
+		DLog(L"VDFFMuxCompat: loaded {} results", s_supported.size());
+	}
+
+	// called with s_mutex held
+	void store_results()
+	{
+		const std::wstring path = get_store_path();
+		if (path.empty()) {
+			return;
+		}
+
+		std::string data = get_version() + "\n";
+		for (const auto& key : s_supported) {
+			data += key;
+			data += "\t1\n";
+		}
+		VDFFFileStore::StoreFile(path, data.data(), data.size());
+	}
+
+	// writes a header and a trailer with the stream into memory
+	bool test_mux(const AVOutputFormat* oformat, const AVStream* src)
+	{
+		IOWBuffer io;
+		int buf_size = 4096;
+		void* buf = av_malloc(buf_size);
+		AVIOContext* avio_ctx = avio_alloc_context((unsigned char*)buf, buf_size, 1, &io, nullptr, &IOWBuffer::Write, &IOWBuffer::Seek);
+		AVFormatContext* ofmt = avformat_alloc_context();
+		ofmt->pb = avio_ctx;
+		ofmt->oformat = oformat;
+		AVStream* st = avformat_new_stream(ofmt, nullptr);
+		avcodec_parameters_copy(st->codecpar, src->codecpar);
+		st->sample_aspect_ratio = src->sample_aspect_ratio;
+		st->avg_frame_rate = src->avg_frame_rate;
+		st->r_frame_rate = st->avg_frame_rate;
+		st->time_base = src->time_base;
+
+		if (st->codecpar->codec_type == AVMEDIA_TYPE_AUDIO) {
+			if (oformat == av_guess_format("mp4", nullptr, nullptr)) {
+				st->codecpar->codec_tag = 0;
+			}
+		}
+
+		const bool ok = avformat_write_header(ofmt, nullptr) >= 0 && av_write_trailer(ofmt) >= 0;
+
+		av_free(avio_ctx->buffer);
+		av_free(avio_ctx);
+		avformat_free_context(ofmt);
+
+		return ok;
+	}
+}
+
+bool VDFFMuxCompat::IsSupported(const AVOutputFormat* oformat, const AVStream* st)
+{
+	const std::string key = make_key(oformat, st);
+	const std::string failed_key = make_failed_key(key, st->codecpar);
+	{
+		std::lock_guard lock(s_mutex);
+		if (!s_loaded) {
+			s_loaded = true;
+			load_results();
+		}
+		if (s_supported.contains(key)) {
+			return true;
+		}
+		if (s_failed.contains(failed_key)) {
+			return false;
+		}
+	}
+
+	const bool ok = test_mux(oformat, st);
+
+	std::lock_guard lock(s_mutex);
+	if (ok) {
+		s_supported.insert(key);
+		store_results();
+	} else {
+		s_failed.insert(failed_key);
+	}
+	DLog(L"VDFFMuxCompat: {} {}", ConvertUtf8ToWide(key), ok ? L"supported" : L"not supported");
+
+	return ok;
+}
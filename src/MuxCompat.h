@@ -0,0 +1,27 @@
+/*
+ * Copyright (C) 2026 v0lt
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#pragma once
+
+extern "C"
+{
+#include <libavformat/avformat.h>
+}
+
+// Cache of container/codec compatibility, for the whole process and persisted in
+// %LOCALAPPDATA%\avlib\muxcompat.txt.
+// A stream is tested by writing a header and a trailer into memory. The result is keyed by
+// the output format, codec, tag and the parameters a muxer may reject (size, pixel/sample
+// format, aspect ratio, frame rate, profile, level, field order, sample rate, channels,
+// block align, frame size, time base, presence of extradata). Only supported combinations are
+// persisted, they are dropped when the FFmpeg libraries or the key change. A failure can come
+// from the extradata of one file, it is kept for the session and keyed by the extradata too.
+
+namespace VDFFMuxCompat
+{
+	// can the stream be muxed in the format
+	bool IsSupported(const AVOutputFormat* oformat, const AVStream* st);
+}
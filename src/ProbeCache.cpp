@@ -0,0 +1,179 @@
+/*
+ * Copyright (C) 2026 v0lt
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include "stdafx.h"
+
+#include "ProbeCache.h"
+#include "Helper.h"
+#include "FileStore.h"
+#include <mutex>
+#include <vector>
+#include <chrono>
+
+extern HINSTANCE hInstance;
+
+namespace {
+	using clock = std::chrono::steady_clock;
+
+	// the file is opened right after detection, anything older was not opened at all
+	constexpr auto kLifetime = std::chrono::seconds(5);
+	// a file dialog can detect several files in a row, each entry keeps the file open
+	constexpr size_t kMaxEntries = 4;
+
+	struct Entry {
+		std::wstring path;
+		uint64_t size = 0;
+		uint64_t write_time = 0;
+		AVFormatContext* fmt = nullptr;
+		clock::time_point time;
+	};
+
+	std::mutex s_mutex;
+	std::vector<Entry> s_entries;
+	// closes the entries that the host did not open, they keep the file open
+	PTP_TIMER s_timer = nullptr;
+
+	// s_mutex must be locked
+	void remove_expired(const clock::time_point now)
+	{
+		std::erase_if(s_entries, [now](Entry& e) {
+			if (now - e.time < kLifetime) {
+				return false;
+			}
+			avformat_close_input(&e.fmt);
+			return true;
+		});
+	}
+
+	// s_mutex must be locked. Sets the timer to the expiry of the oldest entry.
+	void schedule()
+	{
+		if (!s_timer) {
+			return;
+		}
+		if (s_entries.empty()) {
+			SetThreadpoolTimer(s_timer, nullptr, 0, 0);
+			return;
+		}
+		clock::time_point oldest = s_entries.front().time;
+		for (const Entry& e : s_entries) {
+			oldest = std::min(oldest, e.time);
+		}
+		const auto delay = std::chrono::duration_cast<std::chrono::milliseconds>(oldest + kLifetime - clock::now());
+		// negative is relative, in 100 ns units
+		ULARGE_INTEGER due;
+		due.QuadPart = (ULONGLONG)(-std::max<int64_t>(delay.count(), 1) * 10000);
+		FILETIME ft;
+		ft.dwLowDateTime = due.LowPart;
+		ft.dwHighDateTime = due.HighPart;
+		SetThreadpoolTimer(s_timer, &ft, 0, 100);
+	}
+
+	VOID CALLBACK on_timer(PTP_CALLBACK_INSTANCE, PVOID, PTP_TIMER)
+	{
+		std::lock_guard lock(s_mutex);
+		remove_expired(clock::now());
+		schedule();
+	}
+
+	// s_mutex must be locked
+	void create_timer()
+	{
+		if (s_timer) {
+			return;
+		}
+		TP_CALLBACK_ENVIRON env;
+		InitializeThreadpoolEnvironment(&env);
+		// the plugin is not unloaded while the callback runs
+		SetThreadpoolCallbackLibrary(&env, hInstance);
+		s_timer = CreateThreadpoolTimer(on_timer, nullptr, &env);
+		DestroyThreadpoolEnvironment(&env);
+	}
+
+	// closes the cached contexts when the plugin is unloaded
+	struct Cleanup {
+		~Cleanup() { VDFFProbeCache::Clear(); }
+	} s_cleanup;
+}
+
+void VDFFProbeCache::Put(const wchar_t* path, AVFormatContext* fmt)
+{
+	Entry e;
+	if (!path || !VDFFFileStore::GetFileStamp(path, e.size, e.write_time)) {
+		avformat_close_input(&fmt);
+		return;
+	}
+	e.path = path;
+	e.fmt = fmt;
+	e.time = clock::now();
+
+	std::lock_guard lock(s_mutex);
+	remove_expired(e.time);
+	create_timer();
+	auto it = std::find_if(s_entries.begin(), s_entries.end(), [&e](const Entry& old) { return old.path == e.path; });
+	if (it != s_entries.end()) {
+		avformat_close_input(&it->fmt);
+		*it = e;
+	} else {
+		if (s_entries.size() >= kMaxEntries) {
+			avformat_close_input(&s_entries.front().fmt);
+			s_entries.erase(s_entries.begin());
+		}
+		s_entries.push_back(e);
+	}
+	schedule();
+	DLog(L"VDFFProbeCache::Put - {}", path);
+}
+
+AVFormatContext* VDFFProbeCache::Take(const wchar_t* path)
+{
+	if (!path) {
+		return nullptr;
+	}
+
+	uint64_t size, write_time;
+	const bool stamp = VDFFFileStore::GetFileStamp(path, size, write_time);
+
+	std::lock_guard lock(s_mutex);
+	remove_expired(clock::now());
+	for (auto it = s_entries.begin(); it != s_entries.end(); ++it) {
+		if (it->path != path) {
+			continue;
+		}
+		AVFormatContext* fmt = it->fmt;
+		const bool valid = stamp && it->size == size && it->write_time == write_time;
+		s_entries.erase(it);
+		if (!valid) {
+			// the file was changed after detection
+			avformat_close_input(&fmt);
+			return nullptr;
+		}
+		DLog(L"VDFFProbeCache::Take - {}", path);
+		return fmt;
+	}
+
+	return nullptr;
+}
+
+void VDFFProbeCache::Clear()
+{
+	PTP_TIMER timer;
+	{
+		std::lock_guard lock(s_mutex);
+		for (Entry& e : s_entries) {
+			avformat_close_input(&e.fmt);
+		}
+		s_entries.clear();
+		timer = s_timer;
+		s_timer = nullptr;
+	}
+	if (timer) {
+		// a callback that is running finds no timer to set again
+		SetThreadpoolTimer(timer, nullptr, 0, 0);
+		WaitForThreadpoolTimerCallbacks(timer, TRUE);
+		CloseThreadpoolTimer(timer);
+	}
+}
@@ -0,0 +1,29 @@
+/*
+ * Copyright (C) 2026 v0lt
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#pragma once
+
+#include <string>
+
+extern "C"
+{
+#include <libavformat/avformat.h>
+}
+
+// Short-lived cache of probed format contexts.
+// The host detects a file by signature and opens it right after that. A context that
+// detect_ff had to open and probe is kept here and taken by VDFFInputFile::OpenVideoFile,
+// so the headers are parsed and the streams probed only once.
+// A context that is not taken is closed by a timer a few seconds later, it keeps the file open.
+
+namespace VDFFProbeCache
+{
+	// takes ownership of fmt (opened and probed with avformat_find_stream_info)
+	void Put(const wchar_t* path, AVFormatContext* fmt);
+	// returns a context of the unchanged file and removes it from the cache, nullptr if there is none
+	AVFormatContext* Take(const wchar_t* path);
+	void Clear();
+}
@@ -0,0 +1,437 @@
+/*
+ * Copyright (C) 2026 v0lt
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include "stdafx.h"
+
+#include "ProbeStore.h"
+#include "Helper.h"
+#include "FileStore.h"
+#include "Utils/StringUtil.h"
+#include <vector>
+#include <mutex>
+
+extern bool config_probe_cache;
+
+namespace {
+	constexpr uint32_t kMagic   = 0x43505641; // 'AVPC'
+	constexpr uint32_t kVersion = 1;
+
+	constexpr int64_t kHashSize = 1024 * 1024;
+	constexpr int kMaxEntries = 2000;
+
+	// limits of the probe when the parameters are known
+	constexpr int64_t kShortProbeSize = 64 * 1024;
+	constexpr int64_t kShortAnalyzeDuration = AV_TIME_BASE / 10;
+
+	std::mutex s_mutex; // directory updates
+	// entries in the folder, counted by the first trim of the process. Later trims only run
+	// when the entries that this process added pass the limit.
+	int s_entry_count = -1;
+
+	struct FileKey {
+		std::wstring path;
+		uint64_t size = 0;
+		uint64_t write_time = 0;
+		uint64_t hash = 0;
+	};
+
+	uint64_t fnv1a(const uint8_t* p, const size_t size, uint64_t hash = 0xcbf29ce484222325ull)
+	{
+		for (size_t i = 0; i < size; i++) {
+			hash = (hash ^ p[i]) * 0x100000001b3ull;
+		}
+		return hash;
+	}
+
+	bool get_file_key(const wchar_t* path, FileKey& key)
+	{
+		HANDLE h = CreateFileW(path, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+		if (h == INVALID_HANDLE_VALUE) {
+			return false;
+		}
+
+		bool ret = false;
+		BY_HANDLE_FILE_INFORMATION fi;
+		if (GetFileInformationByHandle(h, &fi)) {
+			key.path = path;
+			key.size = (uint64_t(fi.nFileSizeHigh) << 32) | fi.nFileSizeLow;
+			key.write_time = (uint64_t(fi.ftLastWriteTime.dwHighDateTime) << 32) | fi.ftLastWriteTime.dwLowDateTime;
+
+			std::vector<uint8_t> buf((size_t)std::min<uint64_t>(key.size, kHashSize));
+			DWORD read = 0;
+			if (buf.empty() || ReadFile(h, buf.data(), (DWORD)buf.size(), &read, nullptr)) {
+				key.hash = fnv1a(buf.data(), read);
+				ret = (read == buf.size());
+			}
+		}
+		CloseHandle(h);
+
+		return ret;
+	}
+
+	std::wstring get_entry_path(const std::wstring& dir, const std::wstring& path)
+	{
+		return std::format(L"{}\\{:016x}.bin", dir, VDFFFileStore::HashPath(path));
+	}
+
+	class Writer
+	{
+	public:
+		std::vector<uint8_t> data;
+
+		template <typename T>
+		void put(const T& v)
+		{
+			const uint8_t* p = (const uint8_t*)&v;
+			data.insert(data.end(), p, p + sizeof(T));
+		}
+		void put_bytes(const uint8_t* p, const int size)
+		{
+			put(size);
+			if (size > 0) {
+				data.insert(data.end(), p, p + size);
+			}
+		}
+		void put_string(const std::string_view s)
+		{
+			put_bytes((const uint8_t*)s.data(), (int)s.size());
+		}
+	};
+
+	class Reader
+	{
+	public:
+		Reader(const std::vector<uint8_t>& data) : m_data(data) {}
+
+		bool ok() const { return !m_error; }
+
+		template <typename T>
+		T get()
+		{
+			T v = {};
+			if (m_pos + sizeof(T) > m_data.size()) {
+				m_error = true;
+				return v;
+			}
+			memcpy(&v, &m_data[m_pos], sizeof(T));
+			m_pos += sizeof(T);
+			return v;
+		}
+		const uint8_t* get_bytes(int& size)
+		{
+			size = get<int>();
+			if (size < 0 || m_pos + size > m_data.size()) {
+				m_error = true;
+				size = 0;
+				return nullptr;
+			}
+			const uint8_t* p = m_data.data() + m_pos;
+			m_pos += size;
+			return p;
+		}
+		std::string get_string()
+		{
+			int size;
+			const uint8_t* p = get_bytes(size);
+			return std::string((const char*)p, size);
+		}
+
+	private:
+		const std::vector<uint8_t>& m_data;
+		size_t m_pos = 0;
+		bool m_error = false;
+	};
+
+	void write_key(Writer& w, const FileKey& key)
+	{
+		w.put(kMagic);
+		w.put(kVersion);
+		w.put_string(ConvertWideToUtf8(key.path));
+		w.put(key.size);
+		w.put(key.write_time);
+		w.put(key.hash);
+	}
+
+	bool read_key(Reader& r, const FileKey& key)
+	{
+		if (r.get<uint32_t>() != kMagic || r.get<uint32_t>() != kVersion) {
+			return false;
+		}
+		const std::string path = r.get_string();
+		const uint64_t size = r.get<uint64_t>();
+		const uint64_t write_time = r.get<uint64_t>();
+		const uint64_t hash = r.get<uint64_t>();
+		return r.ok() && path == ConvertWideToUtf8(key.path) && size == key.size && write_time == key.write_time && hash == key.hash;
+	}
+
+	void write_params(Writer& w, const AVCodecParameters* par)
+	{
+		w.put(par->codec_type);
+		w.put(par->codec_id);
+		w.put(par->codec_tag);
+		w.put_bytes(par->extradata, par->extradata_size);
+		w.put(par->nb_coded_side_data);
+		for (int i = 0; i < par->nb_coded_side_data; i++) {
+			const AVPacketSideData& sd = par->coded_side_data[i];
+			w.put(sd.type);
+			w.put_bytes(sd.data, (int)sd.size);
+		}
+		w.put(par->format);
+		w.put(par->bit_rate);
+		w.put(par->bits_per_coded_sample);
+		w.put(par->bits_per_raw_sample);
+		w.put(par->profile);
+		w.put(par->level);
+		w.put(par->width);
+		w.put(par->height);
+		w.put(par->sample_aspect_ratio);
+		w.put(par->framerate);
+		w.put(par->field_order);
+		w.put(par->color_range);
+		w.put(par->color_primaries);
+		w.put(par->color_trc);
+		w.put(par->color_space);
+		w.put(par->chroma_location);
+		w.put(par->video_delay);
+		// custom channel maps are not stored, only the channel count
+		const bool native = (par->ch_layout.order == AV_CHANNEL_ORDER_NATIVE || par->ch_layout.order == AV_CHANNEL_ORDER_AMBISONIC);
+		w.put(native ? par->ch_layout.order : AV_CHANNEL_ORDER_UNSPEC);
+		w.put(par->ch_layout.nb_channels);
+		w.put(native ? par->ch_layout.u.mask : uint64_t(0));
+		w.put(par->sample_rate);
+		w.put(par->block_align);
+		w.put(par->frame_size);
+		w.put(par->initial_padding);
+		w.put(par->trailing_padding);
+		w.put(par->seek_preroll);
+	}
+
+	bool read_params(Reader& r, AVCodecParameters* par)
+	{
+		par->codec_type = r.get<AVMediaType>();
+		par->codec_id   = r.get<AVCodecID>();
+		par->codec_tag  = r.get<uint32_t>();
+
+		int size;
+		const uint8_t* p = r.get_bytes(size);
+		if (size > 0) {
+			par->extradata = (uint8_t*)av_mallocz(size + AV_INPUT_BUFFER_PADDING_SIZE);
+			if (!par->extradata) {
+				return false;
+			}
+			memcpy(par->extradata, p, size);
+			par->extradata_size = size;
+		}
+		const int nb_side_data = r.get<int>();
+		for (int i = 0; i < nb_side_data && r.ok(); i++) {
+			const AVPacketSideDataType type = r.get<AVPacketSideDataType>();
+			p = r.get_bytes(size);
+			if (!av_packet_side_data_new(&par->coded_side_data, &par->nb_coded_side_data, type, size, 0)) {
+				return false;
+			}
+			memcpy(par->coded_side_data[par->nb_coded_side_data - 1].data, p, size);
+		}
+
+		par->format = r.get<int>();
+		par->bit_rate = r.get<int64_t>();
+		par->bits_per_coded_sample = r.get<int>();
+		par->bits_per_raw_sample = r.get<int>();
+		par->profile = r.get<int>();
+		par->level = r.get<int>();
+		par->width = r.get<int>();
+		par->height = r.get<int>();
+		par->sample_aspect_ratio = r.get<AVRational>();
+		par->framerate = r.get<AVRational>();
+		par->field_order = r.get<AVFieldOrder>();
+		par->color_range = r.get<AVColorRange>();
+		par->color_primaries = r.get<AVColorPrimaries>();
+		par->color_trc = r.get<AVColorTransferCharacteristic>();
+		par->color_space = r.get<AVColorSpace>();
+		par->chroma_location = r.get<AVChromaLocation>();
+		par->video_delay = r.get<int>();
+		av_channel_layout_uninit(&par->ch_layout);
+		par->ch_layout.order = r.get<AVChannelOrder>();
+		par->ch_layout.nb_channels = r.get<int>();
+		par->ch_layout.u.mask = r.get<uint64_t>();
+		par->sample_rate = r.get<int>();
+		par->block_align = r.get<int>();
+		par->frame_size = r.get<int>();
+		par->initial_padding = r.get<int>();
+		par->trailing_padding = r.get<int>();
+		par->seek_preroll = r.get<int>();
+
+		return r.ok();
+	}
+
+	void write_entry(Writer& w, const FileKey& key, const AVFormatContext* fmt)
+	{
+		write_key(w, key);
+		w.put_string(fmt->iformat->name);
+		w.put(fmt->start_time);
+		w.put(fmt->duration);
+		w.put(fmt->bit_rate);
+		w.put(fmt->nb_streams);
+		for (unsigned i = 0; i < fmt->nb_streams; i++) {
+			const AVStream* st = fmt->streams[i];
+			write_params(w, st->codecpar);
+			w.put(st->time_base);
+			w.put(st->start_time);
+			w.put(st->duration);
+			w.put(st->nb_frames);
+			w.put(st->sample_aspect_ratio);
+			w.put(st->avg_frame_rate);
+			w.put(st->r_frame_rate);
+		}
+	}
+
+	// fills the stream parameters of a context probed with small limits
+	bool apply_entry(Reader& r, AVFormatContext* fmt)
+	{
+		if (r.get_string() != fmt->iformat->name) {
+			return false;
+		}
+		const int64_t start_time = r.get<int64_t>();
+		const int64_t duration = r.get<int64_t>();
+		const int64_t bit_rate = r.get<int64_t>();
+		const unsigned nb_streams = r.get<unsigned>();
+		if (!r.ok() || nb_streams != fmt->nb_streams) {
+			return false;
+		}
+
+		struct StreamInfo {
+			AVRational time_base;
+			int64_t start_time;
+			int64_t duration;
+			int64_t nb_frames;
+			AVRational sample_aspect_ratio;
+			AVRational avg_frame_rate;
+			AVRational r_frame_rate;
+		};
+		std::vector<AVCodecParameters*> params;
+		std::vector<StreamInfo> info(nb_streams);
+		bool ok = true;
+
+		for (unsigned i = 0; i < nb_streams && ok; i++) {
+			AVCodecParameters* par = avcodec_parameters_alloc();
+			if (!par) {
+				ok = false;
+				break;
+			}
+			params.push_back(par);
+			ok = read_params(r, par);
+
+			StreamInfo& si = info[i];
+			si.time_base = r.get<AVRational>();
+			si.start_time = r.get<int64_t>();
+			si.duration = r.get<int64_t>();
+			si.nb_frames = r.get<int64_t>();
+			si.sample_aspect_ratio = r.get<AVRational>();
+			si.avg_frame_rate = r.get<AVRational>();
+			si.r_frame_rate = r.get<AVRational>();
+
+			// the short probe must find the same streams
+			const AVStream* st = fmt->streams[i];
+			if (!r.ok() || par->codec_type != st->codecpar->codec_type || par->codec_id != st->codecpar->codec_id
+					|| av_cmp_q(si.time_base, st->time_base) != 0) {
+				ok = false;
+			}
+		}
+
+		if (ok) {
+			for (unsigned i = 0; i < nb_streams; i++) {
+				AVStream* st = fmt->streams[i];
+				const StreamInfo& si = info[i];
+				avcodec_parameters_copy(st->codecpar, params[i]);
+				st->start_time = si.start_time;
+				st->duration = si.duration;
+				st->nb_frames = si.nb_frames;
+				st->sample_aspect_ratio = si.sample_aspect_ratio;
+				st->avg_frame_rate = si.avg_frame_rate;
+				st->r_frame_rate = si.r_frame_rate;
+			}
+			fmt->start_time = start_time;
+			fmt->duration = duration;
+			fmt->bit_rate = bit_rate;
+		}
+
+		for (AVCodecParameters* par : params) {
+			avcodec_parameters_free(&par);
+		}
+
+		return ok;
+	}
+
+	void store_entry(const FileKey& key, const AVFormatContext* fmt)
+	{
+		const std::wstring dir = VDFFFileStore::GetDir(L"probe");
+		if (dir.empty()) {
+			return;
+		}
+
+		Writer w;
+		write_entry(w, key, fmt);
+
+		const std::wstring entry_path = get_entry_path(dir, key.path);
+		std::lock_guard lock(s_mutex);
+		const bool added = (GetFileAttributesW(entry_path.c_str()) == INVALID_FILE_ATTRIBUTES);
+		if (!VDFFFileStore::StoreFile(entry_path, w.data.data(), w.data.size())) {
+			return;
+		}
+		if (s_entry_count < 0 || (added && ++s_entry_count > kMaxEntries)) {
+			s_entry_count = (int)VDFFFileStore::Trim(dir, L"*.bin", kMaxEntries);
+		}
+		DLog(L"VDFFProbeStore: stored {}", key.path);
+	}
+}
+
+int VDFFProbeStore::FindStreamInfo(const wchar_t* path, AVFormatContext** pfmt)
+{
+	FileKey key;
+	const bool use_store = config_probe_cache && path && get_file_key(path, key);
+
+	std::vector<uint8_t> entry;
+	const std::wstring dir = use_store ? VDFFFileStore::GetDir(L"probe") : std::wstring();
+	const std::wstring entry_path = dir.empty() ? std::wstring() : get_entry_path(dir, key.path);
+	if (!dir.empty() && VDFFFileStore::LoadFile(entry_path, entry, 64 * 1024 * 1024)) {
+		Reader r(entry);
+		if (read_key(r, key)) {
+			AVFormatContext* fmt = *pfmt;
+			const int64_t probesize = fmt->probesize;
+			const int64_t max_analyze_duration = fmt->max_analyze_duration;
+			fmt->probesize = kShortProbeSize;
+			fmt->max_analyze_duration = kShortAnalyzeDuration;
+			int err = avformat_find_stream_info(fmt, nullptr);
+			fmt->probesize = probesize;
+			fmt->max_analyze_duration = max_analyze_duration;
+
+			if (err >= 0 && apply_entry(r, fmt)) {
+				// the least recently used entries are removed first
+				VDFFFileStore::Touch(entry_path);
+				DLog(L"VDFFProbeStore: using stored probe result for {}", key.path);
+				return err;
+			}
+
+			// the file does not match the stored result, open it again for a full probe
+			DLog(L"VDFFProbeStore: stored probe result does not match {}", key.path);
+			const std::string url(fmt->url);
+			const AVInputFormat* iformat = fmt->iformat;
+			const unsigned int max_index_size = fmt->max_index_size;
+			avformat_close_input(pfmt);
+			err = avformat_open_input(pfmt, url.c_str(), iformat, nullptr);
+			if (err < 0) {
+				return err;
+			}
+			(*pfmt)->max_index_size = max_index_size;
+		}
+	}
+
+	int err = avformat_find_stream_info(*pfmt, nullptr);
+	if (err >= 0 && use_store) {
+		store_entry(key, *pfmt);
+	}
+
+	return err;
+}
@@ -0,0 +1,26 @@
+/*
+ * Copyright (C) 2026 v0lt
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#pragma once
+
+extern "C"
+{
+#include <libavformat/avformat.h>
+}
+
+// Persistent cache of probe results in %LOCALAPPDATA%\avlib\probe.
+// An entry holds the codec parameters (with extradata and side data), stream timing and
+// the duration found by avformat_find_stream_info. It is keyed by path, file size,
+// write time and a hash of the first megabyte of the file.
+// A file that is opened again is probed with small limits and the stored parameters are filled in.
+// The least recently used entries are removed when the store grows past its limit.
+
+namespace VDFFProbeStore
+{
+	// replaces avformat_find_stream_info for a context opened from path.
+	// The context is reopened if the stored result does not match the file, *pfmt is nullptr if that fails.
+	int FindStreamInfo(const wchar_t* path, AVFormatContext** pfmt);
+}
@@ -0,0 +1,425 @@
+/*
+ * Copyright (C) 2026 v0lt
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include "stdafx.h"
+
+#include "SmartRender.h"
+
+extern "C"
+{
+#include <libavutil/opt.h>
+}
+
+namespace {
+
+// the encoders of VideoEnc_x264 and VideoEnc_x265
+const AVCodec* find_encoder(const AVCodecID codec_id)
+{
+	switch (codec_id) {
+	case AV_CODEC_ID_H264: return avcodec_find_encoder_by_name("libx264");
+	case AV_CODEC_ID_HEVC: return avcodec_find_encoder_by_name("libx265");
+	default: return nullptr;
+	}
+}
+
+// size of the NAL unit length field of avcC/hvcC, 0 for Annex B
+int nal_length_size(const AVCodecParameters* par)
+{
+	const uint8_t* ed = par->extradata;
+	if (!ed || ed[0] != 1) {
+		return 0;
+	}
+	if (par->codec_id == AV_CODEC_ID_H264 && par->extradata_size >= 7) {
+		return (ed[4] & 3) + 1;
+	}
+	if (par->codec_id == AV_CODEC_ID_HEVC && par->extradata_size >= 23) {
+		return (ed[21] & 3) + 1;
+	}
+	return 0;
+}
+
+// the profile of the encoder that writes the profile of the stream for its pixel format
+// (x264 and x265 derive the profile from the format), nullptr if there is none
+const char* encoder_profile(const AVCodecParameters* par)
+{
+	const AVPixelFormat format = (AVPixelFormat)par->format;
+	if (par->codec_id == AV_CODEC_ID_H264) {
+		switch (par->profile) {
+		case AV_PROFILE_H264_BASELINE:
+		case AV_PROFILE_H264_CONSTRAINED_BASELINE:
+			return (format == AV_PIX_FMT_YUV420P) ? "baseline" : nullptr;
+		case AV_PROFILE_H264_MAIN:
+			return (format == AV_PIX_FMT_YUV420P) ? "main" : nullptr;
+		case AV_PROFILE_H264_HIGH:
+			return (format == AV_PIX_FMT_YUV420P) ? "high" : nullptr;
+		case AV_PROFILE_H264_HIGH_10:
+			return (format == AV_PIX_FMT_YUV420P10) ? "high10" : nullptr;
+		case AV_PROFILE_H264_HIGH_422:
+			return (format == AV_PIX_FMT_YUV422P || format == AV_PIX_FMT_YUV422P10) ? "high422" : nullptr;
+		case AV_PROFILE_H264_HIGH_444_PREDICTIVE:
+			return (format == AV_PIX_FMT_YUV444P || format == AV_PIX_FMT_YUV444P10) ? "high444" : nullptr;
+		}
+	}
+	else if (par->codec_id == AV_CODEC_ID_HEVC) {
+		switch (par->profile) {
+		case AV_PROFILE_HEVC_MAIN:
+			return (format == AV_PIX_FMT_YUV420P) ? "main" : nullptr;
+		case AV_PROFILE_HEVC_MAIN_10:
+			return (format == AV_PIX_FMT_YUV420P10) ? "main10" : nullptr;
+		case AV_PROFILE_HEVC_REXT:
+			switch (format) {
+			case AV_PIX_FMT_YUV444P:   return "main444-8";
+			case AV_PIX_FMT_YUV422P10: return "main422-10";
+			case AV_PIX_FMT_YUV444P10: return "main444-10";
+			case AV_PIX_FMT_YUV420P12: return "main12";
+			case AV_PIX_FMT_YUV422P12: return "main422-12";
+			case AV_PIX_FMT_YUV444P12: return "main444-12";
+			default: break;
+			}
+			break;
+		}
+	}
+	return nullptr;
+}
+
+bool is_interlaced(const AVCodecParameters* par)
+{
+	return par->field_order != AV_FIELD_UNKNOWN && par->field_order != AV_FIELD_PROGRESSIVE;
+}
+
+// general_tier_flag of hvcC
+bool hevc_high_tier(const AVCodecParameters* par)
+{
+	return par->extradata && par->extradata_size >= 23 && par->extradata[0] == 1 && (par->extradata[1] & 0x20);
+}
+
+void append_nal(std::vector<uint8_t>& out, const uint8_t* nal, const size_t size, const int length_size)
+{
+	for (int i = length_size - 1; i >= 0; i--) {
+		out.push_back(uint8_t(size >> (i * 8)));
+	}
+	out.insert(out.end(), nal, nal + size);
+}
+
+// the byte after the next start code, end if there is none
+const uint8_t* next_nal(const uint8_t* p, const uint8_t* end)
+{
+	for (; p + 3 <= end; p++) {
+		if (p[0] == 0 && p[1] == 0 && p[2] == 1) {
+			return p + 3;
+		}
+	}
+	return end;
+}
+
+void annexb_to_length_prefixed(const uint8_t* data, const int size, const int length_size, std::vector<uint8_t>& out)
+{
+	const uint8_t* end = data + size;
+	const uint8_t* nal = next_nal(data, end);
+	while (nal < end) {
+		const uint8_t* next = next_nal(nal, end);
+		const uint8_t* nal_end = (next < end) ? next - 3 : end;
+		// the zero byte of a four byte start code
+		while (nal_end > nal && nal_end[-1] == 0) {
+			nal_end--;
+		}
+		append_nal(out, nal, nal_end - nal, length_size);
+		nal = next;
+	}
+}
+
+} // namespace
+
+bool VDFFGopEncoder::IsSupported(const AVStream* st)
+{
+	const AVCodecParameters* par = st->codecpar;
+	if (par->codec_type != AVMEDIA_TYPE_VIDEO || par->width <= 0 || par->height <= 0) {
+		return false;
+	}
+	const AVCodec* encoder = find_encoder(par->codec_id);
+	if (!encoder || !avcodec_find_decoder(par->codec_id)) {
+		return false;
+	}
+	// the parameter sets of the re-encoded frames must not contradict the sample entry
+	if (!encoder_profile(par) || par->level <= 0) {
+		return false;
+	}
+	if (par->codec_id == AV_CODEC_ID_HEVC && is_interlaced(par)) {
+		return false;
+	}
+
+	const void* formats = nullptr;
+	int count = 0;
+	if (avcodec_get_supported_config(nullptr, encoder, AV_CODEC_CONFIG_PIX_FORMAT, 0, &formats, &count) < 0) {
+		return false;
+	}
+	if (!formats) {
+		return true;
+	}
+	for (int i = 0; i < count; i++) {
+		if (static_cast<const AVPixelFormat*>(formats)[i] == par->format) {
+			return true;
+		}
+	}
+	return false;
+}
+
+int VDFFGopEncoder::Init(const AVStream* st, int64_t from, int64_t to, const VDFFGopSettings& settings)
+{
+	Close();
+
+	const AVCodecParameters* par = st->codecpar;
+	m_from = from;
+	m_to = to;
+	m_nal_length_size = nal_length_size(par);
+	m_first = true;
+
+	const AVCodec* decoder = avcodec_find_decoder(par->codec_id);
+	const AVCodec* encoder = find_encoder(par->codec_id);
+	if (!decoder || !encoder) {
+		return AVERROR_ENCODER_NOT_FOUND;
+	}
+
+	m_dec = avcodec_alloc_context3(decoder);
+	m_enc = avcodec_alloc_context3(encoder);
+	m_frame = av_frame_alloc();
+	m_pkt = av_packet_alloc();
+	if (!m_dec || !m_enc || !m_frame || !m_pkt) {
+		return AVERROR(ENOMEM);
+	}
+
+	int err = avcodec_parameters_to_context(m_dec, par);
+	if (err < 0) {
+		return err;
+	}
+	m_dec->pkt_timebase = st->time_base;
+	m_dec->thread_count = 0;
+	err = avcodec_open2(m_dec, decoder, nullptr);
+	if (err < 0) {
+		return err;
+	}
+
+	m_enc->width = par->width;
+	m_enc->height = par->height;
+	m_enc->pix_fmt = (AVPixelFormat)par->format;
+	m_enc->sample_aspect_ratio = par->sample_aspect_ratio;
+	m_enc->color_range = par->color_range;
+	m_enc->color_primaries = par->color_primaries;
+	m_enc->color_trc = par->color_trc;
+	m_enc->colorspace = par->color_space;
+	m_enc->chroma_sample_location = par->chroma_location;
+	m_enc->time_base = st->time_base;
+	if (st->avg_frame_rate.num > 0 && st->avg_frame_rate.den > 0) {
+		m_enc->framerate = st->avg_frame_rate;
+	}
+	// one keyframe at the start, the rest of the GOP is shorter than any sensible limit
+	m_enc->gop_size = 1 << 30;
+	m_enc->max_b_frames = 0;
+	m_enc->thread_count = 0;
+	m_enc->profile = par->profile;
+	m_enc->level = par->level;
+	m_enc->field_order = par->field_order;
+	if (is_interlaced(par)) {
+		m_enc->flags |= AV_CODEC_FLAG_INTERLACED_DCT;
+	}
+	// no AV_CODEC_FLAG_GLOBAL_HEADER: the parameter sets are written in-band
+
+	av_opt_set(m_enc->priv_data, "preset", settings.preset.c_str(), 0);
+	if (!settings.tune.empty()) {
+		av_opt_set(m_enc->priv_data, "tune", settings.tune.c_str(), 0);
+	}
+	av_opt_set_double(m_enc->priv_data, "crf", settings.crf, 0);
+	av_opt_set(m_enc->priv_data, "profile", encoder_profile(par), 0);
+
+	// the wrappers do not pass the level of the context to every encoder
+	if (par->codec_id == AV_CODEC_ID_H264) {
+		const std::string level = (par->level == 9) ? "1b" : std::to_string(par->level / 10) + "." + std::to_string(par->level % 10);
+		av_opt_set(m_enc->priv_data, "level", level.c_str(), 0);
+		// x264 derives the profile from the tools: High needs the 8x8 transform, Main CABAC
+		if (par->profile == AV_PROFILE_H264_HIGH) {
+			av_opt_set(m_enc->priv_data, "x264-params", "8x8dct=1", 0);
+		} else if (par->profile == AV_PROFILE_H264_MAIN) {
+			av_opt_set(m_enc->priv_data, "x264-params", "cabac=1", 0);
+		}
+	} else {
+		// general_level_idc is 30 times the level
+		const std::string params = "log-level=error:level-idc=" + std::to_string(par->level / 30) + "." + std::to_string(par->level % 30 / 3)
+			+ (hevc_high_tier(par) ? ":high-tier=1" : ":high-tier=0");
+		av_opt_set(m_enc->priv_data, "x265-params", params.c_str(), 0);
+	}
+
+	return avcodec_open2(m_enc, encoder, nullptr);
+}
+
+void VDFFGopEncoder::Close()
+{
+	avcodec_free_context(&m_dec);
+	avcodec_free_context(&m_enc);
+	av_frame_free(&m_frame);
+	av_packet_free(&m_pkt);
+	for (auto& p : m_packets) {
+		av_packet_free(&p);
+	}
+	m_packets.clear();
+}
+
+int VDFFGopEncoder::Decode(const AVPacket* pkt)
+{
+	int err = avcodec_send_packet(m_dec, pkt);
+	// leading pictures that refer to the previous GOP are skipped
+	if (err < 0 && err != AVERROR_INVALIDDATA) {
+		return err;
+	}
+	return receive_frames();
+}
+
+int VDFFGopEncoder::Finish(std::vector<AVPacket*>& out)
+{
+	int err = avcodec_send_packet(m_dec, nullptr);
+	if (err >= 0) {
+		err = receive_frames();
+	}
+	if (err >= 0) {
+		err = encode(nullptr);
+	}
+	if (err >= 0) {
+		out.insert(out.end(), m_packets.begin(), m_packets.end());
+		m_packets.clear();
+	}
+	return err;
+}
+
+int VDFFGopEncoder::receive_frames()
+{
+	int err;
+	while ((err = avcodec_receive_frame(m_dec, m_frame)) >= 0) {
+		const int64_t t = m_frame->best_effort_timestamp;
+		if (t != AV_NOPTS_VALUE && t >= m_from && t < m_to) {
+			m_frame->pts = t;
+			m_frame->pict_type = m_first ? AV_PICTURE_TYPE_I : AV_PICTURE_TYPE_NONE;
+			m_first = false;
+			err = encode(m_frame);
+		}
+		av_frame_unref(m_frame);
+		if (err < 0) {
+			return err;
+		}
+	}
+	return (err == AVERROR(EAGAIN) || err == AVERROR_EOF) ? 0 : err;
+}
+
+int VDFFGopEncoder::encode(AVFrame* frame)
+{
+	int err = avcodec_send_frame(m_enc, frame);
+	if (err < 0) {
+		return err;
+	}
+	while ((err = avcodec_receive_packet(m_enc, m_pkt)) >= 0) {
+		err = append_packet(m_pkt);
+		av_packet_unref(m_pkt);
+		if (err < 0) {
+			return err;
+		}
+	}
+	return (err == AVERROR(EAGAIN) || err == AVERROR_EOF) ? 0 : err;
+}
+
+int VDFFGopEncoder::append_packet(AVPacket* pkt)
+{
+	AVPacket* out = av_packet_alloc();
+	if (!out) {
+		return AVERROR(ENOMEM);
+	}
+
+	if (m_nal_length_size) {
+		std::vector<uint8_t> data;
+		data.reserve(pkt->size + 16);
+		annexb_to_length_prefixed(pkt->data, pkt->size, m_nal_length_size, data);
+		int err = av_new_packet(out, (int)data.size());
+		if (err >= 0) {
+			err = av_packet_copy_props(out, pkt);
+		}
+		if (err < 0) {
+			av_packet_free(&out);
+			return err;
+		}
+		memcpy(out->data, data.data(), data.size());
+	} else {
+		av_packet_move_ref(out, pkt);
+	}
+
+	out->dts = out->pts;
+	m_packets.push_back(out);
+	return 0;
+}
+
+std::vector<uint8_t> GetParameterSets(const AVCodecParameters* par)
+{
+	std::vector<uint8_t> out;
+	const uint8_t* p = par->extradata;
+	const uint8_t* end = p + par->extradata_size;
+	if (!p || par->extradata_size < 4) {
+		return out;
+	}
+
+	const int length_size = nal_length_size(par);
+	if (!length_size) {
+		// Annex B extradata has the format of the packets
+		if (par->codec_id == AV_CODEC_ID_H264 || par->codec_id == AV_CODEC_ID_HEVC) {
+			out.assign(p, end);
+		}
+		return out;
+	}
+
+	auto read_nal = [&]() {
+		if (end - p < 2) {
+			return false;
+		}
+		const size_t size = (p[0] << 8) | p[1];
+		p += 2;
+		if (size > size_t(end - p)) {
+			return false;
+		}
+		append_nal(out, p, size, length_size);
+		p += size;
+		return true;
+	};
+
+	if (par->codec_id == AV_CODEC_ID_H264) {
+		// avcC: SPS count in the low 5 bits, then the PPS count
+		p += 5;
+		for (int n = *p++ & 0x1f; n > 0; n--) {
+			if (!read_nal()) {
+				return {};
+			}
+		}
+		if (p >= end) {
+			return {};
+		}
+		for (int n = *p++; n > 0; n--) {
+			if (!read_nal()) {
+				return {};
+			}
+		}
+	} else {
+		// hvcC: arrays of VPS, SPS, PPS and SEI
+		p += 22;
+		for (int arrays = *p++; arrays > 0; arrays--) {
+			if (end - p < 3) {
+				return {};
+			}
+			int n = (p[1] << 8) | p[2];
+			p += 3;
+			for (; n > 0; n--) {
+				if (!read_nal()) {
+					return {};
+				}
+			}
+		}
+	}
+
+	return out;
+}
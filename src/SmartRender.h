@@ -0,0 +1,74 @@
+/*
+ * Copyright (C) 2026 v0lt
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+extern "C"
+{
+#include <libavcodec/avcodec.h>
+#include <libavformat/avformat.h>
+}
+
+// Re-encoding of the partial GOP at a cut, so that a stream copy can start and end at any frame.
+// The GOP is decoded from its keyframe and the frames in [from, to) are encoded with the
+// encoder of the same codec that the VideoEnc_* classes use (libx264, libx265), with the size,
+// pixel format, colorimetry, profile, level and field order of the stream, so that the in-band
+// parameter sets agree with the sample entry (avcC/hvcC). The packets can be spliced into the
+// copied packets: the parameter sets are in-band and the NAL units are length-prefixed if the
+// stream is stored that way. The encoder makes no B-frames, so dts is equal to pts.
+
+// rate control of the re-encoded frames, the settings of VideoEnc_x264/VideoEnc_x265
+struct VDFFGopSettings {
+	std::string preset = "medium";
+	std::string tune; // empty is none
+	int crf = 23;
+};
+
+class VDFFGopEncoder
+{
+public:
+	~VDFFGopEncoder() { Close(); }
+
+	// the codec, the encoder, the pixel format, the profile, the level and the field order of
+	// the stream are supported
+	static bool IsSupported(const AVStream* st);
+
+	// timestamps are in the time base of the stream
+	int Init(const AVStream* st, int64_t from, int64_t to, const VDFFGopSettings& settings);
+	void Close();
+	// moves 'from' before the frames at or after it are decoded
+	void SetStart(int64_t from) { m_from = from; }
+	// moves 'to' before the frames at or after it are decoded
+	void SetEnd(int64_t to) { m_to = to; }
+
+	// packets of the stream in decode order, starting at the keyframe at or before 'from'
+	int Decode(const AVPacket* pkt);
+	// flushes the decoder and the encoder, the encoded packets are appended to out
+	int Finish(std::vector<AVPacket*>& out);
+
+private:
+	int receive_frames();
+	int encode(AVFrame* frame);
+	int append_packet(AVPacket* pkt);
+
+	AVCodecContext* m_dec = nullptr;
+	AVCodecContext* m_enc = nullptr;
+	AVFrame* m_frame = nullptr;
+	AVPacket* m_pkt = nullptr;
+	std::vector<AVPacket*> m_packets;
+	int64_t m_from = 0;
+	int64_t m_to = 0;
+	int m_nal_length_size = 0; // 0 if the stream uses start codes
+	bool m_first = true;
+};
+
+// the parameter sets of the stream (SPS, PPS, VPS) in the packet format of the stream,
+// prepended to a copied keyframe that follows re-encoded frames. Empty if there are none.
+std::vector<uint8_t> GetParameterSets(const AVCodecParameters* par);
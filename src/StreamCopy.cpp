@@ -0,0 +1,1011 @@
+/*
+ * Copyright (C) 2026 v0lt
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include "stdafx.h"
+
+#include "StreamCopy.h"
+#include "SmartRender.h"
+#include "AsyncWriter.h"
+#include <algorithm>
+#include <cstring>
+#include <memory>
+
+namespace {
+
+// a packet of a selected stream with its times
+struct Queued {
+	AVPacket* pkt;
+	int sel;
+	int64_t t;     // time base of the stream
+	int64_t t_ref; // time base of the reference stream
+};
+
+// a range of an output. The copy starts at the last keyframe of the reference stream at or
+// before start and, with keyframe cuts, ends at the first keyframe at or after end.
+// Both are found while the packets are read.
+struct Segment {
+	int64_t start;
+	int64_t end;
+	size_t out;
+	int64_t k0 = AV_NOPTS_VALUE; // first copied keyframe
+	int64_t k1 = AV_NOPTS_VALUE; // keyframe that ends the reference stream
+	int64_t offset = 0; // added to the timestamps, time base of the reference stream
+	size_t after = SIZE_MAX; // keyframe cuts: the segment of another output that ends at start, k0 is its k1
+	bool started = false;
+	bool done = false;
+	std::vector<bool> stream_done; // by selected stream
+	std::vector<Queued> after_end; // keyframe cuts: packets of the other streams after end, until k1 is known
+
+	// smart render: the other streams are cut at start and end, the frames of the reference
+	// stream in [start, copy_from) and [copy_to, end) are re-encoded, the rest is copied.
+	// The leading pictures of an open GOP at copy_to are re-encoded too, so the tail decodes
+	// the GOP before copy_to as well.
+	int64_t copy_from = AV_NOPTS_VALUE; // the first keyframe in the range, found while copying
+	int64_t copy_to = INT64_MAX;        // the last keyframe before end, looked up before the copy
+	int64_t tail_key = INT64_MAX;       // the keyframe before copy_to, the tail decoder starts there
+	int64_t copied_last = AV_NOPTS_VALUE; // the last copied frame of the reference stream
+	std::unique_ptr<VDFFGopEncoder> head;
+	std::unique_ptr<VDFFGopEncoder> tail;
+	int64_t end_key = AV_NOPTS_VALUE; // the keyframe at or after end, its leading pictures go to the tail too
+	bool tail_cut = false; // copy_to is reached, the tail takes all packets
+	std::vector<std::pair<AVPacket*, int64_t>> held; // copied packets that wait for the head
+	bool key_fed = false;
+};
+
+// opened when its first segment starts and finished after the last one,
+// so a split into many clips does not keep all files open
+struct OutputFile {
+	AVFormatContext* ofmt = nullptr;
+	std::vector<AVStream*> streams; // by selected stream
+	bool header = false;
+	bool async_io = false;
+	int remaining = 0; // segments that are not done
+	int64_t base = AV_NOPTS_VALUE; // output time of the end of the last segment, time base of the reference stream
+	bool reencoded = false; // the next copied keyframe needs the parameter sets of the stream
+};
+
+int64_t packet_time(const AVPacket* pkt)
+{
+	return (pkt->pts != AV_NOPTS_VALUE) ? pkt->pts : pkt->dts;
+}
+
+// time of the first packet of the reference stream after the seek, INT64_MAX at the end of the stream
+int64_t find_cut(AVFormatContext* fmt, AVPacket* pkt, const int ref, const int64_t ts, const int flags)
+{
+	if (ts == INT64_MAX) {
+		return INT64_MAX;
+	}
+	if (av_seek_frame(fmt, ref, ts, flags) < 0) {
+		// the start of the stream is before the first index entry
+		return (flags & AVSEEK_FLAG_BACKWARD) ? ts : INT64_MAX;
+	}
+	while (av_read_frame(fmt, pkt) >= 0) {
+		const int stream_index = pkt->stream_index;
+		const int64_t t = packet_time(pkt);
+		av_packet_unref(pkt);
+		if (stream_index == ref && t != AV_NOPTS_VALUE) {
+			return t;
+		}
+	}
+	return INT64_MAX;
+}
+
+// the last keyframe at or before ts, from the keyframe table of the job if there is one
+int64_t find_last_key(AVFormatContext* fmt, AVPacket* pkt, const int ref, const std::vector<int64_t>& keyframes, const int64_t ts)
+{
+	if (keyframes.empty()) {
+		return find_cut(fmt, pkt, ref, ts, AVSEEK_FLAG_BACKWARD);
+	}
+	auto it = std::upper_bound(keyframes.begin(), keyframes.end(), ts);
+	return (it == keyframes.begin()) ? ts : *(it - 1);
+}
+
+// returns the error of the pending writes
+int close_output(OutputFile& o)
+{
+	if (!o.ofmt) {
+		return 0;
+	}
+	int err = 0;
+	o.header = false;
+	if (o.async_io) {
+		err = VDFFAsyncWriter::Close(&o.ofmt->pb);
+	} else if (!(o.ofmt->oformat->flags & AVFMT_NOFILE)) {
+		avio_closep(&o.ofmt->pb);
+	}
+	avformat_free_context(o.ofmt);
+	o.ofmt = nullptr;
+	return err;
+}
+
+int open_output(OutputFile& o, const std::string& path, AVFormatContext* fmt, const std::vector<int>& streams, const VDFFAsyncWriter::Options& io)
+{
+	int err = avformat_alloc_output_context2(&o.ofmt, nullptr, nullptr, path.c_str());
+	if (err < 0) {
+		return err;
+	}
+
+	for (const int i : streams) {
+		AVStream* in_stream = fmt->streams[i];
+		AVStream* out_stream = avformat_new_stream(o.ofmt, nullptr);
+		if (!out_stream) {
+			return AVERROR_UNKNOWN;
+		}
+
+		err = avcodec_parameters_copy(out_stream->codecpar, in_stream->codecpar);
+		if (err < 0) {
+			return err;
+		}
+
+		VDFFStreamCopy::AdjustCodecTag(fmt->iformat->name, o.ofmt->oformat, out_stream);
+
+		out_stream->sample_aspect_ratio = in_stream->sample_aspect_ratio;
+		out_stream->avg_frame_rate = in_stream->avg_frame_rate;
+		out_stream->time_base = in_stream->time_base;
+		out_stream->r_frame_rate = in_stream->r_frame_rate;
+		o.streams.push_back(out_stream);
+	}
+
+	if (!(o.ofmt->oformat->flags & AVFMT_NOFILE)) {
+		// local files are written behind by a thread, other protocols directly
+		const char* protocol = avio_find_protocol_name(path.c_str());
+		o.async_io = protocol && strcmp(protocol, "file") == 0;
+		if (o.async_io) {
+			err = VDFFAsyncWriter::Open(&o.ofmt->pb, path.c_str(), io);
+		} else {
+			err = avio_open(&o.ofmt->pb, path.c_str(), AVIO_FLAG_WRITE);
+		}
+		if (err < 0) {
+			return err;
+		}
+	}
+
+	err = avformat_write_header(o.ofmt, nullptr);
+	if (err < 0) {
+		return err;
+	}
+	o.header = true;
+
+	return 0;
+}
+
+// ranges of one output, sorted and merged. Only smart render looks up a cut here (the last
+// keyframe before each end), the others are found while copying.
+int make_segments(AVFormatContext* fmt, AVPacket* pkt, const int ref, const std::vector<int64_t>& keyframes, std::vector<VDFFStreamCopy::Range> ranges, const size_t out, const bool smart, std::vector<Segment>& segments)
+{
+	if (ranges.empty()) {
+		const int64_t start_time = fmt->streams[ref]->start_time;
+		ranges.push_back({ (start_time != AV_NOPTS_VALUE) ? start_time : 0, INT64_MAX });
+	}
+	std::sort(ranges.begin(), ranges.end(), [](const auto& a, const auto& b) {
+		return a.start < b.start;
+	});
+	std::vector<VDFFStreamCopy::Range> merged;
+	for (const auto& r : ranges) {
+		if (r.end <= r.start) {
+			continue;
+		}
+		if (!merged.empty() && r.start <= merged.back().end) {
+			merged.back().end = std::max(merged.back().end, r.end);
+		} else {
+			merged.push_back(r);
+		}
+	}
+	if (merged.empty()) {
+		return AVERROR(EINVAL);
+	}
+
+	for (const auto& r : merged) {
+		Segment& s = segments.emplace_back();
+		s.start = r.start;
+		s.end = r.end;
+		s.out = out;
+		if (smart && r.end != INT64_MAX) {
+			s.copy_to = find_last_key(fmt, pkt, ref, keyframes, r.end);
+			s.tail_key = find_last_key(fmt, pkt, ref, keyframes, s.copy_to - 1);
+		}
+	}
+
+	return 0;
+}
+
+// the segments are sorted by start
+bool is_first(const std::vector<Segment>& segments, const size_t i)
+{
+	return std::none_of(segments.begin(), segments.begin() + i, [&](const Segment& s) { return s.out == segments[i].out; });
+}
+
+bool is_last(const std::vector<Segment>& segments, const size_t i)
+{
+	return std::none_of(segments.begin() + i + 1, segments.end(), [&](const Segment& s) { return s.out == segments[i].out; });
+}
+
+// writes the packets of the segments to their outputs
+struct Writer {
+	AVRational ref_tb = {};
+	const AVStream* ref_stream = nullptr;
+	std::vector<uint8_t> param_sets; // smart render
+	VDFFGopSettings settings;        // smart render
+	int64_t ref_delay = 0;           // smart render, pts - dts of the keyframes of the reference stream
+	bool have_delay = false;
+	int64_t bytes = 0;
+
+	// copies a packet of a selected stream, shifted by the offset of the segment
+	int write(Segment& s, OutputFile& o, const int sel, const AVStream* in_stream, const AVPacket* pkt)
+	{
+		AVStream* out_stream = o.streams[sel];
+		AVPacket* out_pkt = av_packet_clone(pkt);
+		if (!out_pkt) {
+			return AVERROR(ENOMEM);
+		}
+		const int64_t offset = av_rescale_q(s.offset, ref_tb, in_stream->time_base);
+		if (out_pkt->pts != AV_NOPTS_VALUE) {
+			out_pkt->pts += offset;
+		}
+		if (out_pkt->dts != AV_NOPTS_VALUE) {
+			out_pkt->dts += offset;
+		}
+		av_packet_rescale_ts(out_pkt, in_stream->time_base, out_stream->time_base);
+		out_pkt->pos = -1;
+		out_pkt->stream_index = out_stream->index;
+		bytes += out_pkt->size;
+		const int err = av_interleaved_write_frame(o.ofmt, out_pkt);
+		av_packet_free(&out_pkt);
+		return err;
+	}
+
+	// smart render, a packet of the reference stream in [k0, k1)
+	int ref_packet(Segment& s, OutputFile& o, const AVPacket* pkt, const int64_t t)
+	{
+		if (s.copy_from == AV_NOPTS_VALUE) {
+			if (!(pkt->flags & AV_PKT_FLAG_KEY) || t < s.start) {
+				return s.head ? s.head->Decode(pkt) : 0;
+			}
+			// the first keyframe in the range
+			s.copy_from = t;
+			s.copy_to = std::clamp(s.copy_to, s.copy_from, s.end);
+			if (s.head) {
+				s.head->SetEnd(t);
+			}
+		}
+		if (s.head) {
+			if (t < s.copy_from) {
+				return s.head->Decode(pkt);
+			}
+			if (!s.key_fed) {
+				// the keyframe after the cut, the leading pictures that follow it refer to it
+				s.key_fed = true;
+				const int err = s.head->Decode(pkt);
+				AVPacket* p = av_packet_clone(pkt);
+				if (!p) {
+					return AVERROR(ENOMEM);
+				}
+				s.held.emplace_back(p, t);
+				return err;
+			}
+			const int err = flush_head(s, o);
+			if (err < 0) {
+				return err;
+			}
+		}
+		return process_ref(s, o, pkt, t);
+	}
+
+	// smart render, the reference stream of the segment is done
+	int finish_ref(Segment& s, OutputFile& o)
+	{
+		int err = s.head ? flush_head(s, o) : 0;
+		if (err >= 0 && s.tail) {
+			err = write_encoded(s, o, *s.tail);
+		}
+		s.tail.reset();
+		s.tail_cut = false;
+		return err;
+	}
+
+private:
+	int flush_head(Segment& s, OutputFile& o)
+	{
+		int err = write_encoded(s, o, *s.head);
+		s.head.reset();
+		for (auto& [p, t] : s.held) {
+			if (err >= 0) {
+				err = process_ref(s, o, p, t);
+			}
+			av_packet_free(&p);
+		}
+		s.held.clear();
+		return err;
+	}
+
+	int process_ref(Segment& s, OutputFile& o, const AVPacket* pkt, const int64_t t)
+	{
+		if (s.tail_cut) {
+			return s.tail->Decode(pkt);
+		}
+		if (t < s.copy_from) {
+			return 0;
+		}
+		int err = 0;
+		if (t < s.copy_to) {
+			if (!s.tail && (pkt->flags & AV_PKT_FLAG_KEY) && t >= s.tail_key && s.copy_to <= s.end) {
+				// the GOP before the out point, the leading pictures of an open GOP refer to it
+				err = open_tail(s);
+			}
+			if (err >= 0 && s.tail) {
+				err = s.tail->Decode(pkt);
+			}
+			if (err < 0) {
+				return err;
+			}
+			s.copied_last = (s.copied_last == AV_NOPTS_VALUE) ? t : std::max(s.copied_last, t);
+			return copy_ref(s, o, pkt);
+		}
+		if (!s.tail) {
+			if (s.copy_to >= s.end) {
+				return 0;
+			}
+			err = open_tail(s);
+			if (err < 0) {
+				return err;
+			}
+		}
+		// every frame after the last copied one, the leading pictures of the keyframe are before it
+		if (s.copied_last != AV_NOPTS_VALUE && s.copied_last < s.copy_to) {
+			s.tail->SetStart(s.copied_last + 1);
+		}
+		s.tail_cut = true;
+		return s.tail->Decode(pkt);
+	}
+
+	int open_tail(Segment& s)
+	{
+		s.tail = std::make_unique<VDFFGopEncoder>();
+		return s.tail->Init(ref_stream, s.copy_to, s.end, settings);
+	}
+
+	int copy_ref(Segment& s, OutputFile& o, const AVPacket* pkt)
+	{
+		if (!o.reencoded || !(pkt->flags & AV_PKT_FLAG_KEY)) {
+			return write(s, o, 0, ref_stream, pkt);
+		}
+		o.reencoded = false;
+		if (param_sets.empty()) {
+			return write(s, o, 0, ref_stream, pkt);
+		}
+
+		// the re-encoded frames have replaced the parameter sets of the stream in the decoder
+		AVPacket* p = av_packet_alloc();
+		if (!p) {
+			return AVERROR(ENOMEM);
+		}
+		int err = av_new_packet(p, int(param_sets.size()) + pkt->size);
+		if (err >= 0) {
+			err = av_packet_copy_props(p, pkt);
+		}
+		if (err >= 0) {
+			memcpy(p->data, param_sets.data(), param_sets.size());
+			memcpy(p->data + param_sets.size(), pkt->data, pkt->size);
+			err = write(s, o, 0, ref_stream, p);
+		}
+		av_packet_free(&p);
+		return err;
+	}
+
+	int write_encoded(Segment& s, OutputFile& o, VDFFGopEncoder& enc)
+	{
+		std::vector<AVPacket*> packets;
+		int err = enc.Finish(packets);
+		for (auto& p : packets) {
+			if (err >= 0) {
+				// the copied packets keep their decoding delay, the re-encoded ones get the same
+				p->dts = p->pts - ref_delay;
+				err = write(s, o, 0, ref_stream, p);
+			}
+			av_packet_free(&p);
+		}
+		if (!packets.empty()) {
+			o.reencoded = true;
+		}
+		return err;
+	}
+};
+
+// the pass over the input. A segment waits until the reading has passed its start, then it
+// starts at the last keyframe before it with the packets that were read since that keyframe.
+struct Pass {
+	AVFormatContext* fmt = nullptr;
+	const VDFFStreamCopy::Job* job = nullptr;
+	std::vector<int> streams;
+	int ref = -1;
+	bool smart = false;
+	std::vector<Segment> segments;
+	std::vector<OutputFile> outputs;
+	Writer writer;
+
+	std::vector<Queued> gop;           // packets since the last keyframe, while segments wait
+	int64_t last_key = AV_NOPTS_VALUE; // time of the last keyframe of the reference stream
+	size_t next = 0;                   // first segment that is neither started nor done
+	size_t done = 0;
+	int64_t copied = 0;
+
+	int run(AVPacket* pkt, const VDFFStreamCopy::Callbacks& cb, const int index, const int64_t total, bool& aborted)
+	{
+		const AVRational ref_tb = fmt->streams[ref]->time_base;
+		std::vector<int64_t> last_time(streams.size(), AV_NOPTS_VALUE);
+		std::vector<int> selected(fmt->nb_streams, -1);
+		for (size_t i = 0; i < streams.size(); i++) {
+			selected[streams[i]] = (int)i;
+		}
+		size_t sought = SIZE_MAX;
+		int64_t pos = INT64_MIN; // last time of the reference stream
+		int err = 0;
+
+		while (done < segments.size()) {
+			// nothing is copied at the current position, jump to the next segment
+			if (next < segments.size() && sought != next && !active()) {
+				const int64_t start = segments[next].start;
+				if (pos < start || last_key == AV_NOPTS_VALUE || last_key > start) {
+					if (av_seek_frame(fmt, ref, start, AVSEEK_FLAG_BACKWARD) >= 0) {
+						clear_gop();
+						last_key = AV_NOPTS_VALUE;
+					}
+					sought = next;
+				}
+			}
+
+			err = av_read_frame(fmt, pkt);
+			if (err < 0) {
+				err = (err == AVERROR_EOF) ? 0 : err;
+				break;
+			}
+
+			const int sel = (pkt->stream_index < (int)selected.size()) ? selected[pkt->stream_index] : -1;
+			if (sel < 0) {
+				av_packet_unref(pkt);
+				continue;
+			}
+			const AVStream* in_stream = fmt->streams[pkt->stream_index];
+
+			int64_t t = packet_time(pkt);
+			if (t == AV_NOPTS_VALUE) {
+				t = last_time[sel];
+			} else {
+				last_time[sel] = t;
+			}
+			if (t == AV_NOPTS_VALUE) {
+				av_packet_unref(pkt);
+				continue;
+			}
+			const int64_t t_ref = av_rescale_q(t, in_stream->time_base, ref_tb);
+			if (sel == 0) {
+				pos = t;
+				if (smart && !writer.have_delay && (pkt->flags & AV_PKT_FLAG_KEY) && pkt->pts != AV_NOPTS_VALUE && pkt->dts != AV_NOPTS_VALUE) {
+					writer.ref_delay = std::max<int64_t>(pkt->pts - pkt->dts, 0);
+					writer.have_delay = true;
+				}
+				err = start_waiting(pkt, t);
+				if (pkt->flags & AV_PKT_FLAG_KEY) {
+					new_gop(t);
+				}
+			}
+			if (err >= 0 && next < segments.size()) {
+				err = queue(gop, pkt, sel, t, t_ref);
+			}
+
+			for (size_t i = 0; i < segments.size() && err >= 0; i++) {
+				err = process(i, pkt, sel, t, t_ref);
+			}
+			av_packet_unref(pkt);
+			if (err < 0) {
+				break;
+			}
+
+			if (sel == 0 && cb.progress) {
+				int64_t current = copied;
+				for (const auto& s : segments) {
+					if (s.started && !s.done && pos > s.start) {
+						current += pos - s.start;
+					}
+				}
+				const double p = total > 0 ? std::min(double(current) / total, 1.0) : 0.0;
+				if (!cb.progress(index, p, writer.bytes)) {
+					aborted = true;
+					break;
+				}
+			}
+		}
+
+		if (err >= 0 && !aborted) {
+			err = finish(pos);
+		}
+		return err;
+	}
+
+	void close()
+	{
+		for (auto& o : outputs) {
+			close_output(o);
+		}
+		clear_gop();
+		for (auto& s : segments) {
+			for (auto& [p, t] : s.held) {
+				av_packet_free(&p);
+			}
+			for (auto& q : s.after_end) {
+				av_packet_free(&q.pkt);
+			}
+		}
+	}
+
+private:
+	static int queue(std::vector<Queued>& list, const AVPacket* pkt, const int sel, const int64_t t, const int64_t t_ref)
+	{
+		AVPacket* p = av_packet_clone(pkt);
+		if (!p) {
+			return AVERROR(ENOMEM);
+		}
+		list.push_back({ p, sel, t, t_ref });
+		return 0;
+	}
+
+	void clear_gop()
+	{
+		for (auto& q : gop) {
+			av_packet_free(&q.pkt);
+		}
+		gop.clear();
+	}
+
+	// a keyframe of the reference stream at t, the packets before it are not needed by a waiting segment
+	void new_gop(const int64_t t)
+	{
+		last_key = t;
+		std::erase_if(gop, [t](Queued& q) {
+			if (q.sel != 0 && q.t_ref >= t) {
+				return false;
+			}
+			av_packet_free(&q.pkt);
+			return true;
+		});
+	}
+
+	bool active() const
+	{
+		return std::any_of(segments.begin(), segments.end(), [](const Segment& s) { return s.started && !s.done; });
+	}
+
+	// keyframe cuts: a range does not start before the previous range of its output has found
+	// its end keyframe, they are joined if the next one starts before it
+	bool blocked(const size_t i) const
+	{
+		if (smart) {
+			return false;
+		}
+		for (size_t j = 0; j < i; j++) {
+			if (segments[j].out == segments[i].out && segments[j].started && segments[j].k1 == AV_NOPTS_VALUE) {
+				return true;
+			}
+		}
+		return false;
+	}
+
+	void advance()
+	{
+		while (next < segments.size() && (segments[next].started || segments[next].done)) {
+			next++;
+		}
+	}
+
+	// count is the number of packets in gop that the segment has not seen
+	int start_segment(const size_t i, const int64_t k0, const size_t count)
+	{
+		Segment& s = segments[i];
+		OutputFile& o = outputs[s.out];
+		s.started = true;
+		s.k0 = k0;
+		int err = 0;
+		if (!o.ofmt) {
+			err = open_output(o, job->outputs[s.out].path, fmt, streams, job->io);
+		}
+		// the first range starts at the requested time, the frames before it have negative timestamps.
+		// The joined ranges follow each other without gaps.
+		if (o.base == AV_NOPTS_VALUE) {
+			// a clip that continues another one has nothing before k0
+			s.offset = (s.after != SIZE_MAX) ? -s.k0 : -s.start;
+		} else {
+			s.offset = o.base - (smart ? s.start : s.k0);
+		}
+		if (err >= 0 && smart && s.k0 < s.start) {
+			s.head = std::make_unique<VDFFGopEncoder>();
+			err = s.head->Init(fmt->streams[ref], s.start, s.end, writer.settings);
+		}
+		// the packets since k0
+		for (size_t n = 0; n < count && err >= 0; n++) {
+			err = process(i, gop[n].pkt, gop[n].sel, gop[n].t, gop[n].t_ref);
+		}
+		return err;
+	}
+
+	// a packet of the reference stream at t, the segments whose start is passed are started
+	int start_waiting(const AVPacket* pkt, const int64_t t)
+	{
+		const int64_t dts = (pkt->dts != AV_NOPTS_VALUE) ? pkt->dts : t;
+		int err = 0;
+		for (size_t i = next; i < segments.size() && err >= 0; i++) {
+			const Segment& s = segments[i];
+			if (s.started || s.done || s.after != SIZE_MAX) {
+				continue;
+			}
+			// no keyframe at or before start can follow: its pts would not be less than this dts
+			if (dts <= s.start && !((pkt->flags & AV_PKT_FLAG_KEY) && t > s.start)) {
+				break;
+			}
+			if (!blocked(i)) {
+				err = start_segment(i, (last_key != AV_NOPTS_VALUE) ? last_key : s.start, gop.size());
+			}
+		}
+		advance();
+		return err;
+	}
+
+	// keyframe cuts: the next ranges of the output that start before t are copied with segment i
+	int merge_next(const size_t i, const int64_t t)
+	{
+		Segment& s = segments[i];
+		for (size_t j = i + 1; j < segments.size(); j++) {
+			Segment& n = segments[j];
+			if (n.out != s.out) {
+				continue;
+			}
+			if (n.started || n.done || n.start >= t) {
+				break;
+			}
+			s.end = std::max(s.end, n.end);
+			n.done = true;
+			done++;
+			outputs[s.out].remaining--;
+		}
+		advance();
+
+		// the waiting packets that are in the joined range
+		int err = 0;
+		std::erase_if(s.after_end, [&](Queued& q) {
+			if (q.t_ref >= s.end) {
+				return false;
+			}
+			if (err >= 0) {
+				err = writer.write(s, outputs[s.out], q.sel, fmt->streams[streams[q.sel]], q.pkt);
+			}
+			av_packet_free(&q.pkt);
+			return true;
+		});
+		return err;
+	}
+
+	int process(const size_t i, const AVPacket* pkt, const int sel, const int64_t t, const int64_t t_ref)
+	{
+		Segment& s = segments[i];
+		if (!s.started || s.done || s.stream_done[sel]) {
+			return 0;
+		}
+		OutputFile& o = outputs[s.out];
+		const AVStream* in_stream = fmt->streams[streams[sel]];
+
+		if (sel != 0) {
+			if (smart) {
+				// cut exactly
+				if (t_ref < s.start) {
+					return 0;
+				}
+				if (t_ref >= s.end) {
+					return stream_end(i, sel);
+				}
+			} else {
+				if (t_ref < s.k0) {
+					return 0;
+				}
+				if (s.k1 != AV_NOPTS_VALUE && t_ref >= s.k1) {
+					return stream_end(i, sel);
+				}
+				if (s.k1 == AV_NOPTS_VALUE && t_ref >= s.end) {
+					return queue(s.after_end, pkt, sel, t, t_ref);
+				}
+			}
+			return writer.write(s, o, sel, in_stream, pkt);
+		}
+
+		if (t < s.k0) {
+			return 0;
+		}
+		if (s.end_key != AV_NOPTS_VALUE && t >= s.end) {
+			// past the leading pictures of the keyframe after end
+			return end_ref(i, s.end_key);
+		}
+		if ((pkt->flags & AV_PKT_FLAG_KEY) && t >= s.end) {
+			if (smart && s.tail) {
+				// the leading pictures of an open GOP follow its keyframe, some can be before end
+				s.end_key = t;
+				return writer.ref_packet(s, o, pkt, t);
+			}
+			const int err = smart ? 0 : merge_next(i, t);
+			if (err < 0 || t >= s.end) {
+				return (err < 0) ? err : end_ref(i, t);
+			}
+		}
+		if (smart) {
+			return writer.ref_packet(s, o, pkt, t);
+		}
+		return writer.write(s, o, 0, in_stream, pkt);
+	}
+
+	// the keyframe of the reference stream at t ends the segment
+	int end_ref(const size_t i, const int64_t t)
+	{
+		Segment& s = segments[i];
+		OutputFile& o = outputs[s.out];
+		s.k1 = t;
+		int err = 0;
+		if (smart) {
+			err = writer.finish_ref(s, o);
+			o.base = s.end + s.offset;
+		} else {
+			o.base = s.k1 + s.offset;
+			err = write_after_end(s);
+			// the next clips start at this keyframe. It is the last packet in gop, it is
+			// passed to them after segment i.
+			for (size_t j = i + 1; j < segments.size() && err >= 0; j++) {
+				if (segments[j].after == i && !segments[j].started) {
+					err = start_segment(j, t, gop.empty() ? 0 : gop.size() - 1);
+				}
+			}
+			advance();
+		}
+		return (err < 0) ? err : stream_end(i, 0);
+	}
+
+	// keyframe cuts: the packets of the other streams that waited for k1
+	int write_after_end(Segment& s)
+	{
+		int err = 0;
+		for (auto& q : s.after_end) {
+			if (err >= 0 && !s.stream_done[q.sel]) {
+				if (q.t_ref < s.k1) {
+					err = writer.write(s, outputs[s.out], q.sel, fmt->streams[streams[q.sel]], q.pkt);
+				} else {
+					s.stream_done[q.sel] = true;
+				}
+			}
+			av_packet_free(&q.pkt);
+		}
+		s.after_end.clear();
+		return err;
+	}
+
+	int stream_end(const size_t i, const int sel)
+	{
+		Segment& s = segments[i];
+		s.stream_done[sel] = true;
+		if (!std::all_of(s.stream_done.begin(), s.stream_done.end(), [](bool v) { return v; })) {
+			return 0;
+		}
+		s.done = true;
+		copied += (s.end != INT64_MAX) ? s.end - s.start : 0;
+		done++;
+		OutputFile& o = outputs[s.out];
+		if (--o.remaining > 0) {
+			return 0;
+		}
+		int err = av_write_trailer(o.ofmt);
+		const int ret = close_output(o);
+		return (err < 0) ? err : ret;
+	}
+
+	// the end of the file, the segments end at the last packets
+	int finish(const int64_t pos)
+	{
+		int err = 0;
+		for (size_t i = 0; i < segments.size() && err >= 0; i++) {
+			Segment& s = segments[i];
+			if (!s.started && !s.done && s.after == SIZE_MAX && last_key != AV_NOPTS_VALUE && last_key <= s.start && s.start <= pos && !blocked(i)) {
+				err = start_segment(i, last_key, gop.size());
+			}
+			if (err < 0 || !s.started || s.done || !outputs[s.out].header) {
+				continue;
+			}
+			if (smart) {
+				// the re-encoded frames at the last cuts are still pending
+				err = writer.finish_ref(s, outputs[s.out]);
+			} else {
+				err = merge_next(i, INT64_MAX);
+				s.k1 = INT64_MAX;
+				if (err >= 0) {
+					err = write_after_end(s);
+				}
+			}
+		}
+		return err;
+	}
+};
+
+} // namespace
+
+void VDFFStreamCopy::AdjustCodecTag(const char* src_format, const AVOutputFormat* format, AVStream* st)
+{
+	if (src_format && strcmp(src_format, format->name) == 0) {
+		return;
+	}
+	AVCodecID codec_id = st->codecpar->codec_id;
+	unsigned int tag = st->codecpar->codec_tag;
+	st->codecpar->codec_tag = 0;
+	AVCodecID codec_id1 = av_codec_get_id(format->codec_tag, tag);
+	unsigned int codec_tag2;
+	int have_codec_tag2 = av_codec_get_tag2(format->codec_tag, codec_id, &codec_tag2);
+	if (!format->codec_tag || codec_id1 == codec_id || !have_codec_tag2) {
+		st->codecpar->codec_tag = tag;
+	}
+}
+
+std::vector<int> VDFFStreamCopy::DefaultStreams(AVFormatContext* fmt)
+{
+	std::vector<int> streams;
+	const int video = av_find_best_stream(fmt, AVMEDIA_TYPE_VIDEO, -1, -1, nullptr, 0);
+	if (video >= 0) {
+		streams.push_back(video);
+	}
+	const int audio = av_find_best_stream(fmt, AVMEDIA_TYPE_AUDIO, -1, video, nullptr, 0);
+	if (audio >= 0) {
+		streams.push_back(audio);
+	}
+	return streams;
+}
+
+int VDFFStreamCopy::Run(std::vector<Job>& jobs, const Callbacks& cb)
+{
+	int ret = 0;
+	for (size_t i = 0; i < jobs.size(); i++) {
+		const int err = RunJob(jobs[i], (int)i, cb);
+		if (err < 0) {
+			ret = err;
+		}
+		if (err == AVERROR_EXIT) {
+			break;
+		}
+	}
+	return ret;
+}
+
+int VDFFStreamCopy::RunJob(Job& job, int index, const Callbacks& cb)
+{
+	std::unique_ptr<AVFormatContext, std::function<void(AVFormatContext*)>> fmt{ job.fmt, [](AVFormatContext* p) { avformat_close_input(&p); } };
+	job.fmt = nullptr;
+
+	std::unique_ptr<AVPacket, std::function<void(AVPacket*)>> pkt{ av_packet_alloc(), [](AVPacket* p) { av_packet_free(&p); } };
+	Pass pass;
+	std::vector<int> streams = job.streams;
+	std::vector<bool> selected;
+	int ref = -1;
+	int64_t total = 0;
+	bool aborted = false;
+
+	int err = 0;
+	if (!fmt) {
+		AVFormatContext* ctx = nullptr;
+		err = avformat_open_input(&ctx, job.input.c_str(), nullptr, nullptr);
+		if (err < 0) {
+			goto end;
+		}
+		fmt.reset(ctx);
+		err = avformat_find_stream_info(ctx, nullptr);
+		if (err < 0) {
+			goto end;
+		}
+	}
+
+	if (streams.empty()) {
+		streams = DefaultStreams(fmt.get());
+	}
+	if (streams.empty() || job.outputs.empty()) {
+		err = AVERROR_STREAM_NOT_FOUND;
+		goto end;
+	}
+	selected.assign(fmt->nb_streams, false);
+	for (const int i : streams) {
+		if (i < 0 || i >= (int)fmt->nb_streams || selected[i]) {
+			err = AVERROR_STREAM_NOT_FOUND;
+			goto end;
+		}
+		selected[i] = true;
+	}
+	ref = streams[0];
+	for (unsigned i = 0; i < fmt->nb_streams; i++) {
+		fmt->streams[i]->discard = selected[i] ? AVDISCARD_DEFAULT : AVDISCARD_ALL;
+	}
+
+	pass.fmt = fmt.get();
+	pass.job = &job;
+	pass.streams = streams;
+	pass.ref = ref;
+	// without a compatible encoder the cuts stay at the keyframes
+	pass.smart = job.smart_render && VDFFGopEncoder::IsSupported(fmt->streams[ref]);
+	pass.writer.ref_tb = fmt->streams[ref]->time_base;
+	pass.writer.ref_stream = fmt->streams[ref];
+	if (pass.smart) {
+		pass.writer.param_sets = GetParameterSets(fmt->streams[ref]->codecpar);
+		pass.writer.settings = job.smart_settings;
+	}
+
+	for (size_t i = 0; i < job.outputs.size(); i++) {
+		err = make_segments(fmt.get(), pkt.get(), ref, job.keyframes, job.outputs[i].ranges, i, pass.smart, pass.segments);
+		if (err < 0) {
+			goto end;
+		}
+	}
+	std::stable_sort(pass.segments.begin(), pass.segments.end(), [](const Segment& a, const Segment& b) {
+		return a.start < b.start;
+	});
+	// keyframe cuts: a clip that starts where the clip of another output ends (a split) starts
+	// at the keyframe where that one ends, the clips do not share a GOP
+	if (!pass.smart) {
+		auto& segments = pass.segments;
+		for (size_t i = 0; i < segments.size(); i++) {
+			for (size_t j = i + 1; j < segments.size(); j++) {
+				if (segments[j].start > segments[i].end) {
+					break;
+				}
+				if (segments[j].start == segments[i].end && segments[j].out != segments[i].out && segments[j].after == SIZE_MAX
+					&& is_last(segments, i) && is_first(segments, j)) {
+					segments[j].after = i;
+					break;
+				}
+			}
+		}
+	}
+	pass.outputs.resize(job.outputs.size());
+	for (auto& s : pass.segments) {
+		pass.outputs[s.out].remaining++;
+		s.stream_done.assign(streams.size(), false);
+		if (s.end != INT64_MAX) {
+			total += s.end - s.start;
+		} else {
+			const AVStream* st = fmt->streams[ref];
+			int64_t end = (st->duration != AV_NOPTS_VALUE) ? st->duration : av_rescale_q(fmt->duration, AV_TIME_BASE_Q, st->time_base);
+			if (st->start_time != AV_NOPTS_VALUE) {
+				end += st->start_time;
+			}
+			total += std::max<int64_t>(end - s.start, 0);
+		}
+	}
+
+	err = pass.run(pkt.get(), cb, index, total, aborted);
+
+	for (auto& o : pass.outputs) {
+		if (o.header) {
+			int ret = av_write_trailer(o.ofmt);
+			if (err >= 0) {
+				err = ret;
+			}
+			ret = close_output(o);
+			if (err >= 0) {
+				err = ret;
+			}
+		}
+	}
+
+end:
+	pass.close();
+	if (err >= 0 && aborted) {
+		err = AVERROR_EXIT;
+	}
+	if (err >= 0 && cb.progress) {
+		cb.progress(index, 1.0, pass.writer.bytes);
+	}
+	if (cb.finished) {
+		cb.finished(index, err);
+	}
+
+	return err;
+}
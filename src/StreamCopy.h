@@ -0,0 +1,84 @@
+/*
+ * Copyright (C) 2026 v0lt
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "AsyncWriter.h"
+#include "SmartRender.h"
+
+extern "C"
+{
+#include <libavformat/avformat.h>
+}
+
+// Stream copy of time ranges without decoding, independent of the host (builds on Linux too).
+// A job copies the selected streams of one input into one or more outputs, all outputs of
+// a job are written in a single pass over the input.
+// Ranges are given in the time base of the reference stream (the first selected stream) and
+// are cut at its keyframes: a range starts at the keyframe before its start and ends at the
+// keyframe at or after its end. The keyframes are found while copying, the input is not read
+// ahead. The timestamps are shifted so that the first range starts at its requested start,
+// the following ranges of the same output are joined to it.
+// Overlapping ranges of one output are merged.
+// A range that starts where the range of another output ends (the clips of a split) is cut at
+// the same keyframe: the first clip ends and the second starts there, at timestamp 0, so the
+// clips share no frames.
+// With smart render the ranges are cut exactly: the frames of the reference stream between a
+// cut and the nearest keyframe are re-encoded (see SmartRender.h) and the rest is copied, the
+// other streams are cut at the packets nearest to the cuts. The leading pictures of an open GOP
+// at the out point are re-encoded with the tail, its decoder starts at the keyframe before.
+
+namespace VDFFStreamCopy
+{
+	struct Range {
+		int64_t start;
+		int64_t end; // INT64_MAX is the end of the stream
+	};
+
+	struct Output {
+		std::string path; // UTF-8, the format is guessed from the name
+		std::vector<Range> ranges; // empty is the whole stream
+	};
+
+	struct Job {
+		std::string input;              // UTF-8
+		AVFormatContext* fmt = nullptr; // opened and probed context of input, taken over by the job
+		std::vector<int> streams;       // empty is DefaultStreams
+		std::vector<Output> outputs;
+		bool smart_render = false;      // ignored if the reference stream can not be re-encoded
+		VDFFGopSettings smart_settings; // rate control of the re-encoded frames
+		// sorted times of all keyframes of the reference stream, if the caller knows them from an index.
+		// Smart render looks up the last keyframe before the end of every range here instead of
+		// seeking and reading the input.
+		std::vector<int64_t> keyframes;
+		VDFFAsyncWriter::Options io;    // buffering of the output files
+	};
+
+	struct Callbacks {
+		// pos is 0..1 over all ranges of the job, bytes is the size of the copied packets.
+		// Returning false aborts the job.
+		std::function<bool(int job, double pos, int64_t bytes)> progress;
+		// err is 0 or an AVERROR code, AVERROR_EXIT if the job was aborted
+		std::function<void(int job, int err)> finished;
+	};
+
+	// the best video stream and the best audio stream
+	std::vector<int> DefaultStreams(AVFormatContext* fmt);
+
+	// keeps the codec tag of st only if it means the same in the output format.
+	// src_format is the name of the input format, nullptr if unknown.
+	void AdjustCodecTag(const char* src_format, const AVOutputFormat* format, AVStream* st);
+
+	// runs the jobs one after another and stops if one is aborted.
+	// Returns 0 or the error of the last failed job.
+	int Run(std::vector<Job>& jobs, const Callbacks& cb);
+	int RunJob(Job& job, int index, const Callbacks& cb);
+}
@@ -0,0 +1,98 @@
+//
+// Copyright (c) 2026 v0lt
+//
+// SPDX-License-Identifier: MIT
+//
+
+#include "stdafx.h"
+#include "ThreadPool.h"
+
+ThreadPool::ThreadPool(unsigned workers)
+{
+	m_threads.reserve(workers);
+	for (unsigned i = 0; i < workers; i++) {
+		m_threads.emplace_back(&ThreadPool::worker, this);
+	}
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_exit = true;
+	}
+	m_wake.notify_all();
+	for (auto& t : m_threads) {
+		t.join();
+	}
+}
+
+int ThreadPool::run_items()
+{
+	int n = 0;
+	while (true) {
+		const int i = m_next.fetch_add(1);
+		if (i >= m_count) {
+			break;
+		}
+		(*m_func)(i);
+		n++;
+	}
+	return n;
+}
+
+void ThreadPool::worker()
+{
+	unsigned generation = 0;
+	std::unique_lock<std::mutex> lock(m_mutex);
+	while (true) {
+		m_wake.wait(lock, [&] { return m_exit || m_generation != generation; });
+		if (m_exit) {
+			break;
+		}
+		generation = m_generation;
+		m_busy++;
+		lock.unlock();
+
+		const int n = run_items();
+
+		lock.lock();
+		m_busy--;
+		m_finished += n;
+		if (m_finished == m_count && m_busy == 0) {
+			m_done.notify_one();
+		}
+	}
+}
+
+void ThreadPool::ParallelFor(const int count, const std::function<void(int)>& func)
+{
+	if (count <= 0) {
+		return;
+	}
+	if (count == 1 || m_threads.empty()) {
+		for (int i = 0; i < count; i++) {
+			func(i);
+		}
+		return;
+	}
+
+	std::lock_guard<std::mutex> job_lock(m_job_mutex);
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_func = &func;
+		m_count = count;
+		m_next = 0;
+		m_finished = 0;
+		m_generation++;
+	}
+	m_wake.notify_all();
+
+	const int n = run_items();
+
+	std::unique_lock<std::mutex> lock(m_mutex);
+	m_finished += n;
+	// workers that joined late must leave before the job state is reused
+	m_done.wait(lock, [&] { return m_finished == m_count && m_busy == 0; });
+	m_func = nullptr;
+}
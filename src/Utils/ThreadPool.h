@@ -0,0 +1,53 @@
+//
+// Copyright (c) 2026 v0lt
+//
+// SPDX-License-Identifier: MIT
+//
+
+#pragma once
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <vector>
+#include <functional>
+
+//
+// simple fork-join pool, the calling thread takes part in the work
+//
+
+class ThreadPool
+{
+public:
+	explicit ThreadPool(unsigned workers);
+	~ThreadPool();
+
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool& operator=(const ThreadPool&) = delete;
+
+	// number of threads that run a job, including the calling thread
+	unsigned GetThreadCount() const { return unsigned(m_threads.size()) + 1; }
+
+	// calls func(i) for every i in [0, count) and returns when all calls are done
+	void ParallelFor(const int count, const std::function<void(int)>& func);
+
+private:
+	std::vector<std::thread> m_threads;
+
+	std::mutex m_job_mutex; // one job at a time
+	std::mutex m_mutex;
+	std::condition_variable m_wake;
+	std::condition_variable m_done;
+
+	const std::function<void(int)>* m_func = nullptr;
+	int m_count = 0;
+	std::atomic<int> m_next = 0;
+	int m_finished = 0;
+	int m_busy = 0;
+	unsigned m_generation = 0;
+	bool m_exit = false;
+
+	void worker();
+	int run_items();
+};
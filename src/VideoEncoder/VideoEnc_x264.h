@@ -9,6 +9,9 @@
 
 #include "VideoEnc.h"
 
+extern const char* x264_preset_names[9];
+extern const char* x264_tune_names[7]; // "none" first
+
 struct CodecX264 : public CodecBase {
 	enum { id_tag = CODEC_X264 };
 
@@ -9,6 +9,9 @@
 
 #include "VideoEnc.h"
 
+extern const char* x265_preset_names[9];
+extern const char* x265_tune_names[6]; // "none" first
+
 //
 // CodecX265
 //
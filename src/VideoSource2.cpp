@@ -39,6 +39,17 @@ VDFFVideoSource::VDFFVideoSource(const VDXInputDriverContext& context)
 
 VDFFVideoSource::~VDFFVideoSource()
 {
+	// a conversion on the worker reads the pages, stop it before anything is freed
+	wait_async_convert();
+	if (m_convert_thread.joinable()) {
+		{
+			std::lock_guard lock(m_convert_mutex);
+			m_convert_exit = true;
+		}
+		m_convert_cv.notify_all();
+		m_convert_thread.join();
+	}
+
 	av_packet_free(&copy_pkt);
 
 	if (m_pFrame) {
@@ -47,10 +58,6 @@ VDFFVideoSource::~VDFFVideoSource()
 	if (m_pCodecCtx) {
 		avcodec_free_context(&m_pCodecCtx);
 	}
-	if (m_pSwsCtx) {
-		sws_freeContext(m_pSwsCtx);
-	}
-
 	for (size_t i = 0; i < buffer.size(); i++) {
 		BufferPage& p = buffer[i];
 		dealloc_page(&p);
@@ -58,7 +65,11 @@ VDFFVideoSource::~VDFFVideoSource()
 	if (mem) {
 		CloseHandle(mem);
 	}
-	av_freep(&m_pixmap_data);
+	free_converted();
+
+	if (m_pDemuxer) {
+		m_pDemuxer->Detach(m_client);
+	}
 }
 
 int VDFFVideoSource::AddRef()
@@ -176,6 +187,12 @@ int VDFFVideoSource::initStream(VDFFInputFile* pSource, const int streamIndex)
 	m_pFormatCtx = pSource->getContext();
 	m_pStream = m_pFormatCtx->streams[m_streamIndex];
 
+	m_pDemuxer = pSource->m_demuxer;
+	m_client = m_pDemuxer->Attach(m_streamIndex);
+	if (!m_client) {
+		return -1;
+	}
+
 	has_vfr = false;
 	average_fr = false;
 
@@ -258,10 +275,10 @@ int VDFFVideoSource::initStream(VDFFInputFile* pSource, const int streamIndex)
 			if (pos == AV_NOPTS_VALUE) {
 				pos = int64_t(m_sample_count) * m_frame_ts.num / m_frame_ts.den;
 			}
-			seek_frame(m_pFormatCtx, m_streamIndex, pos, AVSEEK_FLAG_BACKWARD);
-			seek_frame(m_pFormatCtx, m_streamIndex, AV_SEEK_START, AVSEEK_FLAG_BACKWARD);
-			// get the number of index entries again
-			nb_index_entries = avformat_index_get_entries_count(m_pStream);
+			m_pDemuxer->Seek(m_client, pos, AVSEEK_FLAG_BACKWARD);
+			// the seek may be done by another reader of the demuxer, the index is read from m_pStream
+			nb_index_entries = m_pDemuxer->ShareIndex(m_client);
+			m_pDemuxer->Seek(m_client, AV_SEEK_START, AVSEEK_FLAG_BACKWARD);
 		}
 		trust_index = false;
 		sparse_index = false;
@@ -429,7 +446,7 @@ int VDFFVideoSource::initStream(VDFFInputFile* pSource, const int streamIndex)
 		// works for VVC
 		std::unique_ptr<AVPacket, std::function<void(AVPacket*)>> pkt{ av_packet_alloc(), [](AVPacket* p) { av_packet_free(&p); } };
 
-		while(av_read_frame(m_pFormatCtx, pkt.get()) == 0) {
+		while(m_pDemuxer->ReadPacket(m_client, pkt.get()) == 0) {
 			if (pkt->stream_index == m_streamIndex) {
 				ret = avcodec_send_packet(m_pCodecCtx, pkt.get());
 				av_packet_unref(pkt.get());
@@ -477,6 +494,8 @@ int VDFFVideoSource::initStream(VDFFInputFile* pSource, const int streamIndex)
 		}
 	}
 
+	m_cache_budget = (max_virtual > mem_other) ? max_virtual - mem_other : 0;
+
 	uint64_t mem_size = uint64_t(frame_size) * buffer_reserve;
 	if (mem_size + mem_other > max_virtual || pSource->cfg_disable_cache) {
 		buffer_reserve = int((max_virtual - mem_other) / frame_size);
@@ -563,7 +582,7 @@ int VDFFVideoSource::initStream(VDFFInputFile* pSource, const int streamIndex)
 		if (m_pCodecCtx->has_b_frames) {
 			free_buffers();
 			avcodec_flush_buffers(m_pCodecCtx);
-			seek_frame(m_pFormatCtx, m_streamIndex, AV_SEEK_START, AVSEEK_FLAG_BACKWARD);
+			m_pDemuxer->Seek(m_client, AV_SEEK_START, AVSEEK_FLAG_BACKWARD);
 			read_frame(0, true);
 		}
 	}
@@ -742,6 +761,7 @@ void VDFFVideoSource::setCacheMode(const bool v)
 {
 	m_small_cache_mode = !v;
 	if (!v) {
+		wait_async_convert();
 		enable_prefetch = false;
 		int buffer_max = m_pSource->cfg_frame_buffers;
 		// 1 required +1 to handle dups
@@ -936,6 +956,10 @@ const void* VDFFVideoSource::DecodeFrame(const void* inputBuffer, uint32_t data_
 
 	m_pixmap_info.frame_num = targetFrame;
 
+	wait_async_convert();
+	const bool sequential = (targetFrame == m_last_decode_frame + 1);
+	m_last_decode_frame = int(targetFrame);
+
 	open_read(page);
 	uint8_t* src = page->pic_data;
 
@@ -944,31 +968,110 @@ const void* VDFFVideoSource::DecodeFrame(const void* inputBuffer, uint32_t data_
 		return src;
 
 	}
+	else if (page->converted) {
+		m_stat_requests++;
+		m_pixmap_data = src;
+		set_pixmap_layout(m_pixmap_data);
+		return m_pixmap_data;
+	}
 	else {
-		int w = m_pixmap.w;
-		int h = m_pixmap.h;
-
-		AVFrame pic = { 0 };
-		av_image_fill_arrays(pic.data, pic.linesize, src, frame_fmt, w, h, line_align);
-		if (flip_image) {
-			pic.data[0] = pic.data[0] + pic.linesize[0] * (h - 1);
-			pic.linesize[0] = -pic.linesize[0];
-		}
-
-		AVFrame pic2 = { 0 };
-		pic2.data[0] = (uint8_t*)m_pixmap.data;
-		pic2.data[1] = (uint8_t*)m_pixmap.data2;
-		pic2.data[2] = (uint8_t*)m_pixmap.data3;
-		pic2.data[3] = (uint8_t*)m_pixmap.data4;
-		pic2.linesize[0] = int(m_pixmap.pitch);
-		pic2.linesize[1] = int(m_pixmap.pitch2);
-		pic2.linesize[2] = int(m_pixmap.pitch3);
-		pic2.linesize[3] = int(m_pixmap.pitch4);
-		sws_scale(m_pSwsCtx, pic.data, pic.linesize, 0, h, pic2.data, pic2.linesize);
+		m_stat_requests++;
+		bool found = false;
+		ConvertedFrame* cf = find_converted(page, found);
+		m_pixmap_data = cf->data;
+		set_pixmap_layout(m_pixmap_data);
+		if (!found) {
+			AVFrame pic = { 0 };
+			av_image_fill_arrays(pic.data, pic.linesize, src, frame_fmt, m_pixmap.w, m_pixmap.h, line_align);
+			convert_frame(pic.data, pic.linesize, m_pixmap);
+			m_stat_conversions++;
+			cf->page_serial = page->serial;
+			cf->format_gen = m_format_gen;
+		}
+		else if (cf->ahead) {
+			// converted ahead and used, a conversion that update_page_mode has to see
+			cf->ahead = false;
+			m_stat_conversions++;
+		}
+		if (sequential) {
+			start_async_convert(int(targetFrame) + 1);
+		}
 		return m_pixmap_data;
 	}
 }
 
+// converts the frame_fmt picture to the target format, dst is a layout from fill_pixmap_layout
+void VDFFVideoSource::convert_frame(const uint8_t* const src[4], const int src_stride[4], const VDXPixmapAlpha& dst)
+{
+	uint8_t* const dst_data[4] = { (uint8_t*)dst.data, (uint8_t*)dst.data2, (uint8_t*)dst.data3, (uint8_t*)dst.data4 };
+	const int dst_stride[4] = { int(dst.pitch), int(dst.pitch2), int(dst.pitch3), int(dst.pitch4) };
+
+	m_frame_conv.Convert(src, src_stride, dst_data, dst_stride);
+}
+
+void VDFFVideoSource::start_async_convert(const int frame)
+{
+	// needs a second buffer, the host still uses the current one
+	if (frame >= m_sample_count || m_converted.size() < 2 || mem) {
+		return;
+	}
+	BufferPage* page = frame_array[frame];
+	if (!page || page->converted || page->error || !page->pic_data) {
+		return;
+	}
+
+	bool found = false;
+	ConvertedFrame* cf = find_converted(page, found);
+	if (found || cf->data == m_pixmap_data) {
+		return;
+	}
+	// keep the current frame the most recently used one
+	auto cur = std::find_if(m_converted.begin(), m_converted.end(), [&](const ConvertedFrame& c) { return c.data == m_pixmap_data; });
+	if (cur != m_converted.end()) {
+		std::swap(cf->last_use, cur->last_use);
+	}
+
+	// the entry is valid once the job is done, every user of the cache waits for it first.
+	// It is counted as a conversion only if the frame is requested.
+	cf->page_serial = page->serial;
+	cf->format_gen = m_format_gen;
+	cf->ahead = true;
+
+	if (!m_convert_thread.joinable()) {
+		m_convert_thread = std::thread(&VDFFVideoSource::convert_worker, this);
+	}
+	{
+		std::lock_guard lock(m_convert_mutex);
+		av_image_fill_arrays(m_convert_job.src, m_convert_job.src_stride, page->pic_data, frame_fmt, m_pixmap.w, m_pixmap.h, line_align);
+		m_convert_job.dst = m_pixmap;
+		fill_pixmap_layout(m_convert_job.dst, cf->data);
+		m_convert_pending = true;
+	}
+	m_convert_cv.notify_all();
+}
+
+void VDFFVideoSource::wait_async_convert()
+{
+	std::unique_lock lock(m_convert_mutex);
+	m_convert_cv.wait(lock, [this] { return !m_convert_pending; });
+}
+
+void VDFFVideoSource::convert_worker()
+{
+	std::unique_lock lock(m_convert_mutex);
+	while (true) {
+		m_convert_cv.wait(lock, [this] { return m_convert_pending || m_convert_exit; });
+		if (m_convert_exit) {
+			break;
+		}
+		lock.unlock();
+		convert_frame(m_convert_job.src, m_convert_job.src_stride, m_convert_job.dst);
+		lock.lock();
+		m_convert_pending = false;
+		m_convert_cv.notify_all();
+	}
+}
+
 uint32_t VDFFVideoSource::GetDecodePadding()
 {
 	return 0;
@@ -1057,16 +1160,7 @@ bool VDFFVideoSource::SetTargetFormat(int format, bool useDIBAlignment)
 
 bool VDFFVideoSource::SetTargetFormat(nsVDXPixmap::VDXPixmapFormat opt_format, bool useDIBAlignment, VDFFVideoSource* head)
 {
-	// this function will select one of the modes:
-	// 1) XRGB - works slow
-	// 2) convert to arbitrary rgb
-	// 3) direct decoded format - usually some sort of yuv
-	// 4) upsample arbitrary yuv to 444
-
-	// yuv->rgb has chance to apply correct source color space matrix, range etc 
-	// but! currently I notice huge color upsampling error
-
-	// which is best default? rgb afraid to use; sws can do either fast-bad or slow-good, but vd can do good-fast-enough
+	// format selection is done by MapTargetFormat (FormatMap.cpp), here the result is applied
 	using namespace nsVDXPixmap;
 
 	if (frame_width != m_pCodecCtx->width && frame_height != m_pCodecCtx->height) {
@@ -1074,7 +1168,6 @@ bool VDFFVideoSource::SetTargetFormat(nsVDXPixmap::VDXPixmapFormat opt_format, b
 		return false;
 	}
 
-	bool default_rgb = false;
 	bool fast_rgb = false;
 
 	if (m_convertInfo.ext_format && opt_format == kPixFormat_Null) {
@@ -1082,13 +1175,7 @@ bool VDFFVideoSource::SetTargetFormat(nsVDXPixmap::VDXPixmapFormat opt_format, b
 		init_format();
 	}
 
-	VDXPixmapFormat base_format    = kPixFormat_Null;
-	VDXPixmapFormat ext_format     = kPixFormat_Null;
-	VDXPixmapFormat trigger        = kPixFormat_Null;
-	VDXPixmapFormat perfect_format = kPixFormat_Null;
-	AVPixelFormat perfect_av_fmt   = frame_fmt;
-	AVPixelFormat src_fmt          = frame_fmt;
-	bool perfect_bitexact = false;
+	VDXPixmapFormat ext_format = kPixFormat_Null;
 
 	m_convertInfo.req_format = opt_format;
 	m_convertInfo.req_dib = useDIBAlignment;
@@ -1097,8 +1184,6 @@ bool VDFFVideoSource::SetTargetFormat(nsVDXPixmap::VDXPixmapFormat opt_format, b
 	m_convertInfo.out_garbage = false;
 
 	const AVPixFmtDescriptor* desc = av_pix_fmt_desc_get(frame_fmt);
-	m_convertInfo.in_yuv = !(desc->flags & AV_PIX_FMT_FLAG_RGB) && desc->nb_components >= 3;
-	m_convertInfo.in_subs = m_convertInfo.in_yuv && (desc->log2_chroma_w + desc->log2_chroma_h) > 0;
 	int src_max_value = (1 << desc->comp[0].depth) - 1;
 
 	bool colorspaceBT709 = false; // BT.601
@@ -1113,421 +1198,20 @@ bool VDFFVideoSource::SetTargetFormat(nsVDXPixmap::VDXPixmapFormat opt_format, b
 		colorspaceBT709 = true;
 	}
 
-	switch (frame_fmt) {
-	case AV_PIX_FMT_AYUV64LE:
-	case AV_PIX_FMT_AYUV64BE:
-		perfect_format = kPixFormat_YUV444_Alpha_Planar;
-		perfect_av_fmt = AV_PIX_FMT_YUVA444P;
-		trigger = kPixFormat_YUV444_Planar;
-		break;
-
-	case AV_PIX_FMT_YUVA444P:
-		perfect_format = kPixFormat_YUV444_Alpha_Planar;
-		perfect_av_fmt = AV_PIX_FMT_YUVA444P;
-		trigger = kPixFormat_YUV444_Planar;
-		perfect_bitexact = true;
-		break;
-
-	case AV_PIX_FMT_YUVA422P:
-		perfect_format = kPixFormat_YUV422_Alpha_Planar;
-		perfect_av_fmt = AV_PIX_FMT_YUVA422P;
-		trigger = kPixFormat_YUV422_Planar;
-		perfect_bitexact = true;
-		break;
-
-	case AV_PIX_FMT_YUVA420P:
-		perfect_format = kPixFormat_YUV420_Alpha_Planar;
-		perfect_av_fmt = AV_PIX_FMT_YUVA420P;
-		trigger = kPixFormat_YUV420_Planar;
-		perfect_bitexact = true;
-		break;
-
-	case AV_PIX_FMT_YUVA444P9LE:
-	case AV_PIX_FMT_YUVA444P10LE:
-	case AV_PIX_FMT_YUVA444P16LE:
-		perfect_format = kPixFormat_YUV444_Alpha_Planar16;
-		perfect_av_fmt = AV_PIX_FMT_YUVA444P16LE;
-		trigger = kPixFormat_YUV444_Planar16;
-		perfect_bitexact = true;
-		break;
-
-	case AV_PIX_FMT_YUVA422P9LE:
-	case AV_PIX_FMT_YUVA422P10LE:
-	case AV_PIX_FMT_YUVA422P16LE:
-		perfect_format = kPixFormat_YUV422_Alpha_Planar16;
-		perfect_av_fmt = AV_PIX_FMT_YUVA422P16LE;
-		trigger = kPixFormat_YUV422_Planar16;
-		perfect_bitexact = true;
-		break;
-
-	case AV_PIX_FMT_YUVA420P9LE:
-	case AV_PIX_FMT_YUVA420P10LE:
-	case AV_PIX_FMT_YUVA420P16LE:
-		perfect_format = kPixFormat_YUV420_Alpha_Planar16;
-		perfect_av_fmt = AV_PIX_FMT_YUVA420P16LE;
-		trigger = kPixFormat_YUV420_Planar16;
-		perfect_bitexact = true;
-		break;
-
-	case AV_PIX_FMT_YUV420P9LE:
-	case AV_PIX_FMT_YUV420P10LE:
-	case AV_PIX_FMT_YUV420P12LE:
-	case AV_PIX_FMT_YUV420P14LE:
-	case AV_PIX_FMT_YUV420P16LE:
-		perfect_format = kPixFormat_YUV420_Planar16;
-		trigger = kPixFormat_YUV420_Planar16;
-		perfect_bitexact = true;
-		break;
-
-	case AV_PIX_FMT_YUV422P9LE:
-	case AV_PIX_FMT_YUV422P10LE:
-	case AV_PIX_FMT_YUV422P12LE:
-	case AV_PIX_FMT_YUV422P14LE:
-	case AV_PIX_FMT_YUV422P16LE:
-		perfect_format = kPixFormat_YUV422_Planar16;
-		trigger = kPixFormat_YUV422_Planar16;
-		perfect_bitexact = true;
-		break;
-
-	case AV_PIX_FMT_YUV444P9LE:
-	case AV_PIX_FMT_YUV444P10LE:
-	case AV_PIX_FMT_YUV444P12LE:
-	case AV_PIX_FMT_YUV444P14LE:
-	case AV_PIX_FMT_YUV444P16LE:
-		perfect_format = kPixFormat_YUV444_Planar16;
-		trigger = kPixFormat_YUV444_Planar16;
-		perfect_bitexact = true;
-		break;
-
-	case AV_PIX_FMT_YUV420P:
-	case AV_PIX_FMT_YUVJ420P:
-		src_fmt = AV_PIX_FMT_YUV420P;
-		perfect_format = kPixFormat_YUV420_Planar;
-		trigger = kPixFormat_YUV420_Planar;
-		perfect_bitexact = true;
-		// examples: xvid
-		// examples: gopro avc (FR)
-		break;
-
-	case AV_PIX_FMT_YUV422P:
-	case AV_PIX_FMT_YUVJ422P:
-		src_fmt = AV_PIX_FMT_YUV422P;
-		perfect_format = kPixFormat_YUV422_Planar;
-		trigger = kPixFormat_YUV422_Planar;
-		perfect_bitexact = true;
-		// examples: jpeg (FR)
-		break;
-
-	case AV_PIX_FMT_YUV440P:
-	case AV_PIX_FMT_YUVJ440P:
-		src_fmt = AV_PIX_FMT_YUV440P;
-		perfect_format = kPixFormat_YUV444_Planar;
-		perfect_av_fmt = AV_PIX_FMT_YUV444P;
-		trigger = kPixFormat_YUV444_Planar;
-		perfect_bitexact = false;
-		// examples: 422 jpeg lossless-transposed (FR)
-		break;
-
-	case AV_PIX_FMT_UYVY422:
-		perfect_format = kPixFormat_YUV422_UYVY;
-		trigger = kPixFormat_YUV422_UYVY;
-		perfect_bitexact = true;
-		//! not tested at all
-		break;
-
-	case AV_PIX_FMT_YUYV422:
-		perfect_format = kPixFormat_YUV422_YUYV;
-		trigger = kPixFormat_YUV422_YUYV;
-		perfect_bitexact = true;
-		// examples: cineform
-		break;
-
-	case AV_PIX_FMT_YUV444P:
-	case AV_PIX_FMT_YUVJ444P:
-		src_fmt = AV_PIX_FMT_YUV444P;
-		perfect_format = kPixFormat_YUV444_Planar;
-		perfect_av_fmt = AV_PIX_FMT_YUV444P;
-		trigger = kPixFormat_YUV444_Planar;
-		perfect_bitexact = true;
-		// examples: 444 jpeg by photoshop (FR)
-		break;
-
-	case AV_PIX_FMT_YUV411P:
-		src_fmt = AV_PIX_FMT_YUV411P;
-		perfect_format = kPixFormat_YUV411_Planar;
-		perfect_av_fmt = AV_PIX_FMT_YUV411P;
-		trigger = kPixFormat_YUV411_Planar;
-		perfect_bitexact = true;
-		// examples: DV
-		break;
-
-	case AV_PIX_FMT_BGR24:
-		perfect_format = kPixFormat_RGB888;
-		trigger = kPixFormat_RGB888;
-		perfect_bitexact = true;
-		// examples: tga24
-		break;
-
-	case AV_PIX_FMT_BGRA:
-	case AV_PIX_FMT_BGR0:
-		perfect_format = kPixFormat_XRGB8888;
-		trigger = kPixFormat_XRGB8888;
-		perfect_bitexact = true;
-		// examples: tga32
-		break;
-
-	case AV_PIX_FMT_BGRA64:
-		perfect_format = (VDXPixmapFormat)kPixFormat_XRGB64;
-		perfect_av_fmt = AV_PIX_FMT_BGRA64;
-		trigger = kPixFormat_XRGB64;
-		perfect_bitexact = true;
-		break;
-
-	case AV_PIX_FMT_GRAY8:
-		perfect_format = (VDXPixmapFormat)kPixFormat_Y8;
-		perfect_av_fmt = AV_PIX_FMT_GRAY8;
-		trigger = kPixFormat_Y8;
-		perfect_bitexact = true;
-		break;
-
-	case AV_PIX_FMT_GRAY16:
-		perfect_format = (VDXPixmapFormat)kPixFormat_Y16;
-		perfect_av_fmt = AV_PIX_FMT_GRAY16;
-		trigger = kPixFormat_Y16;
-		perfect_bitexact = true;
-		break;
-
-	default:
-		perfect_format = kPixFormat_XRGB8888;
-		perfect_av_fmt = AV_PIX_FMT_BGRA;
-		trigger = kPixFormat_XRGB8888;
-		perfect_bitexact = false;
-		// examples: utvideo rgb (AV_PIX_FMT_RGB24) 
-
-		if (desc->flags & AV_PIX_FMT_FLAG_RGB && desc->comp[0].depth > 8) {
-			// examples: sgi - RGB48BE, tiff - RGB48LE/BE, RGBA64LE/BE
-			perfect_format = (VDXPixmapFormat)kPixFormat_XRGB64;
-			perfect_av_fmt = AV_PIX_FMT_BGRA64;
-			trigger = (VDXPixmapFormat)kPixFormat_XRGB64;
-			perfect_bitexact = false;
-		}
-	}
-
-	if (opt_format == 0) {
-		if (default_rgb) {
-			base_format = kPixFormat_XRGB8888;
-			m_convertInfo.av_fmt = AV_PIX_FMT_BGRA;
-			if (base_format == perfect_format) m_convertInfo.direct_copy = perfect_bitexact;
-		}
-		else {
-			base_format = perfect_format;
-			m_convertInfo.av_fmt = perfect_av_fmt;
-			m_convertInfo.direct_copy = perfect_bitexact;
-		}
-
-	}
-	else {
-		switch (opt_format) {
-		case kPixFormat_YUV420_Planar:
-		case kPixFormat_YUV422_Planar:
-		case kPixFormat_YUV411_Planar:
-		case kPixFormat_YUV422_UYVY:
-		case kPixFormat_YUV422_YUYV:
-			if (opt_format == trigger) {
-				base_format = perfect_format;
-				m_convertInfo.av_fmt = perfect_av_fmt;
-				m_convertInfo.direct_copy = perfect_bitexact;
-			}
-			else return false;
-			break;
-
-		case kPixFormat_YUV444_Planar:
-			if (opt_format == trigger) {
-				base_format = perfect_format;
-				m_convertInfo.av_fmt = perfect_av_fmt;
-				m_convertInfo.direct_copy = perfect_bitexact;
-
-			}
-			else if (m_convertInfo.in_yuv) {
-				base_format = kPixFormat_YUV444_Planar;
-				m_convertInfo.av_fmt = AV_PIX_FMT_YUV444P;
-			}
-			else return false;
-			break;
-
-		case kPixFormat_YUV444_Planar16:
-			if (opt_format == trigger) {
-				base_format = perfect_format;
-				m_convertInfo.av_fmt = perfect_av_fmt;
-				m_convertInfo.direct_copy = perfect_bitexact;
-
-			}
-			else if (m_convertInfo.in_yuv) {
-				base_format = kPixFormat_YUV444_Planar16;
-				m_convertInfo.av_fmt = AV_PIX_FMT_YUV444P16;
-			}
-			else return false;
-			break;
-
-		case kPixFormat_XRGB64:
-			if (opt_format == perfect_format) {
-				base_format = perfect_format;
-				m_convertInfo.av_fmt = perfect_av_fmt;
-				m_convertInfo.direct_copy = perfect_bitexact;
-			}
-			else {
-				base_format = kPixFormat_XRGB64;
-				m_convertInfo.av_fmt = AV_PIX_FMT_BGRA64;
-				m_convertInfo.direct_copy = false;
-			}
-			break;
-
-		case kPixFormat_XRGB1555:
-			if (opt_format == perfect_format) {
-				base_format = perfect_format;
-				m_convertInfo.av_fmt = perfect_av_fmt;
-				m_convertInfo.direct_copy = perfect_bitexact;
-			}
-			else {
-				base_format = kPixFormat_XRGB1555;
-				m_convertInfo.av_fmt = AV_PIX_FMT_RGB555;
-				m_convertInfo.direct_copy = false;
-			}
-			break;
-
-		case kPixFormat_RGB565:
-			if (opt_format == perfect_format) {
-				base_format = perfect_format;
-				m_convertInfo.av_fmt = perfect_av_fmt;
-				m_convertInfo.direct_copy = perfect_bitexact;
-			}
-			else {
-				base_format = kPixFormat_RGB565;
-				m_convertInfo.av_fmt = AV_PIX_FMT_RGB565;
-				m_convertInfo.direct_copy = false;
-			}
-			break;
-
-		case kPixFormat_RGB888:
-			if (opt_format == perfect_format) {
-				base_format = perfect_format;
-				m_convertInfo.av_fmt = perfect_av_fmt;
-				m_convertInfo.direct_copy = perfect_bitexact;
-			}
-			else {
-				base_format = kPixFormat_RGB888;
-				m_convertInfo.av_fmt = AV_PIX_FMT_BGR24;
-				m_convertInfo.direct_copy = false;
-			}
-			break;
-
-		case kPixFormat_XRGB8888:
-			if (opt_format == perfect_format) {
-				base_format = perfect_format;
-				m_convertInfo.av_fmt = perfect_av_fmt;
-				m_convertInfo.direct_copy = perfect_bitexact;
-			}
-			else {
-				base_format = kPixFormat_XRGB8888;
-				m_convertInfo.av_fmt = AV_PIX_FMT_BGRA;
-				m_convertInfo.direct_copy = false;
-			}
-			break;
-
-		default:
-			return false;
-		}
+	FormatMapping mapping;
+	if (!MapTargetFormat(frame_fmt, opt_format, m_pCodecCtx->color_range == AVCOL_RANGE_JPEG, colorspaceBT709, mapping)) {
+		return false;
 	}
+	m_convertInfo.av_fmt = mapping.av_fmt;
+	m_convertInfo.direct_copy = mapping.direct_copy;
+	m_convertInfo.in_yuv = mapping.in_yuv;
+	m_convertInfo.in_subs = mapping.in_subs;
+	m_convertInfo.out_rgb = mapping.out_rgb;
 
 	if (m_convertInfo.direct_copy) m_convertInfo.req_dib = false;
 
 	const AVPixFmtDescriptor* out_desc = av_pix_fmt_desc_get(m_convertInfo.av_fmt);
-	m_convertInfo.out_rgb = (out_desc->flags & AV_PIX_FMT_FLAG_RGB) && out_desc->nb_components >= 3;
-
-	// tweak output yuv formats for VD here
-	VDXPixmapFormat format = base_format;
-
-	/*if (format==kPixFormat_YUV420_Planar && m_convertInfo.av_fmt==AV_PIX_FMT_YUV420P && opt_format!=kPixFormat_YUV420_Planar) {
-		AVFieldOrder fo = m_pCodecCtx->field_order;
-		if(fo==AV_FIELD_TT) format = kPixFormat_YUV420it_Planar;
-		if(fo==AV_FIELD_BB) format = kPixFormat_YUV420ib_Planar;
-	}*/
-
-	if (m_pCodecCtx->color_range == AVCOL_RANGE_JPEG) {
-		switch (format) {
-		case kPixFormat_YUV420_Planar:
-			format = kPixFormat_YUV420_Planar_FR;
-			break;
-		case kPixFormat_YUV420it_Planar:
-			format = kPixFormat_YUV420it_Planar_FR;
-			break;
-		case kPixFormat_YUV420ib_Planar:
-			format = kPixFormat_YUV420ib_Planar_FR;
-			break;
-		case kPixFormat_YUV422_Planar:
-			format = kPixFormat_YUV422_Planar_FR;
-			break;
-		case kPixFormat_YUV444_Planar:
-			format = kPixFormat_YUV444_Planar_FR;
-			break;
-		case kPixFormat_YUV422_UYVY:
-			format = kPixFormat_YUV422_UYVY_FR;
-			break;
-		case kPixFormat_YUV422_YUYV:
-			format = kPixFormat_YUV422_YUYV_FR;
-			break;
-		case kPixFormat_Y8:
-			format = kPixFormat_Y8_FR;
-			break;
-		}
-	}
-
-	if (colorspaceBT709) {
-		switch (format) {
-		case kPixFormat_YUV420_Planar:
-			format = kPixFormat_YUV420_Planar_709;
-			break;
-		case kPixFormat_YUV420_Planar_FR:
-			format = kPixFormat_YUV420_Planar_709_FR;
-			break;
-		case kPixFormat_YUV420it_Planar:
-			format = kPixFormat_YUV420it_Planar_709;
-			break;
-		case kPixFormat_YUV420it_Planar_FR:
-			format = kPixFormat_YUV420it_Planar_709_FR;
-			break;
-		case kPixFormat_YUV420ib_Planar:
-			format = kPixFormat_YUV420ib_Planar_709;
-			break;
-		case kPixFormat_YUV420ib_Planar_FR:
-			format = kPixFormat_YUV420ib_Planar_709_FR;
-			break;
-		case kPixFormat_YUV422_Planar:
-			format = kPixFormat_YUV422_Planar_709;
-			break;
-		case kPixFormat_YUV422_Planar_FR:
-			format = kPixFormat_YUV422_Planar_709_FR;
-			break;
-		case kPixFormat_YUV444_Planar:
-			format = kPixFormat_YUV444_Planar_709;
-			break;
-		case kPixFormat_YUV444_Planar_FR:
-			format = kPixFormat_YUV444_Planar_709_FR;
-			break;
-		case kPixFormat_YUV422_UYVY:
-			format = kPixFormat_YUV422_UYVY_709;
-			break;
-		case kPixFormat_YUV422_UYVY_FR:
-			format = kPixFormat_YUV422_UYVY_709_FR;
-			break;
-		case kPixFormat_YUV422_YUYV:
-			format = kPixFormat_YUV422_YUYV_709;
-			break;
-		case kPixFormat_YUV422_YUYV_FR:
-			format = kPixFormat_YUV422_YUYV_709_FR;
-			break;
-		}
-	}
+	VDXPixmapFormat format = mapping.format;
 
 	if (head && head->m_pixmap.format != format) {
 		format = (VDXPixmapFormat)head->m_pixmap.format;
@@ -1608,167 +1292,155 @@ bool VDFFVideoSource::SetTargetFormat(nsVDXPixmap::VDXPixmapFormat opt_format, b
 		}
 	}
 
+	wait_async_convert();
+	m_frame_conv.Reset();
+	m_format_gen++;
+	m_convert_pages = false;
+	for (const BufferPage& page : buffer) {
+		if (page.converted) {
+			// converted pages are useless for the new format, decode again
+			free_buffers();
+			break;
+		}
+	}
 	if (m_convertInfo.direct_copy || m_convertInfo.out_garbage) {
-		av_freep(&m_pixmap_data);
+		free_converted();
 	}
 	else {
-		uint32_t size = av_image_get_buffer_size(m_convertInfo.av_fmt, w, h, line_align);
-		m_pixmap_data = (uint8_t*)av_realloc(m_pixmap_data, size);
+		init_converted(av_image_get_buffer_size(m_convertInfo.av_fmt, w, h, line_align));
 		set_pixmap_layout(m_pixmap_data);
-		if (m_pSwsCtx) sws_freeContext(m_pSwsCtx);
-		int flags = 0;
-		if (m_convertInfo.in_subs) {
-			// bicubic is needed to best preserve detail, ex color_420.jpg
-			// bilinear also not bad if the material is blurry
-			flags |= SWS_BICUBIC;
-		}
-		else {
-			// this is needed to fight smearing when no upsampling is actually used, ex color_444.jpg
-			flags |= SWS_POINT;
-		}
-
-		// these flags are needed to avoid really bad optimized conversion resulting in corrupt image, ex color_420.jpg
-		// however this is also 5x slower!
-		flags |= SWS_FULL_CHR_H_INT | SWS_ACCURATE_RND;
-		if (fast_rgb) flags = SWS_POINT;
-#ifdef _DEBUG
-		flags |= SWS_PRINT_INFO;
-#endif
-
-		int proxy_max_value = 0;
-		AVPixelFormat proxy_fmt = AV_PIX_FMT_NONE;
-		if (format == kPixFormat_XRGB64) {
-			switch (src_fmt) {
-			case AV_PIX_FMT_GBRP9LE:
-				proxy_max_value = 0x01FF;
-				proxy_fmt = AV_PIX_FMT_GBRP16LE;
-				break;
-			case AV_PIX_FMT_GBRP10LE:
-				proxy_max_value = 0x03FF;
-				proxy_fmt = AV_PIX_FMT_GBRP16LE;
-				break;
-			case AV_PIX_FMT_GBRP12LE:
-				proxy_max_value = 0x0FFF;
-				proxy_fmt = AV_PIX_FMT_GBRP16LE;
-				break;
-			case AV_PIX_FMT_GBRP14LE:
-				proxy_max_value = 0x3FFF;
-				proxy_fmt = AV_PIX_FMT_GBRP16LE;
-				break;
-			case AV_PIX_FMT_GBRP16LE:
-				proxy_max_value = 0xFFFF;
-				proxy_fmt = AV_PIX_FMT_GBRP16LE;
-				break;
 
-			case AV_PIX_FMT_GBRP9BE:
-				proxy_max_value = 0x01FF;
-				proxy_fmt = AV_PIX_FMT_GBRP16BE;
-				break;
-			case AV_PIX_FMT_GBRP10BE:
-				proxy_max_value = 0x03FF;
-				proxy_fmt = AV_PIX_FMT_GBRP16BE;
-				break;
-			case AV_PIX_FMT_GBRP12BE:
-				proxy_max_value = 0x0FFF;
-				proxy_fmt = AV_PIX_FMT_GBRP16BE;
-				break;
-			case AV_PIX_FMT_GBRP14BE:
-				proxy_max_value = 0x3FFF;
-				proxy_fmt = AV_PIX_FMT_GBRP16BE;
-				break;
-			case AV_PIX_FMT_GBRP16BE:
-				proxy_max_value = 0xFFFF;
-				proxy_fmt = AV_PIX_FMT_GBRP16BE;
-				break;
+		mapping.format = format;
+		mapping.av_fmt = m_convertInfo.av_fmt;
+		m_frame_conv.Init(mapping, w, h, m_pCodecCtx->colorspace, m_pCodecCtx->color_range == AVCOL_RANGE_JPEG,
+			m_pCodecCtx->chroma_sample_location, flip_image, fast_rgb);
 
-			case AV_PIX_FMT_GBRAP10LE:
-				proxy_max_value = 0x03FF;
-				proxy_fmt = AV_PIX_FMT_GBRAP16LE;
-				break;
-			case AV_PIX_FMT_GBRAP12LE:
-				proxy_max_value = 0x0FFF;
-				proxy_fmt = AV_PIX_FMT_GBRAP16LE;
-				break;
-			case AV_PIX_FMT_GBRAP16LE:
-				proxy_max_value = 0xFFFF;
-				proxy_fmt = AV_PIX_FMT_GBRAP16LE;
-				break;
-
-			case AV_PIX_FMT_GBRAP10BE:
-				proxy_max_value = 0x03FF;
-				proxy_fmt = AV_PIX_FMT_GBRAP16BE;
-				break;
-			case AV_PIX_FMT_GBRAP12BE:
-				proxy_max_value = 0x0FFF;
-				proxy_fmt = AV_PIX_FMT_GBRAP16BE;
-				break;
-			case AV_PIX_FMT_GBRAP16BE:
-				proxy_max_value = 0xFFFF;
-				proxy_fmt = AV_PIX_FMT_GBRAP16BE;
-				break;
-			}
-		}
-		if (proxy_fmt != AV_PIX_FMT_NONE) {
+		const int proxy_max_value = m_frame_conv.GetProxyMaxValue();
+		if (proxy_max_value) {
 			m_pixmap_info.ref_r = proxy_max_value;
 			m_pixmap_info.ref_g = proxy_max_value;
 			m_pixmap_info.ref_b = proxy_max_value;
 			m_pixmap_info.ref_a = proxy_max_value;
-			src_fmt = proxy_fmt;
 		}
+	}
+
+	return true;
+}
 
-		m_pSwsCtx = sws_getContext(w, h, src_fmt, w, h, m_convertInfo.av_fmt, flags, nullptr, nullptr, nullptr);
-		if (m_convertInfo.in_yuv && m_convertInfo.out_rgb) {
-			// range and color space only makes sence for yuv->rgb
-			// rgb->rgb is always exact
-			// rgb->yuv is useless as input
-			// yuv->yuv better keep unchanged to save precision
-			// rgb output is always full range
-			const int* src_matrix = sws_getCoefficients(m_pCodecCtx->colorspace);
-			int src_range = m_pCodecCtx->color_range == AVCOL_RANGE_JPEG ? 1 : 0;
+void VDFFVideoSource::init_converted(const uint32_t size)
+{
+	// a few frames are enough for preview refreshes and repeated frames, but keep 8K RGB64 reasonable
+	const uint32_t max_memory = 256 * 1024 * 1024;
+	const int count = std::clamp(int(max_memory / std::max(size, 1u)), 1, 4);
 
-			int* t1; int* t2; int r1, r2; int p0, p1, p2;
-			sws_getColorspaceDetails(m_pSwsCtx, &t1, &r1, &t2, &r2, &p0, &p1, &p2);
-			sws_setColorspaceDetails(m_pSwsCtx, src_matrix, src_range, t2, r2, p0, p1, p2);
-		}
+	if (size != m_converted_size) {
+		free_converted();
+		m_converted_size = size;
+	}
+	m_converted.resize(count);
+	for (ConvertedFrame& cf : m_converted) {
+		cf.page_serial = 0;
+		cf.last_use = 0;
+		cf.ahead = false;
 	}
+	if (!m_converted[0].data) {
+		m_converted[0].data = (uint8_t*)av_malloc(size);
+	}
+	m_pixmap_data = m_converted[0].data;
+}
 
-	return true;
+void VDFFVideoSource::free_converted()
+{
+	for (ConvertedFrame& cf : m_converted) {
+		av_freep(&cf.data);
+	}
+	m_converted.clear();
+	m_converted_size = 0;
+	m_pixmap_data = nullptr;
 }
 
-void VDFFVideoSource::set_pixmap_layout(const uint8_t* p)
+VDFFVideoSource::ConvertedFrame* VDFFVideoSource::find_converted(const BufferPage* page, bool& found)
 {
-	int w = m_pixmap.w;
-	int h = m_pixmap.h;
-
-	AVFrame pic = { 0 };
-	av_image_fill_arrays(pic.data, pic.linesize, p, m_convertInfo.av_fmt, w, h, line_align);
-
-	if (m_pixmap.format == nsVDXPixmap::kPixFormat_YUV422_V210) {
-		int row = (w + 47) / 48 * 128;
-		pic.linesize[0] = row;
-	}
-
-	m_pixmap.palette = nullptr;
-	m_pixmap.data   = pic.data[0];
-	m_pixmap.data2  = pic.data[1];
-	m_pixmap.data3  = pic.data[2];
-	m_pixmap.data4  = pic.data[3];
-	m_pixmap.pitch  = pic.linesize[0];
-	m_pixmap.pitch2 = pic.linesize[1];
-	m_pixmap.pitch3 = pic.linesize[2];
-	m_pixmap.pitch4 = pic.linesize[3];
-
-	if (m_convertInfo.req_dib ^ flip_image) {
-		switch (m_pixmap.format) {
-		case nsVDXPixmap::kPixFormat_XRGB1555:
-		case nsVDXPixmap::kPixFormat_RGB565:
-		case nsVDXPixmap::kPixFormat_RGB888:
-		case nsVDXPixmap::kPixFormat_XRGB8888:
-			m_pixmap.data = pic.data[0] + pic.linesize[0] * (h - 1);
-			m_pixmap.pitch = -pic.linesize[0];
+	ConvertedFrame* r = nullptr;
+	for (ConvertedFrame& cf : m_converted) {
+		if (cf.data && page->serial && cf.page_serial == page->serial && cf.format_gen == m_format_gen) {
+			r = &cf;
+			found = true;
 			break;
 		}
+		// prefer unallocated entries, then the least recently used one
+		if (!r || (r->data && (!cf.data || cf.last_use < r->last_use))) {
+			r = &cf;
+		}
+	}
+
+	if (!r->data) {
+		r->data = (uint8_t*)av_malloc(m_converted_size);
+		if (!r->data) {
+			// reuse the current buffer rather than fail
+			r = &m_converted[0];
+		}
 	}
+	if (!found) {
+		r->page_serial = 0;
+		r->ahead = false;
+	}
+	r->last_use = ++m_convert_tick;
+	return r;
+}
+
+bool VDFFVideoSource::can_convert_pages()
+{
+	if (m_convertInfo.direct_copy || m_convertInfo.out_garbage || !m_converted_size) {
+		return false;
+	}
+	// file mapping has fixed page size
+	if (mem) {
+		return false;
+	}
+	return uint64_t(std::max(m_converted_size, uint32_t(frame_size))) * buffer.size() <= m_cache_budget;
+}
+
+void VDFFVideoSource::update_page_mode()
+{
+	const int window = 64;
+	if (m_stat_decoded < window) {
+		return;
+	}
+
+	if (!can_convert_pages()) {
+		m_convert_pages = false;
+	}
+	else if (m_convert_pages) {
+		// frames that are decoded but never shown are converted for nothing
+		if (m_stat_requests * 4 < m_stat_decoded * 3) {
+			m_convert_pages = false;
+		}
+	}
+	else {
+		// conversions in DecodeFrame per decoded frame, repeated when converted frames are evicted;
+		// bigger pages hold fewer frames in the same memory, so ask for more reuse
+		const double reuse = double(m_stat_conversions) / m_stat_decoded;
+		const double size_ratio = double(m_converted_size) / frame_size;
+		if (reuse > std::max(1.25, 1 + size_ratio / 4)) {
+			m_convert_pages = true;
+		}
+	}
+	DLog(L"VDFFVideoSource::update_page_mode: converted pages = {} (decoded {}, requests {}, conversions {})", m_convert_pages, m_stat_decoded, m_stat_requests, m_stat_conversions);
+
+	m_stat_decoded = 0;
+	m_stat_requests = 0;
+	m_stat_conversions = 0;
+}
+
+void VDFFVideoSource::set_pixmap_layout(const uint8_t* p)
+{
+	fill_pixmap_layout(m_pixmap, p);
+}
+
+void VDFFVideoSource::fill_pixmap_layout(VDXPixmapAlpha& pixmap, const uint8_t* p)
+{
+	FillPixmapLayout(pixmap, p, m_convertInfo.av_fmt, line_align, m_convertInfo.req_dib ^ flip_image);
 }
 
 bool VDFFVideoSource::SetDecompressedFormat(const VDXBITMAPINFOHEADER* pbih)
@@ -2037,6 +1709,12 @@ bool VDFFVideoSource::Read(sint64 start, uint32 lCount, void* lpBuffer, uint32 c
 		return false;
 	}
 
+	if (m_pDemuxer->TakeResync(m_client)) {
+		// packets were lost while the shared reader served other streams
+		next_frame = -1;
+		last_seek_frame = -1;
+	}
+
 	int64_t seek_pos;
 	int seek_frame = calc_seek(jump, seek_pos);
 	if (seek_frame != -1) {
@@ -2047,7 +1725,7 @@ bool VDFFVideoSource::Read(sint64 start, uint32 lCount, void* lpBuffer, uint32 c
 		avcodec_flush_buffers(m_pCodecCtx);
 		// don't use AVSEEK_FLAG_BACKWARD for MP4
 		// Comment from LAV Filters source code: "MP4 index timestamps are DTS, seeking expects PTS however..."
-		::seek_frame(m_pFormatCtx, m_streamIndex, seek_pos, m_pSource->is_mp4 ? 0 : AVSEEK_FLAG_BACKWARD);
+		m_pDemuxer->Seek(m_client, seek_pos, m_pSource->is_mp4 ? 0 : AVSEEK_FLAG_BACKWARD);
 		if (trust_index || is_image_list) {
 			next_frame = seek_frame;
 		} else {
@@ -2115,7 +1793,7 @@ bool VDFFVideoSource::read_frame(const int64_t desired_frame, bool init)
 
 	if (m_copy_mode && !m_decode_mode) {
 		while (1) {
-			ret = av_read_frame(m_pFormatCtx, pkt.get());
+			ret = m_pDemuxer->ReadPacket(m_client, pkt.get());
 			if (ret < 0) {
 				return false;
 			}
@@ -2143,7 +1821,7 @@ bool VDFFVideoSource::read_frame(const int64_t desired_frame, bool init)
 	int done_frames = 0;
 
 	while (1) {
-		int ret = av_read_frame(m_pFormatCtx, pkt.get());
+		int ret = m_pDemuxer->ReadPacket(m_client, pkt.get());
 		if (ret < 0) {
 			// end of stream, grab buffered images
 			ret = avcodec_send_packet(m_pCodecCtx, nullptr);
@@ -2243,6 +1921,7 @@ int VDFFVideoSource::handle_frame_num(const int64_t pts, const int64_t dts)
 
 int VDFFVideoSource::handle_frame()
 {
+	wait_async_convert(); // pages are going to change
 	decoded_count++;
 	int pos = handle_frame_num(m_pFrame->pts, m_pFrame->pkt_dts);
 	// ignore error (-1) and anything outside promised range
@@ -2267,6 +1946,16 @@ int VDFFVideoSource::handle_frame()
 		BufferPage* page = frame_array[pos];
 		open_write(page);
 		page->error = 0;
+		page->serial = ++m_page_serial;
+		page->converted = false;
+
+		m_stat_decoded++;
+		update_page_mode();
+		if (m_convert_pages && page->pic_data && page->size < m_converted_size) {
+			av_freep(&page->pic_data);
+			page->pic_data = (uint8_t*)av_malloc(m_converted_size);
+			page->size = page->pic_data ? m_converted_size : 0;
+		}
 
 		if (!page->pic_data) {
 			page->error = BufferPage::err_memory;
@@ -2274,6 +1963,13 @@ int VDFFVideoSource::handle_frame()
 		else if (!check_frame_format()) {
 			page->error = BufferPage::err_badformat;
 		}
+		else if (m_convert_pages) {
+			VDXPixmapAlpha pixmap = m_pixmap;
+			fill_pixmap_layout(pixmap, page->pic_data);
+			convert_frame(m_pFrame->data, m_pFrame->linesize, pixmap);
+			page->converted = true;
+			m_stat_conversions++;
+		}
 		else {
 			uint8_t* dst = page->pic_data;
 			if (m_convertInfo.ext_format == nsVDXPixmap::kPixFormat_YUV422_V210) {
@@ -2301,6 +1997,7 @@ bool VDFFVideoSource::check_frame_format()
 
 void VDFFVideoSource::free_buffers()
 {
+	wait_async_convert();
 	for (size_t i = 0; i < buffer.size(); i++) {
 		BufferPage& page = buffer[i];
 		frame_array[page.target] = nullptr;
@@ -2312,6 +2009,7 @@ void VDFFVideoSource::free_buffers()
 		page.refs = 0;
 		page.access = 0;
 		page.target = 0;
+		page.converted = false;
 	}
 
 	std::fill(frame_array.begin(), frame_array.end(), nullptr);
@@ -2380,6 +2078,7 @@ void VDFFVideoSource::alloc_page(const int pos)
 				r->num = (int)i;
 				if (!mem && !r->pic_data) {
 					r->pic_data = (uint8_t*)av_malloc(frame_size);
+					r->size = r->pic_data ? frame_size : 0;
 					if (!r->pic_data) {
 						mContext.mpCallbacks->SetErrorOutOfMemory();
 					}
@@ -2426,7 +2125,9 @@ void VDFFVideoSource::dealloc_page(BufferPage* p)
 
 	p->map_base = nullptr;
 	p->pic_data = nullptr;
+	p->size = 0;
 	p->error = 0;
+	p->converted = false;
 	p->access = 0;
 }
 
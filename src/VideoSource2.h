@@ -10,6 +10,9 @@
 #include <vd2/plugin/vdinputdriver.h>
 #include <vd2/VDXFrame/Unknown.h>
 #include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
 
 extern "C"
 {
@@ -18,6 +21,8 @@ extern "C"
 #include <libavformat/avformat.h>
 #include <libswscale/swscale.h>
 }
+#include "Demuxer.h"
+#include "FrameConverter.h"
 
 class VDFFInputFile;
 
@@ -94,6 +99,8 @@ private:
 	VDFFInputFile* m_pSource = nullptr;
 
 	AVFormatContext* m_pFormatCtx = nullptr;
+	std::shared_ptr<VDFFDemuxer> m_pDemuxer;
+	VDFFDemuxer::Client* m_client = nullptr;
 public:
 	AVStream*       m_pStream   = nullptr;
 	AVCodecContext* m_pCodecCtx = nullptr;
@@ -107,12 +114,49 @@ private:
 	std::vector<uint8_t> m_direct_format;
 
 	AVFrame*    m_pFrame  = nullptr;
-	SwsContext* m_pSwsCtx = nullptr;
+	VDFFFrameConverter m_frame_conv;
 	VDXPixmapAlpha m_pixmap = {};
 	FilterModPixmapInfo m_pixmap_info = {};
-	uint8_t* m_pixmap_data = nullptr; // aligned for FFmpeg
+	uint8_t* m_pixmap_data = nullptr; // aligned for FFmpeg, one of m_converted or a converted page
 	int m_pixmap_frame = 0;
 
+	// recently converted frames, reused while the source page and the target format are unchanged
+	struct ConvertedFrame {
+		uint8_t* data = nullptr;
+		uint32_t page_serial = 0;
+		uint32_t format_gen  = 0;
+		uint64_t last_use    = 0;
+		bool ahead           = false; // converted by start_async_convert, counted when it is used
+	};
+	std::vector<ConvertedFrame> m_converted;
+	uint32_t m_converted_size = 0;
+	uint32_t m_format_gen     = 0;
+	uint32_t m_page_serial    = 0;
+	uint64_t m_convert_tick   = 0;
+
+	// converted page mode: frames are converted once in handle_frame and stored in the target format,
+	// chosen automatically from the measured reuse of decoded frames
+	bool m_convert_pages      = false;
+	uint64_t m_cache_budget   = 0;
+	int m_stat_decoded        = 0;
+	int m_stat_requests       = 0;
+	int m_stat_conversions    = 0;
+
+	// conversion of the next frame during sequential playback, runs on a worker thread while the host
+	// works on the current one
+	struct ConvertJob {
+		uint8_t* src[4];
+		int src_stride[4];
+		VDXPixmapAlpha dst;
+	};
+	std::thread m_convert_thread;
+	std::mutex m_convert_mutex;
+	std::condition_variable m_convert_cv;
+	ConvertJob m_convert_job = {};
+	bool m_convert_pending = false; // guarded by m_convert_mutex
+	bool m_convert_exit    = false; // guarded by m_convert_mutex
+	int m_last_decode_frame   = -1;
+
 public:
 	struct ConvertInfo {
 		nsVDXPixmap::VDXPixmapFormat req_format = nsVDXPixmap::kPixFormat_Null;
@@ -137,6 +181,9 @@ public:
 		int target = 0;
 		int refs   = 0;
 		int error  = 0;
+		uint32_t serial = 0; // changes with every write of pic_data
+		uint32_t size   = 0; // allocated size of pic_data (without file mapping)
+		bool converted  = false; // pic_data holds the target format instead of frame_fmt
 		volatile LONG access = 0;
 		void* map_base    = nullptr;
 		uint8_t* pic_data = nullptr; // aligned for FFmpeg
@@ -199,6 +246,16 @@ private:
 	int  init_duration(const AVRational fr);
 	void init_format();
 	void set_pixmap_layout(const uint8_t* p);
+	void fill_pixmap_layout(VDXPixmapAlpha& pixmap, const uint8_t* p);
+	void init_converted(const uint32_t size);
+	void free_converted();
+	ConvertedFrame* find_converted(const BufferPage* page, bool& found);
+	void convert_frame(const uint8_t* const src[4], const int src_stride[4], const VDXPixmapAlpha& dst);
+	void start_async_convert(const int frame);
+	void wait_async_convert();
+	void convert_worker();
+	bool can_convert_pages();
+	void update_page_mode();
 	int  handle_frame_num(const int64_t pts, const int64_t dts);
 	int  handle_frame();
 	bool check_frame_format();
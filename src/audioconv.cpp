@@ -0,0 +1,370 @@
+/*
+ * Copyright (C) 2026 v0lt
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include "stdafx.h"
+
+#include "audioconv.h"
+#include "pixconv.h"
+#include <emmintrin.h>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <type_traits>
+
+namespace {
+
+//
+// scalar conversions, the same as in libswresample (audioconvert.c)
+//
+
+inline int32_t to_s32(const uint8_t v) { return (int32_t(v) - 0x80) * (1 << 24); }
+inline int32_t to_s32(const int16_t v) { return int32_t(v) * (1 << 16); }
+inline int32_t to_s32(const int32_t v) { return v; }
+
+template <typename O> O from_s32(const int32_t v);
+template <> inline uint8_t from_s32(const int32_t v) { return uint8_t((v >> 24) + 0x80); }
+template <> inline int16_t from_s32(const int32_t v) { return int16_t(v >> 16); }
+template <> inline int32_t from_s32(const int32_t v) { return v; }
+template <> inline float from_s32(const int32_t v) { return v * (1.0f / 2147483648.0f); }
+
+template <typename O> O from_real(const double v);
+template <> inline uint8_t from_real(const double v) { return (uint8_t)std::clamp(lrint(v * 128) + 0x80, 0l, 255l); }
+template <> inline int16_t from_real(const double v) { return (int16_t)std::clamp(lrint(v * 32768), -32768l, 32767l); }
+template <> inline int32_t from_real(const double v) { return (int32_t)std::clamp(llrint(v * 2147483648.0), (long long)INT32_MIN, (long long)INT32_MAX); }
+template <> inline float from_real(const double v) { return (float)v; }
+
+template <typename O, typename I>
+inline O conv(const I v)
+{
+	if constexpr (std::is_floating_point_v<I>) {
+		return from_real<O>(v);
+	} else {
+		return from_s32<O>(to_s32(v));
+	}
+}
+
+template <typename I, typename O, bool in_planar, bool out_planar>
+void repack(uint8_t* const* dst, const uint8_t* const* src, int count, int channels)
+{
+	const int si = in_planar ? 1 : channels;
+	const int di = out_planar ? 1 : channels;
+	for (int ch = 0; ch < channels; ch++) {
+		const I* s = in_planar ? (const I*)src[ch] : (const I*)src[0] + ch;
+		O* d = out_planar ? (O*)dst[ch] : (O*)dst[0] + ch;
+		for (int i = 0; i < count; i++) {
+			d[i * di] = conv<O>(s[i * si]);
+		}
+	}
+}
+
+// packed to packed does not depend on the channels
+template <typename I, typename O>
+void repack_packed(uint8_t* const* dst, const uint8_t* const* src, int count, int channels)
+{
+	repack<I, O, true, true>(dst, src, count * channels, 1);
+}
+
+template <typename T, bool planar>
+void copy(uint8_t* const* dst, const uint8_t* const* src, int count, int channels)
+{
+	if (planar) {
+		for (int ch = 0; ch < channels; ch++) {
+			memcpy(dst[ch], src[ch], count * sizeof(T));
+		}
+	} else {
+		memcpy(dst[0], src[0], (size_t)count * channels * sizeof(T));
+	}
+}
+
+template <typename I, typename O>
+SampleConverter::ConvertFunc select_generic(const bool in_planar, const bool out_planar)
+{
+	if constexpr (std::is_same_v<I, O>) {
+		if (in_planar == out_planar) {
+			return in_planar ? copy<I, true> : copy<I, false>;
+		}
+	}
+	if (in_planar) {
+		return out_planar ? repack<I, O, true, true> : repack<I, O, true, false>;
+	}
+	return out_planar ? repack<I, O, false, true> : repack_packed<I, O>;
+}
+
+template <typename I>
+SampleConverter::ConvertFunc select_generic(const AVSampleFormat out_fmt, const bool in_planar, const bool out_planar)
+{
+	switch (out_fmt) {
+	case AV_SAMPLE_FMT_U8:  return select_generic<I, uint8_t>(in_planar, out_planar);
+	case AV_SAMPLE_FMT_S16: return select_generic<I, int16_t>(in_planar, out_planar);
+	case AV_SAMPLE_FMT_S32: return select_generic<I, int32_t>(in_planar, out_planar);
+	case AV_SAMPLE_FMT_FLT: return select_generic<I, float>(in_planar, out_planar);
+	default: return nullptr;
+	}
+}
+
+SampleConverter::ConvertFunc select_generic(const AVSampleFormat in_fmt, const AVSampleFormat out_fmt, const bool in_planar, const bool out_planar)
+{
+	switch (in_fmt) {
+	case AV_SAMPLE_FMT_U8:  return select_generic<uint8_t>(out_fmt, in_planar, out_planar);
+	case AV_SAMPLE_FMT_S16: return select_generic<int16_t>(out_fmt, in_planar, out_planar);
+	case AV_SAMPLE_FMT_S32: return select_generic<int32_t>(out_fmt, in_planar, out_planar);
+	case AV_SAMPLE_FMT_FLT: return select_generic<float>(out_fmt, in_planar, out_planar);
+	case AV_SAMPLE_FMT_DBL: return select_generic<double>(out_fmt, in_planar, out_planar);
+	default: return nullptr;
+	}
+}
+
+//
+// SSE2 kernels
+//
+
+inline __m128i cvt_s16(const __m128 a, const __m128 b)
+{
+	const __m128 k = _mm_set1_ps(32768.0f);
+	const __m128 lo = _mm_set1_ps(-32768.0f);
+	const __m128 hi = _mm_set1_ps(32767.0f);
+	// clamped before the conversion, out of range values of cvtps2dq are negative
+	const __m128i ia = _mm_cvtps_epi32(_mm_min_ps(_mm_max_ps(_mm_mul_ps(a, k), lo), hi));
+	const __m128i ib = _mm_cvtps_epi32(_mm_min_ps(_mm_max_ps(_mm_mul_ps(b, k), lo), hi));
+	return _mm_packs_epi32(ia, ib);
+}
+
+inline void cvt_flt(const __m128i x, __m128& a, __m128& b)
+{
+	const __m128 k = _mm_set1_ps(1.0f / 32768);
+	a = _mm_mul_ps(_mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(x, x), 16)), k);
+	b = _mm_mul_ps(_mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpackhi_epi16(x, x), 16)), k);
+}
+
+void flt_to_s16(int16_t* d, const float* s, const int n)
+{
+	int i = 0;
+	for (; i + 8 <= n; i += 8) {
+		_mm_storeu_si128((__m128i*)(d + i), cvt_s16(_mm_loadu_ps(s + i), _mm_loadu_ps(s + i + 4)));
+	}
+	for (; i < n; i++) {
+		d[i] = conv<int16_t>(s[i]);
+	}
+}
+
+void s16_to_flt(float* d, const int16_t* s, const int n)
+{
+	int i = 0;
+	for (; i + 8 <= n; i += 8) {
+		__m128 a, b;
+		cvt_flt(_mm_loadu_si128((const __m128i*)(s + i)), a, b);
+		_mm_storeu_ps(d + i, a);
+		_mm_storeu_ps(d + i + 4, b);
+	}
+	for (; i < n; i++) {
+		d[i] = conv<float>(s[i]);
+	}
+}
+
+void flt_to_s16_packed(uint8_t* const* dst, const uint8_t* const* src, int count, int channels)
+{
+	flt_to_s16((int16_t*)dst[0], (const float*)src[0], count * channels);
+}
+
+void s16_to_flt_packed(uint8_t* const* dst, const uint8_t* const* src, int count, int channels)
+{
+	s16_to_flt((float*)dst[0], (const int16_t*)src[0], count * channels);
+}
+
+void flt_to_s16_planar(uint8_t* const* dst, const uint8_t* const* src, int count, int channels)
+{
+	for (int ch = 0; ch < channels; ch++) {
+		flt_to_s16((int16_t*)dst[ch], (const float*)src[ch], count);
+	}
+}
+
+void s16_to_flt_planar(uint8_t* const* dst, const uint8_t* const* src, int count, int channels)
+{
+	for (int ch = 0; ch < channels; ch++) {
+		s16_to_flt((float*)dst[ch], (const int16_t*)src[ch], count);
+	}
+}
+
+// stereo, 32-bit samples (float or s32)
+void interleave2_32(uint8_t* const* dst, const uint8_t* const* src, int count, int)
+{
+	const float* l = (const float*)src[0];
+	const float* r = (const float*)src[1];
+	float* d = (float*)dst[0];
+	int i = 0;
+	for (; i + 4 <= count; i += 4) {
+		const __m128 a = _mm_loadu_ps(l + i);
+		const __m128 b = _mm_loadu_ps(r + i);
+		_mm_storeu_ps(d + 2 * i,     _mm_unpacklo_ps(a, b));
+		_mm_storeu_ps(d + 2 * i + 4, _mm_unpackhi_ps(a, b));
+	}
+	// integer copy, s32 values are not always valid floats
+	for (; i < count; i++) {
+		((uint32_t*)d)[2 * i]     = ((const uint32_t*)l)[i];
+		((uint32_t*)d)[2 * i + 1] = ((const uint32_t*)r)[i];
+	}
+}
+
+void deinterleave2_32(uint8_t* const* dst, const uint8_t* const* src, int count, int)
+{
+	const float* s = (const float*)src[0];
+	float* l = (float*)dst[0];
+	float* r = (float*)dst[1];
+	int i = 0;
+	for (; i + 4 <= count; i += 4) {
+		const __m128 a = _mm_loadu_ps(s + 2 * i);
+		const __m128 b = _mm_loadu_ps(s + 2 * i + 4);
+		_mm_storeu_ps(l + i, _mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0)));
+		_mm_storeu_ps(r + i, _mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1)));
+	}
+	for (; i < count; i++) {
+		((uint32_t*)l)[i] = ((const uint32_t*)s)[2 * i];
+		((uint32_t*)r)[i] = ((const uint32_t*)s)[2 * i + 1];
+	}
+}
+
+// stereo, s16
+void interleave2_16(uint8_t* const* dst, const uint8_t* const* src, int count, int)
+{
+	const int16_t* l = (const int16_t*)src[0];
+	const int16_t* r = (const int16_t*)src[1];
+	int16_t* d = (int16_t*)dst[0];
+	int i = 0;
+	for (; i + 8 <= count; i += 8) {
+		const __m128i a = _mm_loadu_si128((const __m128i*)(l + i));
+		const __m128i b = _mm_loadu_si128((const __m128i*)(r + i));
+		_mm_storeu_si128((__m128i*)(d + 2 * i),     _mm_unpacklo_epi16(a, b));
+		_mm_storeu_si128((__m128i*)(d + 2 * i + 8), _mm_unpackhi_epi16(a, b));
+	}
+	for (; i < count; i++) {
+		d[2 * i]     = l[i];
+		d[2 * i + 1] = r[i];
+	}
+}
+
+inline void split_s16(const __m128i a, const __m128i b, __m128i& l, __m128i& r)
+{
+	l = _mm_packs_epi32(_mm_srai_epi32(_mm_slli_epi32(a, 16), 16), _mm_srai_epi32(_mm_slli_epi32(b, 16), 16));
+	r = _mm_packs_epi32(_mm_srai_epi32(a, 16), _mm_srai_epi32(b, 16));
+}
+
+void deinterleave2_16(uint8_t* const* dst, const uint8_t* const* src, int count, int)
+{
+	const int16_t* s = (const int16_t*)src[0];
+	int16_t* l = (int16_t*)dst[0];
+	int16_t* r = (int16_t*)dst[1];
+	int i = 0;
+	for (; i + 8 <= count; i += 8) {
+		__m128i a, b;
+		split_s16(_mm_loadu_si128((const __m128i*)(s + 2 * i)), _mm_loadu_si128((const __m128i*)(s + 2 * i + 8)), a, b);
+		_mm_storeu_si128((__m128i*)(l + i), a);
+		_mm_storeu_si128((__m128i*)(r + i), b);
+	}
+	for (; i < count; i++) {
+		l[i] = s[2 * i];
+		r[i] = s[2 * i + 1];
+	}
+}
+
+// stereo, planar float to interleaved s16 (decoder output)
+void fltp2_to_s16(uint8_t* const* dst, const uint8_t* const* src, int count, int)
+{
+	const float* l = (const float*)src[0];
+	const float* r = (const float*)src[1];
+	int16_t* d = (int16_t*)dst[0];
+	int i = 0;
+	for (; i + 8 <= count; i += 8) {
+		const __m128i a = cvt_s16(_mm_loadu_ps(l + i), _mm_loadu_ps(l + i + 4));
+		const __m128i b = cvt_s16(_mm_loadu_ps(r + i), _mm_loadu_ps(r + i + 4));
+		_mm_storeu_si128((__m128i*)(d + 2 * i),     _mm_unpacklo_epi16(a, b));
+		_mm_storeu_si128((__m128i*)(d + 2 * i + 8), _mm_unpackhi_epi16(a, b));
+	}
+	for (; i < count; i++) {
+		d[2 * i]     = conv<int16_t>(l[i]);
+		d[2 * i + 1] = conv<int16_t>(r[i]);
+	}
+}
+
+// stereo, interleaved s16 to planar float (encoder input)
+void s16_to_fltp2(uint8_t* const* dst, const uint8_t* const* src, int count, int)
+{
+	const int16_t* s = (const int16_t*)src[0];
+	float* l = (float*)dst[0];
+	float* r = (float*)dst[1];
+	int i = 0;
+	for (; i + 8 <= count; i += 8) {
+		__m128i a, b;
+		split_s16(_mm_loadu_si128((const __m128i*)(s + 2 * i)), _mm_loadu_si128((const __m128i*)(s + 2 * i + 8)), a, b);
+		__m128 f0, f1;
+		cvt_flt(a, f0, f1);
+		_mm_storeu_ps(l + i, f0);
+		_mm_storeu_ps(l + i + 4, f1);
+		cvt_flt(b, f0, f1);
+		_mm_storeu_ps(r + i, f0);
+		_mm_storeu_ps(r + i + 4, f1);
+	}
+	for (; i < count; i++) {
+		l[i] = conv<float>(s[2 * i]);
+		r[i] = conv<float>(s[2 * i + 1]);
+	}
+}
+
+SampleConverter::ConvertFunc select_sse2(const AVSampleFormat in_fmt, const AVSampleFormat out_fmt, const bool in_planar, const bool out_planar, const int channels)
+{
+	const bool in_32 = (in_fmt == AV_SAMPLE_FMT_FLT || in_fmt == AV_SAMPLE_FMT_S32);
+
+	if (in_fmt == out_fmt && channels == 2 && in_planar != out_planar) {
+		if (in_32) {
+			return in_planar ? interleave2_32 : deinterleave2_32;
+		}
+		if (in_fmt == AV_SAMPLE_FMT_S16) {
+			return in_planar ? interleave2_16 : deinterleave2_16;
+		}
+	}
+	if (in_fmt == AV_SAMPLE_FMT_FLT && out_fmt == AV_SAMPLE_FMT_S16) {
+		if (in_planar == out_planar) {
+			return in_planar ? flt_to_s16_planar : flt_to_s16_packed;
+		}
+		if (channels == 2 && in_planar) {
+			return fltp2_to_s16;
+		}
+	}
+	if (in_fmt == AV_SAMPLE_FMT_S16 && out_fmt == AV_SAMPLE_FMT_FLT) {
+		if (in_planar == out_planar) {
+			return in_planar ? s16_to_flt_planar : s16_to_flt_packed;
+		}
+		if (channels == 2 && out_planar) {
+			return s16_to_fltp2;
+		}
+	}
+	return nullptr;
+}
+
+} // namespace
+
+bool SampleConverter::Init(AVSampleFormat in_fmt, AVSampleFormat out_fmt, int channels)
+{
+	m_func = nullptr;
+	m_channels = channels;
+	if (channels < 1) {
+		return false;
+	}
+
+	// a single plane is the same as packed
+	const bool in_planar = av_sample_fmt_is_planar(in_fmt) && channels > 1;
+	const bool out_planar = av_sample_fmt_is_planar(out_fmt) && channels > 1;
+	in_fmt = av_get_packed_sample_fmt(in_fmt);
+	out_fmt = av_get_packed_sample_fmt(out_fmt);
+
+	if (pixconv::GetCpuLevel() != pixconv::kCpu_C) {
+		m_func = select_sse2(in_fmt, out_fmt, in_planar, out_planar, channels);
+	}
+	if (!m_func) {
+		m_func = select_generic(in_fmt, out_fmt, in_planar, out_planar);
+	}
+
+	return m_func != nullptr;
+}
@@ -0,0 +1,42 @@
+/*
+ * Copyright (C) 2026 v0lt
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#pragma once
+
+#include <cstdint>
+
+extern "C"
+{
+#include <libavutil/samplefmt.h>
+}
+
+// Conversion of audio samples between formats with the same channels and rate.
+// Replaces libswresample when the conversion is only a repack (planar <-> interleaved)
+// and/or a change of the sample type. The results are the same as swr_convert without
+// dithering: integers are shifted, float to integer is rounded to nearest and clipped.
+// Stereo interleave/deinterleave and float <-> s16 have SSE2 kernels.
+// Input: U8, S16, S32, FLT, DBL, output: U8, S16, S32, FLT (planar or packed).
+
+class SampleConverter
+{
+public:
+	typedef void (*ConvertFunc)(uint8_t* const* dst, const uint8_t* const* src, int count, int channels);
+
+	// returns false if the conversion is not supported, swresample has to be used then
+	bool Init(AVSampleFormat in_fmt, AVSampleFormat out_fmt, int channels);
+	void Reset() { m_func = nullptr; }
+	bool IsValid() const { return m_func != nullptr; }
+
+	// dst and src are plane pointers (one for packed formats), count is the number of samples per channel
+	void Convert(uint8_t* const* dst, const uint8_t* const* src, int count) const
+	{
+		m_func(dst, src, count, m_channels);
+	}
+
+private:
+	ConvertFunc m_func = nullptr;
+	int m_channels = 0;
+};
@@ -11,8 +11,14 @@
 #include "FileInfo2.h"
 #include "VideoSource2.h"
 #include "AudioSource2.h"
+#include "Demuxer.h"
 #include "export.h"
+#include "StreamCopy.h"
+#include "AsyncWriter.h"
+#include "MuxCompat.h"
 #include "AudioEncoder/AudioEnc.h"
+#include "VideoEncoder/VideoEnc_x264.h"
+#include "VideoEncoder/VideoEnc_x265.h"
 #include "resource.h"
 #include <vfw.h>
 #include "Helper.h"
@@ -21,37 +27,38 @@
 #include "Utils/StringUtil.h"
 
 extern HINSTANCE hInstance;
+extern int config_output_buffer;
+extern bool config_direct_io;
 
-void adjust_codec_tag2(const char* src_format, const AVOutputFormat* format, AVStream* st)
+static VDFFAsyncWriter::Options output_io_options()
 {
-	if (src_format && strcmp(src_format, format->name) == 0) {
-		return;
-	}
-	AVCodecID codec_id = st->codecpar->codec_id;
-	unsigned int tag = st->codecpar->codec_tag;
-	st->codecpar->codec_tag = 0;
-	AVCodecID codec_id1 = av_codec_get_id(format->codec_tag, tag);
-	unsigned int codec_tag2;
-	int have_codec_tag2 = av_codec_get_tag2(format->codec_tag, codec_id, &codec_tag2);
-	if (!format->codec_tag || codec_id1 == codec_id || !have_codec_tag2) {
-		st->codecpar->codec_tag = tag;
-	}
+	VDFFAsyncWriter::Options io;
+	io.buffer_size = config_output_buffer << 20;
+	io.direct = config_direct_io;
+	return io;
 }
 
-void adjust_codec_tag(const char* src_format, const AVOutputFormat* format, AVStream* st)
+// smart render encodes with the settings of the x264/x265 encoder of the plugin
+static VDFFGopSettings smart_render_settings(AVCodecID codec_id)
 {
-	if (src_format && strcmp(src_format, format->name) == 0) {
-		return;
+	VDFFGopSettings settings;
+	if (codec_id == AV_CODEC_ID_H264) {
+		CodecX264 codec;
+		settings.preset = x264_preset_names[codec.codec_config.preset];
+		if (codec.codec_config.tune > 0) {
+			settings.tune = x264_tune_names[codec.codec_config.tune];
+		}
+		settings.crf = codec.codec_config.crf;
 	}
-	AVCodecID codec_id = st->codecpar->codec_id;
-	unsigned int tag = st->codecpar->codec_tag;
-	st->codecpar->codec_tag = 0;
-	AVCodecID codec_id1 = av_codec_get_id(format->codec_tag, tag);
-	unsigned int codec_tag2;
-	int have_codec_tag2 = av_codec_get_tag2(format->codec_tag, codec_id, &codec_tag2);
-	if (!format->codec_tag || codec_id1 == codec_id || !have_codec_tag2) {
-		st->codecpar->codec_tag = tag;
+	else if (codec_id == AV_CODEC_ID_HEVC) {
+		CodecX265 codec;
+		settings.preset = x265_preset_names[codec.codec_config.preset];
+		if (codec.codec_config.tune > 0) {
+			settings.tune = x265_tune_names[codec.codec_config.tune];
+		}
+		settings.crf = codec.codec_config.crf;
 	}
+	return settings;
 }
 
 uint32_t export_avi_fcc(AVStream* src)
@@ -60,7 +67,7 @@ uint32_t export_avi_fcc(AVStream* src)
 	AVStream* st = avformat_new_stream(ctx, nullptr);
 	avcodec_parameters_copy(st->codecpar, src->codecpar);
 	const AVOutputFormat* format = av_guess_format("avi", nullptr, nullptr);
-	adjust_codec_tag(0, format, st);
+	VDFFStreamCopy::AdjustCodecTag(nullptr, format, st);
 	uint32_t r = st->codecpar->codec_tag;
 	// missing tag in type1 avi
 	if (!r) {
@@ -74,7 +81,17 @@ bool VDXAPIENTRY VDFFInputFile::GetExportMenuInfo(int id, char* name, int name_s
 {
 	if (id == 0) {
 		strncpy_s(name, 256, "Stream copy...", name_size);
-		*enabled = !is_image && !is_image_list;
+		*enabled = video_source && !is_image && !is_image_list;
+		return true;
+	}
+	if (id == 1) {
+		strncpy_s(name, 256, "Split stream copy...", name_size);
+		*enabled = video_source && !is_image && !is_image_list;
+		return true;
+	}
+	if (id == 2) {
+		strncpy_s(name, 256, "Smart render...", name_size);
+		*enabled = video_source && !is_image && !is_image_list;
 		return true;
 	}
 
@@ -87,6 +104,14 @@ bool VDXAPIENTRY VDFFInputFile::GetExportCommandName(int id, char* name, int nam
 		strncpy_s(name, 128, "Export.StreamCopy", name_size);
 		return true;
 	}
+	if (id == 1) {
+		strncpy_s(name, 128, "Export.StreamCopySplit", name_size);
+		return true;
+	}
+	if (id == 2) {
+		strncpy_s(name, 128, "Export.SmartRender", name_size);
+		return true;
+	}
 
 	return false;
 }
@@ -139,6 +164,74 @@ bool exportSaveFile(HWND hwnd, wchar_t* path, int max_path) {
 	return false;
 }
 
+// name of the n-th following file: "clip-01.mkv" -> "clip-03.mkv" for n = 2,
+// a name without a number gets one: "clip.mkv" -> "clip-03.mkv"
+std::wstring numbered_path(const wchar_t* path, int n)
+{
+	const wchar_t* ext = GetFileExt(path);
+	std::wstring stem = ext ? std::wstring(path, ext - path) : std::wstring(path);
+
+	size_t digits = stem.size();
+	while (digits > 0 && iswdigit(stem[digits - 1])) {
+		digits--;
+	}
+	const size_t width = stem.size() - digits;
+	std::wstring name;
+	if (width > 0 && width < 10) {
+		const int first = _wtoi(stem.c_str() + digits);
+		name = stem.substr(0, digits) + std::format(L"{:0{}}", first + n, width);
+	} else {
+		name = stem + std::format(L"-{:02}", n + 1);
+	}
+	if (ext) {
+		name += ext;
+	}
+	return name;
+}
+
+class SplitDialog : public VDXVideoFilterDialog
+{
+public:
+	double length = 60; // seconds
+
+	virtual INT_PTR DlgProc(UINT msg, WPARAM wParam, LPARAM lParam);
+	bool Show(HWND parent) {
+		return VDXVideoFilterDialog::Show(hInstance, MAKEINTRESOURCEW(IDD_EXPORT_SPLIT), parent) == TRUE;
+	}
+};
+
+INT_PTR SplitDialog::DlgProc(UINT msg, WPARAM wParam, LPARAM lParam)
+{
+	switch (msg) {
+	case WM_INITDIALOG:
+	{
+		auto str = std::format(L"{}", length);
+		SetDlgItemTextW(mhdlg, IDC_SPLIT_LENGTH, str.c_str());
+		return TRUE;
+	}
+	case WM_COMMAND:
+		switch (LOWORD(wParam)) {
+		case IDOK:
+		{
+			wchar_t buf[64];
+			double v;
+			if (!GetDlgItemTextW(mhdlg, IDC_SPLIT_LENGTH, buf, (int)std::size(buf)) || swscanf_s(buf, L"%lf", &v) != 1 || v <= 0) {
+				MessageBeep(MB_ICONEXCLAMATION);
+				SetFocus(GetDlgItem(mhdlg, IDC_SPLIT_LENGTH));
+				return TRUE;
+			}
+			length = v;
+			EndDialog(mhdlg, TRUE);
+			return TRUE;
+		}
+		case IDCANCEL:
+			EndDialog(mhdlg, FALSE);
+			return TRUE;
+		}
+	}
+	return FALSE;
+}
+
 struct ProgressDialog : public VDXVideoFilterDialog {
 public:
 	bool abort            = false;
@@ -266,7 +359,7 @@ void ProgressDialog::check()
 
 bool VDXAPIENTRY VDFFInputFile::ExecuteExport(int id, VDXHWND parent, IProjectState* state)
 {
-	if (id == 0) {
+	if (id == 0 || id == 1 || id == 2) {
 		sint64 start;
 		sint64 end;
 		if (!state->GetSelection(start, end)) {
@@ -274,6 +367,17 @@ bool VDXAPIENTRY VDFFInputFile::ExecuteExport(int id, VDXHWND parent, IProjectSt
 			end = video_source->m_sample_count;
 		}
 
+		// the clips of a split are written in one pass over the file
+		static double split_length = 60;
+		if (id == 1) {
+			SplitDialog dlg;
+			dlg.length = split_length;
+			if (!dlg.Show((HWND)parent)) {
+				return false;
+			}
+			split_length = dlg.length;
+		}
+
 		const wchar_t* ext0 = GetFileExt(m_path.c_str());
 		wchar_t path2[MAX_PATH];
 		if (ext0) {
@@ -291,10 +395,6 @@ bool VDXAPIENTRY VDFFInputFile::ExecuteExport(int id, VDXHWND parent, IProjectSt
 			return false;
 		}
 
-		const wchar_t* ext1 = GetFileExt(path2);
-		bool same_format = wcscmp(ext0, ext1) == 0;
-
-		std::string ff_path = ConvertWideToUtf8(m_path);
 		std::string out_ff_path = ConvertWideToUtf8(path2);
 
 		const AVOutputFormat* oformat = av_guess_format(nullptr, out_ff_path.c_str(), nullptr);
@@ -306,213 +406,62 @@ bool VDXAPIENTRY VDFFInputFile::ExecuteExport(int id, VDXHWND parent, IProjectSt
 		ProgressDialog progress;
 		progress.Show((HWND)parent);
 
-		AVFormatContext* fmt = nullptr;
-		AVFormatContext* ofmt = nullptr;
-		bool v_end;
-		bool a_end;
-		int64_t vt_end = -1;
-		int64_t at_end = -1;
-		int64_t pos0, pos1;
-		int64_t a_bias = 0;
-		int video = -1;
-		int audio = -1;
-		AVStream* out_video = nullptr;
-		AVStream* out_audio = nullptr;
-
-		int err = 0;
-		err = avformat_open_input(&fmt, ff_path.c_str(), nullptr, nullptr);
-		if (err < 0) {
-			goto end;
-		}
-		err = avformat_find_stream_info(fmt, nullptr);
-		if (err < 0) {
-			goto end;
-		}
-
-		err = avformat_alloc_output_context2(&ofmt, nullptr, nullptr, out_ff_path.c_str());
-		if (err < 0) {
-			goto end;
-		}
-
-		video = video_source->m_streamIndex;
+		VDFFStreamCopy::Job job;
+		// the file is already probed, only the headers are parsed again
+		job.fmt = m_demuxer->OpenClone();
+		job.io = output_io_options();
+		job.streams.push_back(video_source->m_streamIndex);
 		if (audio_source) {
-			audio = audio_source->m_streamIndex;
-		}
-
-		for (int i = 0; i < (int)fmt->nb_streams; i++) {
-			if (i != video && i != audio) {
-				continue;
-			}
-
-			AVStream* in_stream = fmt->streams[i];
-			AVStream* out_stream = avformat_new_stream(ofmt, nullptr);
-			if (!out_stream) {
-				err = AVERROR_UNKNOWN;
-				goto end;
-			}
-
-			err = avcodec_parameters_copy(out_stream->codecpar, in_stream->codecpar);
-			if (err < 0) {
-				goto end;
-			}
-
-			adjust_codec_tag2(m_pFormatCtx->iformat->name, ofmt->oformat, out_stream);
-
-			out_stream->sample_aspect_ratio = in_stream->sample_aspect_ratio;
-			out_stream->avg_frame_rate = in_stream->avg_frame_rate;
-			out_stream->time_base = in_stream->time_base;
-			out_stream->r_frame_rate = in_stream->r_frame_rate;
-
-			if (i == video) {
-				out_video = out_stream;
-			}
-			else if (i == audio) {
-				out_audio = out_stream;
-			}
-		}
-
-		if (!(ofmt->oformat->flags & AVFMT_NOFILE)) {
-			err = avio_open(&ofmt->pb, out_ff_path.c_str(), AVIO_FLAG_WRITE);
-			if (err < 0) {
-				goto end;
-			}
+			job.streams.push_back(audio_source->m_streamIndex);
 		}
-
-		err = avformat_write_header(ofmt, nullptr);
-		if (err < 0) {
-			goto end;
-		}
-
-		/*
-		int64_t vt_end = video_source->frame_to_pts_next(end);
-		int64_t at_end = -1;
-		if(out_audio) at_end = audio_source->frame_to_pts(end,video_source->m_pStream);
-		*/
-
-		pos1 = end * video_source->m_frame_ts.num / video_source->m_frame_ts.den + video_source->m_start_time;
-		av_seek_frame(fmt, video, pos1, 0);
-
-		while (1) {
-			std::unique_ptr<AVPacket, std::function<void(AVPacket*)>> pkt{ av_packet_alloc(), [](AVPacket* p) { av_packet_free(&p); } };
-
-			err = av_read_frame(fmt, pkt.get());
-			if (err < 0) {
-				break;
-			}
-
-			AVStream* s = fmt->streams[pkt->stream_index];
-			int64_t t = pkt->pts;
-			if (t == AV_NOPTS_VALUE) {
-				t = pkt->dts;
-			}
-			if (pkt->stream_index == video) {
-				if (vt_end == -1) {
-					vt_end = t;
-				}
-			}
-			if (pkt->stream_index == audio) {
-				if (at_end == -1) {
-					at_end = t;
+		const int64_t pos0 = start * video_source->m_frame_ts.num / video_source->m_frame_ts.den + video_source->m_start_time;
+		const int64_t pos1 = end * video_source->m_frame_ts.num / video_source->m_frame_ts.den + video_source->m_start_time;
+		// the index maps frames to timestamps, smart render finds its cuts without reading the file
+		if (id == 2 && video_source->trust_index && !video_source->has_vfr) {
+			for (int i = 0; i < video_source->m_sample_count; i++) {
+				if (video_source->IsKey(i)) {
+					job.keyframes.push_back(int64_t(i) * video_source->m_frame_ts.num / video_source->m_frame_ts.den + video_source->m_start_time);
 				}
 			}
-			av_packet_unref(pkt.get());
-
-			if (vt_end != -1 && (at_end != -1 || audio == -1)) {
-				break;
-			}
 		}
-
-		pos0 = start * video_source->m_frame_ts.num / video_source->m_frame_ts.den + video_source->m_start_time;
-		av_seek_frame(fmt, video, pos0, AVSEEK_FLAG_BACKWARD);
-
-		v_end = out_video == 0;
-		a_end = out_audio == 0;
-		if (out_audio) {
-			a_bias = av_rescale_q(pos0, fmt->streams[video]->time_base, fmt->streams[audio]->time_base);
+		// the partial GOPs at the cuts are re-encoded, the rest is copied
+		job.smart_render = (id == 2);
+		if (job.smart_render) {
+			job.smart_settings = smart_render_settings(video_source->m_pStream->codecpar->codec_id);
 		}
-
-		while (1) {
-			if (v_end && a_end) {
-				break;
-			}
-			progress.check();
-			if (progress.abort) {
-				break;
-			}
-
-			std::unique_ptr<AVPacket, std::function<void(AVPacket*)>> pkt{ av_packet_alloc(), [](AVPacket* p) { av_packet_free(&p); } };
-
-			err = av_read_frame(fmt, pkt.get());
-			if (err < 0) {
-				err = 0;
-				break;
-			}
-
-			AVStream* in_stream = fmt->streams[pkt->stream_index];
-			int64_t t = pkt->pts;
-			if (t == AV_NOPTS_VALUE) {
-				t = pkt->dts;
-			}
-
-			AVStream* out_stream = nullptr;
-			if (pkt->stream_index == video) {
-				if (vt_end != -1 && t >= vt_end) {
-					v_end = true;
-				} else {
-					out_stream = out_video;
-				}
-				if (pkt->pts != AV_NOPTS_VALUE) {
-					pkt->pts -= pos0;
-				}
-				if (pkt->dts != AV_NOPTS_VALUE) {
-					pkt->dts -= pos0;
-				}
-				progress.current_pos = (double(t) - pos0) / (pos1 - pos0);
-			}
-			if (pkt->stream_index == audio) {
-				if (at_end != -1 && t >= at_end) {
-					a_end = true;
-				} else {
-					out_stream = out_audio;
-				}
-				out_stream = out_audio;
-				if (pkt->pts != AV_NOPTS_VALUE) {
-					pkt->pts -= a_bias;
-				}
-				if (pkt->dts != AV_NOPTS_VALUE) {
-					pkt->dts -= a_bias;
-				}
-			}
-
-			if (out_stream) {
-				int64_t size = pkt->size;
-				av_packet_rescale_ts(pkt.get(), in_stream->time_base, out_stream->time_base);
-				pkt->pos = -1;
-				pkt->stream_index = out_stream->index;
-				err = av_interleaved_write_frame(ofmt, pkt.get());
-				if (err < 0) {
-					av_packet_unref(pkt.get());
-					break;
-				}
-				progress.current_bytes += size;
-				progress.changed = true;
+		if (id != 1) {
+			VDFFStreamCopy::Output& out = job.outputs.emplace_back();
+			out.path = out_ff_path;
+			out.ranges.push_back({ pos0, pos1 });
+		} else {
+			const AVRational tb = video_source->m_pStream->time_base;
+			const int64_t clip = std::max<int64_t>(llround(split_length * tb.den / tb.num), 1);
+			// adjacent clips are cut at one keyframe, together they are the selection
+			int n = 0;
+			for (int64_t t = pos0; t < pos1; t += clip, n++) {
+				VDFFStreamCopy::Output& out = job.outputs.emplace_back();
+				out.path = ConvertWideToUtf8(numbered_path(path2, n));
+				out.ranges.push_back({ t, std::min(t + clip, pos1) });
 			}
-
-			av_packet_unref(pkt.get());
 		}
 
-		av_write_trailer(ofmt);
+		VDFFStreamCopy::Callbacks cb;
+		cb.progress = [&progress](int, double pos, int64_t bytes) {
+			progress.current_pos = pos;
+			progress.current_bytes = bytes;
+			progress.changed = true;
+			progress.check();
+			return !progress.abort;
+		};
 
-	end:
-		avformat_close_input(&fmt);
-		if (ofmt && !(ofmt->oformat->flags & AVFMT_NOFILE)) {
-			avio_closep(&ofmt->pb);
-		}
-		avformat_free_context(ofmt);
+		int err = job.fmt ? VDFFStreamCopy::RunJob(job, 0, cb) : AVERROR(EIO);
 
 		progress.current_pos = 1;
 		progress.sync_state();
 
+		if (err == AVERROR_EXIT) {
+			return false;
+		}
 		if (err < 0) {
 			std::string errstr("Operation failed.\nInternal error (FFMPEG): ");
 			errstr.append(AVError2Str(err));
@@ -520,10 +469,9 @@ bool VDXAPIENTRY VDFFInputFile::ExecuteExport(int id, VDXHWND parent, IProjectSt
 			MessageBoxA(progress.getHwnd(), errstr.c_str(), "Stream copy", MB_ICONSTOP | MB_OK);
 			return false;
 		}
-		else if (!progress.abort) {
-			MessageBoxW(progress.getHwnd(), L"Operation completed successfully.", L"Stream copy", MB_OK);
-			return true;
-		}
+
+		MessageBoxW(progress.getHwnd(), L"Operation completed successfully.", L"Stream copy", MB_OK);
+		return true;
 	}
 
 	return false;
@@ -537,7 +485,7 @@ FFOutputFile::FFOutputFile(const VDXInputDriverContext& pContext)
 FFOutputFile::~FFOutputFile()
 {
 	Finalize();
-	free(a_buf);
+	av_packet_free(&m_pkt);
 }
 
 void FFOutputFile::av_error(int err)
@@ -805,13 +753,8 @@ void FFOutputFile::SetAudio(uint32 index, const VDXStreamInfo& si, const void* p
 	s.time_base = st->time_base;
 }
 
-void* FFOutputFile::bswap_pcm(uint32 index, const void* pBuffer, uint32 cbBuffer)
+void FFOutputFile::bswap_pcm(uint32 index, const void* pBuffer, uint32 cbBuffer, void* dst)
 {
-	if (a_buf_size < cbBuffer) {
-		a_buf = realloc(a_buf, cbBuffer);
-		a_buf_size = cbBuffer;
-	}
-
 	StreamInfo& s = stream[index];
 	switch (s.st->codecpar->codec_id) {
 	case AV_CODEC_ID_PCM_S16LE:
@@ -820,7 +763,7 @@ void* FFOutputFile::bswap_pcm(uint32 index, const void* pBuffer, uint32 cbBuffer
 	case AV_CODEC_ID_PCM_U16BE:
 	{
 		const uint16_t* a = (const uint16_t*)pBuffer;
-		uint16_t* b = (uint16_t*)a_buf;
+		uint16_t* b = (uint16_t*)dst;
 		for (uint32 i = 0; i < cbBuffer / 2; i++) {
 			b[i] = _byteswap_ushort(a[i]);
 		}
@@ -834,7 +777,7 @@ void* FFOutputFile::bswap_pcm(uint32 index, const void* pBuffer, uint32 cbBuffer
 	case AV_CODEC_ID_PCM_U32BE:
 	{
 		const uint32_t* a = (const uint32_t*)pBuffer;
-		uint32_t* b = (uint32_t*)a_buf;
+		uint32_t* b = (uint32_t*)dst;
 		for (uint32 i = 0; i < cbBuffer / 4; i++) {
 			b[i] = _byteswap_ulong(a[i]);
 		}
@@ -846,15 +789,30 @@ void* FFOutputFile::bswap_pcm(uint32 index, const void* pBuffer, uint32 cbBuffer
 	case AV_CODEC_ID_PCM_S64BE:
 	{
 		const uint64_t* a = (const uint64_t*)pBuffer;
-		uint64_t* b = (uint64_t*)a_buf;
+		uint64_t* b = (uint64_t*)dst;
 		for (uint32 i = 0; i < cbBuffer / 8; i++) {
 			b[i] = _byteswap_uint64(a[i]);
 		}
 	}
 	break;
 	}
+}
 
-	return a_buf;
+AVBufferRef* FFOutputFile::alloc_payload(StreamInfo& s, uint32 size)
+{
+	const size_t need = size_t(size) + AV_INPUT_BUFFER_PADDING_SIZE;
+	if (need > s.pool_size) {
+		// the buffers in use stay valid, the old pool is freed with the last one.
+		// Some headroom, so that slowly growing frames do not recreate the pool every time.
+		av_buffer_pool_uninit(&s.pool);
+		s.pool_size = need + need / 4;
+		s.pool = av_buffer_pool_init(s.pool_size, nullptr);
+		if (!s.pool) {
+			s.pool_size = 0;
+			return nullptr;
+		}
+	}
+	return av_buffer_pool_get(s.pool);
 }
 
 const AVCodecTag* avformat_get_nut_video_tags();
@@ -1000,7 +958,7 @@ fail:
 void FFOutputFile::adjust_codec_tag(AVStream* st)
 {
 	// initial tag imported from bmp: suitable for avi
-	::adjust_codec_tag("avi", m_ofmt->oformat, st);
+	VDFFStreamCopy::AdjustCodecTag("avi", m_ofmt->oformat, st);
 }
 
 bool FFOutputFile::Begin()
@@ -1014,44 +972,10 @@ bool FFOutputFile::test_streams()
 {
 	for (int i = 0; i < (int)stream.size(); i++) {
 		StreamInfo& si = stream[i];
-		AVCodecID codec_id = si.st->codecpar->codec_id;
-
-		IOWBuffer io;
-		int buf_size = 4096;
-		void* buf = av_malloc(buf_size);
-		AVIOContext* avio_ctx = avio_alloc_context((unsigned char*)buf, buf_size, 1, &io, nullptr, &IOWBuffer::Write, &IOWBuffer::Seek);
-		AVFormatContext* ofmt = avformat_alloc_context();
-		ofmt->pb = avio_ctx;
-		ofmt->oformat = this->m_ofmt->oformat;
-		AVStream* st = avformat_new_stream(ofmt, nullptr);
-		avcodec_parameters_copy(st->codecpar, si.st->codecpar);
-		st->sample_aspect_ratio = si.st->sample_aspect_ratio;
-		st->avg_frame_rate = si.st->avg_frame_rate;
-		st->r_frame_rate = st->avg_frame_rate;
-		st->time_base = si.st->time_base;
-
-		if (st->codecpar->codec_type == AVMEDIA_TYPE_AUDIO) {
-			if (ofmt->oformat == av_guess_format("mp4", nullptr, nullptr)) {
-				st->codecpar->codec_tag = 0;
-			}
-		}
-
-		bool failed = true;
-		if (avformat_write_header(ofmt, nullptr) < 0) {
-			goto cleanup;
-		}
-		if (av_write_trailer(ofmt) < 0) {
-			goto cleanup;
-		}
-		failed = false;
-
-	cleanup:
-		av_free(avio_ctx->buffer);
-		av_free(avio_ctx);
-		avformat_free_context(ofmt);
-		if (failed) {
+		// the result of the test muxing is cached
+		if (!VDFFMuxCompat::IsSupported(m_ofmt->oformat, si.st)) {
 			std::string msg;
-			msg += avcodec_get_name(codec_id);
+			msg += avcodec_get_name(si.st->codecpar->codec_id);
 			msg += ": codec not currently supported in container ";
 			msg += format_name;
 			mContext.mpCallbacks->SetError(msg.c_str());
@@ -1100,7 +1024,13 @@ void FFOutputFile::Write(uint32 index, const void* pBuffer, uint32 cbBuffer, Pac
 
 		int err = 0;
 		if (!(m_ofmt->oformat->flags & AVFMT_NOFILE)) {
-			err = avio_open(&m_ofmt->pb, m_out_ff_path.c_str(), AVIO_FLAG_WRITE);
+			// writing behind does not stall the encoder, but faststart reads the file back
+			async_io = !mp4_faststart;
+			if (async_io) {
+				err = VDFFAsyncWriter::Open(&m_ofmt->pb, m_out_ff_path.c_str(), output_io_options());
+			} else {
+				err = avio_open(&m_ofmt->pb, m_out_ff_path.c_str(), AVIO_FLAG_WRITE);
+			}
 			if (err < 0) {
 				av_error(err);
 				Finalize();
@@ -1132,12 +1062,33 @@ void FFOutputFile::Write(uint32 index, const void* pBuffer, uint32 cbBuffer, Pac
 		return;
 	}
 
-	AVPacket* pkt = av_packet_alloc();
-	// pkt->data points to pBuffer or a_buf
-	if (s.bswap_pcm) {
-		pkt->data = (uint8_t*)bswap_pcm(index, pBuffer, cbBuffer);
-	} else {
+	if (!m_pkt) {
+		m_pkt = av_packet_alloc();
+		if (!m_pkt) {
+			av_error(AVERROR(ENOMEM));
+			return;
+		}
+	}
+	AVPacket* pkt = m_pkt;
+
+	// with one stream nothing is queued for interleaving, the muxer uses the buffer of the host.
+	// Otherwise the payload is copied once into a pooled buffer that the queue takes over.
+	const bool interleave = m_ofmt->nb_streams > 1;
+	if (!interleave && !s.bswap_pcm) {
 		pkt->data = (uint8_t*)pBuffer;
+	} else {
+		pkt->buf = alloc_payload(s, cbBuffer);
+		if (!pkt->buf) {
+			av_error(AVERROR(ENOMEM));
+			return;
+		}
+		pkt->data = pkt->buf->data;
+		if (s.bswap_pcm) {
+			bswap_pcm(index, pBuffer, cbBuffer, pkt->data);
+		} else {
+			memcpy(pkt->data, pBuffer, cbBuffer);
+		}
+		memset(pkt->data + cbBuffer, 0, AV_INPUT_BUFFER_PADDING_SIZE);
 	}
 	pkt->size = cbBuffer;
 
@@ -1169,15 +1120,17 @@ void FFOutputFile::Write(uint32 index, const void* pBuffer, uint32 cbBuffer, Pac
 
 	s.frame += samples;
 
-	int err = av_interleaved_write_frame(m_ofmt, pkt);
+	int err = interleave ? av_interleaved_write_frame(m_ofmt, pkt) : av_write_frame(m_ofmt, pkt);
 	if (err < 0) {
 		av_error(err);
 	}
 
-	// pkt->data no longer points to pBuffer or a_buf
-	pkt->data = nullptr;
-	pkt->size = 0;
-	av_packet_free(&pkt);
+	// pkt->data may point to pBuffer
+	if (!pkt->buf) {
+		pkt->data = nullptr;
+		pkt->size = 0;
+	}
+	av_packet_unref(pkt);
 };
 
 void FFOutputFile::Finalize()
@@ -1186,11 +1139,22 @@ void FFOutputFile::Finalize()
 		av_write_trailer(m_ofmt);
 	}
 
-	if (m_ofmt && !(m_ofmt->oformat->flags & AVFMT_NOFILE)) {
+	if (m_ofmt && async_io) {
+		const int err = VDFFAsyncWriter::Close(&m_ofmt->pb);
+		if (err < 0) {
+			av_error(err);
+		}
+	} else if (m_ofmt && !(m_ofmt->oformat->flags & AVFMT_NOFILE)) {
 		avio_closep(&m_ofmt->pb);
 	}
+	async_io = false;
 	avformat_free_context(m_ofmt);
 	m_ofmt = nullptr;
+
+	for (auto& s : stream) {
+		av_buffer_pool_uninit(&s.pool);
+		s.pool_size = 0;
+	}
 }
 
 enum {
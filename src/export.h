@@ -28,6 +28,8 @@ public:
 		int64_t offset_den = 1;
 		AVRational time_base = { 0, 0 };
 		bool bswap_pcm = false;
+		AVBufferPool* pool = nullptr; // payloads of the queued packets
+		size_t pool_size = 0;
 	};
 
 	std::string m_out_ff_path;
@@ -37,9 +39,9 @@ public:
 	bool header = false;
 	bool stream_test = false;
 	bool mp4_faststart = false;
+	bool async_io = false;
 
-	void* a_buf = nullptr;
-	uint32 a_buf_size = 0;
+	AVPacket* m_pkt = nullptr; // reused for every Write
 
 	FFOutputFile(const VDXInputDriverContext& pContext);
 	~FFOutputFile();
@@ -59,7 +61,8 @@ public:
 	void import_bmp(AVStream* st, const void* pFormat, int cbFormat);
 	void import_wav(AVStream* st, const void* pFormat, int cbFormat);
 	bool test_streams();
-	void* bswap_pcm(uint32 index, const void* pBuffer, uint32 cbBuffer);
+	AVBufferRef* alloc_payload(StreamInfo& s, uint32 size);
+	void bswap_pcm(uint32 index, const void* pBuffer, uint32 cbBuffer, void* dst);
 };
 
 class VDFFOutputFileDriver : public vdxunknown<IVDXOutputFileDriver>
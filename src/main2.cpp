@@ -20,7 +20,10 @@ bool config_decode_raw = false;
 bool config_decode_magic = false;
 bool config_force_thread = false;
 bool config_disable_cache = false;
+bool config_probe_cache = true;
 float config_cache_size = 0.5;
+int config_output_buffer = 16; // MB
+bool config_direct_io = false;
 void saveConfig();
 
 class ConfigureDialog : public VDXVideoFilterDialog {
@@ -110,6 +113,14 @@ bool VDXAPIENTRY ff_create(const VDXInputDriverContext* pContext, IVDXInputFileD
 	return true;
 }
 
+bool VDXAPIENTRY ff_create_audio(const VDXInputDriverContext* pContext, IVDXInputFileDriver** ppDriver)
+{
+	VDFFInputFileDriver* p = new VDFFInputFileDriver(*pContext, true);
+	*ppDriver = p;
+	p->AddRef();
+	return true;
+}
+
 #define OPTION_VIDEO_INIT L"FFmpeg : video|*.mp4;*.mov;*.mkv;*.webm;*.flv;*.avi;*.nut;*.y4m"
 std::wstring option_video = OPTION_VIDEO_INIT;
 //std::wstring pattern_video; // example "*.mov|*.mp4|*.avi"
@@ -159,7 +170,7 @@ VDXInputDriverDefinition ff_audio = {
 	0,
 	option_audio.c_str(),
 	L"Caching input driver",
-	ff_create
+	ff_create_audio
 };
 
 VDXPluginInfo ff_plugin_video = {
@@ -220,10 +231,15 @@ void saveConfig()
 	WritePrivateProfileStringW(L"force_ffmpeg", L"MagicYUV", config_decode_magic ? L"1" : L"0", buf);
 	WritePrivateProfileStringW(L"decode_model", L"force_frame_thread", config_force_thread ? L"1" : L"0", buf);
 	WritePrivateProfileStringW(L"decode_model", L"disable_cache", config_disable_cache ? L"1" : L"0", buf);
+	WritePrivateProfileStringW(L"decode_model", L"probe_cache", config_probe_cache ? L"1" : L"0", buf);
 
 	auto str = std::format(L"{:.2}", config_cache_size);
 	WritePrivateProfileStringW(L"decode_model", L"cache_size", str.c_str(), buf);
 
+	str = std::format(L"{}", config_output_buffer);
+	WritePrivateProfileStringW(L"output", L"buffer_size", str.c_str(), buf);
+	WritePrivateProfileStringW(L"output", L"direct_io", config_direct_io ? L"1" : L"0", buf);
+
 	WritePrivateProfileStringW(0, 0, 0, buf);
 }
 
@@ -248,6 +264,9 @@ void loadConfig()
 	config_decode_magic = GetPrivateProfileIntW(L"force_ffmpeg", L"MagicYUV", 0, buf) != 0;
 	config_force_thread = GetPrivateProfileIntW(L"decode_model", L"force_frame_thread", 0, buf) != 0;
 	config_disable_cache = GetPrivateProfileIntW(L"decode_model", L"disable_cache", 0, buf) != 0;
+	config_probe_cache = GetPrivateProfileIntW(L"decode_model", L"probe_cache", 1, buf) != 0;
+	config_output_buffer = std::clamp((int)GetPrivateProfileIntW(L"output", L"buffer_size", 16, buf), 1, 1024);
+	config_direct_io = GetPrivateProfileIntW(L"output", L"direct_io", 0, buf) != 0;
 
 	wchar_t buf2[128];
 	GetPrivateProfileStringW(L"decode_model", L"cache_size", L"0.5", buf2, 128, buf);
@@ -0,0 +1,216 @@
+/*
+ * Copyright (C) 2026 v0lt
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include "pixconv_impl.h"
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+namespace pixconv {
+
+RowsFunc get_rows_c(const Params& p)
+{
+	return select_rows<VecC>(p);
+}
+
+static CpuLevel detect_cpu()
+{
+#ifdef _MSC_VER
+	int info[4];
+	__cpuid(info, 0);
+	const int max_leaf = info[0];
+	if (max_leaf < 1) {
+		return kCpu_C;
+	}
+	__cpuid(info, 1);
+	const bool sse41   = (info[2] & (1 << 19)) != 0;
+	const bool osxsave = (info[2] & (1 << 27)) != 0;
+	const bool avx     = (info[2] & (1 << 28)) != 0;
+	if (!sse41) {
+		return kCpu_C;
+	}
+	if (max_leaf >= 7 && osxsave && avx && (_xgetbv(0) & 6) == 6) {
+		__cpuidex(info, 7, 0);
+		if (info[1] & (1 << 5)) {
+			return kCpu_AVX2;
+		}
+	}
+	return kCpu_SSE41;
+#else
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2")) {
+		return kCpu_AVX2;
+	}
+	if (__builtin_cpu_supports("sse4.1")) {
+		return kCpu_SSE41;
+	}
+	return kCpu_C;
+#endif
+}
+
+CpuLevel GetCpuLevel()
+{
+	static const CpuLevel level = detect_cpu();
+	return level;
+}
+
+// swscale bicubic kernel (param B=0, C=0.6)
+static double cubic(double x)
+{
+	const double a = -0.6;
+	x = fabs(x);
+	if (x < 1) {
+		return ((a + 2) * x - (a + 3)) * x * x + 1;
+	}
+	if (x < 2) {
+		return ((a * x - 5 * a) * x + 8 * a) * x - 4 * a;
+	}
+	return 0;
+}
+
+// chroma sample k is located at the luma position 2k + d
+static void init_taps(const double d, int off[2], float w[2][4], bool exact[2])
+{
+	for (int par = 0; par < 2; par++) {
+		const double c = (par - d) / 2;
+		const double fl = floor(c);
+		const double f = c - fl;
+		off[par] = (int)fl;
+		exact[par] = (f == 0);
+		w[par][0] = (float)cubic(1 + f);
+		w[par][1] = (float)cubic(f);
+		w[par][2] = (float)cubic(1 - f);
+		w[par][3] = (float)cubic(2 - f);
+	}
+}
+
+// chroma siting and matrix of YUV sources
+static bool init_yuv(Params& p, const int* coeffs, const bool full_range, const AVChromaLocation chroma_loc)
+{
+	if (!coeffs) {
+		return false;
+	}
+
+	// horizontal and vertical chroma position relative to the first luma sample (in luma samples)
+	double dh = 0;
+	double dv = 0.5;
+	switch (chroma_loc) {
+	case AVCHROMA_LOC_CENTER:     dh = 0.5; dv = 0.5; break;
+	case AVCHROMA_LOC_TOPLEFT:    dh = 0;   dv = 0;   break;
+	case AVCHROMA_LOC_TOP:        dh = 0.5; dv = 0;   break;
+	case AVCHROMA_LOC_BOTTOMLEFT: dh = 0;   dv = 1;   break;
+	case AVCHROMA_LOC_BOTTOM:     dh = 0.5; dv = 1;   break;
+	default: // left, unspecified
+		break;
+	}
+	init_taps(dh, p.h_off, p.h_w, p.h_exact);
+	init_taps(dv, p.v_off, p.v_w, p.v_exact);
+
+	double crv = coeffs[0] / 65536.0;
+	double cbu = coeffs[1] / 65536.0;
+	double cgu = coeffs[2] / 65536.0;
+	double cgv = coeffs[3] / 65536.0;
+
+	const double s = double(1 << (p.depth - 8));
+	double cy, oy, c0, norm;
+	if (full_range) {
+		cy = 1;
+		oy = 0;
+		c0 = double(1 << (p.depth - 1));
+		norm = double((1 << p.depth) - 1);
+		crv *= 224.0 / 255;
+		cbu *= 224.0 / 255;
+		cgu *= 224.0 / 255;
+		cgv *= 224.0 / 255;
+	} else {
+		cy = 255.0 / 219;
+		oy = 16 * s;
+		c0 = 128 * s;
+		norm = 255 * s;
+	}
+
+	const double scale = (p.out16 ? 65535.0 : 255.0) / norm;
+	p.k_y  = (float)(scale * cy);
+	p.k_rv = (float)(scale * crv);
+	p.k_gu = (float)(-scale * cgu);
+	p.k_gv = (float)(-scale * cgv);
+	p.k_bu = (float)(scale * cbu);
+	p.off_r = (float)(scale * (-cy * oy - crv * c0));
+	p.off_g = (float)(scale * (-cy * oy + (cgu + cgv) * c0));
+	p.off_b = (float)(scale * (-cy * oy - cbu * c0));
+
+	return true;
+}
+
+} // namespace pixconv
+
+bool PixelConverter::Init(AVPixelFormat src_fmt, AVPixelFormat dst_fmt, int width, int height,
+	const int* coeffs, bool full_range, AVChromaLocation chroma_loc)
+{
+	using namespace pixconv;
+
+	m_rows = nullptr;
+	if (width <= 0 || height <= 0) {
+		return false;
+	}
+
+	Params p;
+	p.width = width;
+	p.height = height;
+
+	switch (dst_fmt) {
+	case AV_PIX_FMT_BGRA:   p.out16 = false; break;
+	case AV_PIX_FMT_BGRA64: p.out16 = true;  break;
+	default:
+		return false;
+	}
+
+	switch (src_fmt) {
+	case AV_PIX_FMT_YUV420P:
+	case AV_PIX_FMT_YUVJ420P:     p.depth = 8;  p.ss_x = true;  p.ss_y = true;  break;
+	case AV_PIX_FMT_YUV422P:
+	case AV_PIX_FMT_YUVJ422P:     p.depth = 8;  p.ss_x = true;  p.ss_y = false; break;
+	case AV_PIX_FMT_YUV444P:
+	case AV_PIX_FMT_YUVJ444P:     p.depth = 8;  p.ss_x = false; p.ss_y = false; break;
+	case AV_PIX_FMT_YUV420P9LE:   p.depth = 9;  p.ss_x = true;  p.ss_y = true;  break;
+	case AV_PIX_FMT_YUV422P9LE:   p.depth = 9;  p.ss_x = true;  p.ss_y = false; break;
+	case AV_PIX_FMT_YUV444P9LE:   p.depth = 9;  p.ss_x = false; p.ss_y = false; break;
+	case AV_PIX_FMT_YUV420P10LE:  p.depth = 10; p.ss_x = true;  p.ss_y = true;  break;
+	case AV_PIX_FMT_YUV422P10LE:  p.depth = 10; p.ss_x = true;  p.ss_y = false; break;
+	case AV_PIX_FMT_YUV444P10LE:  p.depth = 10; p.ss_x = false; p.ss_y = false; break;
+	case AV_PIX_FMT_YUV420P12LE:  p.depth = 12; p.ss_x = true;  p.ss_y = true;  break;
+	case AV_PIX_FMT_YUV422P12LE:  p.depth = 12; p.ss_x = true;  p.ss_y = false; break;
+	case AV_PIX_FMT_YUV444P12LE:  p.depth = 12; p.ss_x = false; p.ss_y = false; break;
+	case AV_PIX_FMT_GBRP16LE:     p.depth = 16; p.rgb = true; break;
+	case AV_PIX_FMT_GBRP16BE:     p.depth = 16; p.rgb = true; p.big_endian = true; break;
+	case AV_PIX_FMT_GBRAP16LE:    p.depth = 16; p.rgb = true; p.alpha = true; break;
+	case AV_PIX_FMT_GBRAP16BE:    p.depth = 16; p.rgb = true; p.alpha = true; p.big_endian = true; break;
+	default:
+		return false;
+	}
+
+	if (p.rgb) {
+		if (!p.out16) {
+			return false;
+		}
+	}
+	else if (!init_yuv(p, coeffs, full_range, chroma_loc)) {
+		return false;
+	}
+
+	RowsFunc rows;
+	switch (GetCpuLevel()) {
+	case kCpu_AVX2:  rows = get_rows_avx2(p);  break;
+	case kCpu_SSE41: rows = get_rows_sse41(p); break;
+	default:         rows = get_rows_c(p);
+	}
+
+	m_params = p;
+	m_rows = rows;
+
+	return true;
+}
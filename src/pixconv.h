@@ -0,0 +1,82 @@
+/*
+ * Copyright (C) 2026 v0lt
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#pragma once
+
+#include <cstdint>
+
+extern "C"
+{
+#include <libavutil/pixfmt.h>
+}
+
+// Fast conversion of common decoder formats to XRGB8888 (BGRA) and XRGB64 (BGRA64).
+// Replaces swscale with SWS_BICUBIC | SWS_FULL_CHR_H_INT | SWS_ACCURATE_RND for
+// 8..12-bit YUV 4:2:0, 4:2:2, 4:4:4. Uses the same matrices (sws_getCoefficients),
+// the same bicubic kernel for chroma upsampling (B=0, C=0.6) and correct rounding.
+// 16-bit planar RGB (GBRP16, GBRAP16, LE and BE) to BGRA64 is a plain interleave.
+// Anything else is left to swscale.
+
+namespace pixconv {
+	enum CpuLevel {
+		kCpu_C = 0,
+		kCpu_SSE41,
+		kCpu_AVX2,
+	};
+
+	struct Params {
+		int width  = 0;
+		int height = 0;
+		int depth  = 8;     // bits per source sample
+		bool ss_x  = false; // chroma is horizontally subsampled
+		bool ss_y  = false; // chroma is vertically subsampled
+		bool out16 = false; // BGRA64 output
+		bool rgb   = false; // 16-bit planar RGB source, samples are copied
+		bool big_endian = false;
+		bool alpha = false; // source has alpha plane
+
+		// chroma upsampling: for each luma parity the offset of the first of 4 taps and the weights
+		int   h_off[2] = {};
+		float h_w[2][4] = {};
+		bool  h_exact[2] = {};
+		int   v_off[2] = {};
+		float v_w[2][4] = {};
+		bool  v_exact[2] = {};
+
+		// out = k_y * Y + k_u * U + k_v * V + off, raw sample values
+		float k_y = 0;
+		float k_rv = 0, k_gu = 0, k_gv = 0, k_bu = 0;
+		float off_r = 0, off_g = 0, off_b = 0;
+	};
+
+	typedef void (*RowsFunc)(const Params& p, const uint8_t* const src[4], const int src_stride[4], uint8_t* dst, int dst_stride, int y0, int y1);
+
+	RowsFunc get_rows_c(const Params& p);
+	RowsFunc get_rows_sse41(const Params& p);
+	RowsFunc get_rows_avx2(const Params& p);
+
+	CpuLevel GetCpuLevel();
+}
+
+class PixelConverter
+{
+public:
+	// coeffs: result of sws_getCoefficients for the source color space (not used for RGB sources)
+	bool Init(AVPixelFormat src_fmt, AVPixelFormat dst_fmt, int width, int height,
+		const int* coeffs, bool full_range, AVChromaLocation chroma_loc);
+	void Reset() { m_rows = nullptr; }
+	bool IsValid() const { return m_rows != nullptr; }
+
+	// converts destination rows [y0, y1), the full picture is given in src and dst
+	void Convert(const uint8_t* const src[4], const int src_stride[4], uint8_t* dst, int dst_stride, int y0, int y1) const
+	{
+		m_rows(m_params, src, src_stride, dst, dst_stride, y0, y1);
+	}
+
+private:
+	pixconv::Params m_params;
+	pixconv::RowsFunc m_rows = nullptr;
+};
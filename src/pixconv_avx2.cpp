@@ -0,0 +1,93 @@
+/*
+ * Copyright (C) 2026 v0lt
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include <immintrin.h>
+#include "pixconv_impl.h"
+
+namespace pixconv {
+namespace {
+
+struct VecAVX2 {
+	static constexpr int N = 8;
+	static constexpr int M = 16;
+	typedef __m256 F;
+
+	static F load(const float* p) { return _mm256_loadu_ps(p); }
+	static F load(const uint8_t* p) { return _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)p))); }
+	static F load(const uint16_t* p) { return _mm256_cvtepi32_ps(_mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i*)p))); }
+	static void store(float* p, F a) { _mm256_storeu_ps(p, a); }
+	static void store2(float* p, F e, F o)
+	{
+		const __m256 lo = _mm256_unpacklo_ps(e, o); // e0 o0 e1 o1 | e4 o4 e5 o5
+		const __m256 hi = _mm256_unpackhi_ps(e, o); // e2 o2 e3 o3 | e6 o6 e7 o7
+		_mm256_storeu_ps(p,     _mm256_permute2f128_ps(lo, hi, 0x20));
+		_mm256_storeu_ps(p + 8, _mm256_permute2f128_ps(lo, hi, 0x31));
+	}
+	static F set1(float a) { return _mm256_set1_ps(a); }
+	static F add(F a, F b) { return _mm256_add_ps(a, b); }
+	static F mul(F a, F b) { return _mm256_mul_ps(a, b); }
+
+	static void store_bgra(uint8_t* p, F b, F g, F r)
+	{
+		// per 128-bit lane, the lanes hold pixels 0-3 and 4-7
+		const __m256i bg = _mm256_packs_epi32(_mm256_cvtps_epi32(b), _mm256_cvtps_epi32(g));
+		const __m256i ra = _mm256_packs_epi32(_mm256_cvtps_epi32(r), _mm256_set1_epi32(0xFF));
+		const __m256i planar = _mm256_packus_epi16(bg, ra);
+		const __m256i mask = _mm256_setr_epi8(
+			0, 4, 8, 12, 1, 5, 9, 13, 2, 6, 10, 14, 3, 7, 11, 15,
+			0, 4, 8, 12, 1, 5, 9, 13, 2, 6, 10, 14, 3, 7, 11, 15);
+		_mm256_storeu_si256((__m256i*)p, _mm256_shuffle_epi8(planar, mask));
+	}
+
+	static void store_bgra(uint16_t* p, F b, F g, F r)
+	{
+		const __m256i bg = _mm256_packus_epi32(_mm256_cvtps_epi32(b), _mm256_cvtps_epi32(g));
+		const __m256i ra = _mm256_packus_epi32(_mm256_cvtps_epi32(r), _mm256_set1_epi32(0xFFFF));
+		const __m256i br = _mm256_unpacklo_epi16(bg, ra);
+		const __m256i ga = _mm256_unpackhi_epi16(bg, ra);
+		const __m256i q0 = _mm256_unpacklo_epi16(br, ga); // pixels 0,1 | 4,5
+		const __m256i q1 = _mm256_unpackhi_epi16(br, ga); // pixels 2,3 | 6,7
+		_mm256_storeu_si256((__m256i*)p,        _mm256_permute2x128_si256(q0, q1, 0x20));
+		_mm256_storeu_si256((__m256i*)(p + 16), _mm256_permute2x128_si256(q0, q1, 0x31));
+	}
+
+	template <bool swap>
+	static __m256i load16(const uint16_t* p)
+	{
+		const __m256i v = _mm256_loadu_si256((const __m256i*)p);
+		return swap ? _mm256_or_si256(_mm256_slli_epi16(v, 8), _mm256_srli_epi16(v, 8)) : v;
+	}
+
+	template <bool swap, bool alpha>
+	static void pack_bgra64(const uint16_t* b, const uint16_t* g, const uint16_t* r, const uint16_t* a, uint16_t* p)
+	{
+		const __m256i vb = load16<swap>(b);
+		const __m256i vg = load16<swap>(g);
+		const __m256i vr = load16<swap>(r);
+		const __m256i va = alpha ? load16<swap>(a) : _mm256_set1_epi16(-1);
+		const __m256i bg_lo = _mm256_unpacklo_epi16(vb, vg); // pixels 0-3 | 8-11
+		const __m256i bg_hi = _mm256_unpackhi_epi16(vb, vg); // pixels 4-7 | 12-15
+		const __m256i ra_lo = _mm256_unpacklo_epi16(vr, va);
+		const __m256i ra_hi = _mm256_unpackhi_epi16(vr, va);
+		const __m256i q0 = _mm256_unpacklo_epi32(bg_lo, ra_lo); // pixels 0,1 | 8,9
+		const __m256i q1 = _mm256_unpackhi_epi32(bg_lo, ra_lo); // pixels 2,3 | 10,11
+		const __m256i q2 = _mm256_unpacklo_epi32(bg_hi, ra_hi); // pixels 4,5 | 12,13
+		const __m256i q3 = _mm256_unpackhi_epi32(bg_hi, ra_hi); // pixels 6,7 | 14,15
+		_mm256_storeu_si256((__m256i*)p,        _mm256_permute2x128_si256(q0, q1, 0x20));
+		_mm256_storeu_si256((__m256i*)(p + 16), _mm256_permute2x128_si256(q2, q3, 0x20));
+		_mm256_storeu_si256((__m256i*)(p + 32), _mm256_permute2x128_si256(q0, q1, 0x31));
+		_mm256_storeu_si256((__m256i*)(p + 48), _mm256_permute2x128_si256(q2, q3, 0x31));
+	}
+};
+
+} // namespace
+
+RowsFunc get_rows_avx2(const Params& p)
+{
+	return select_rows<VecAVX2>(p);
+}
+
+} // namespace pixconv
@@ -0,0 +1,280 @@
+/*
+ * Copyright (C) 2026 v0lt
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#pragma once
+
+// Row kernels of pixconv, parameterized by a vector type.
+// Included by pixconv.cpp (plain C++) and by the files compiled for SSE4.1 and AVX2.
+// Everything here has internal linkage: the same templates are compiled with different
+// instruction sets and must not be merged by the linker.
+
+#include "pixconv.h"
+#include <cstddef>
+#include <cmath>
+#include <vector>
+#include <algorithm>
+
+namespace pixconv {
+namespace {
+
+inline uint16_t bswap16(const uint16_t v)
+{
+	return uint16_t((v >> 8) | (v << 8));
+}
+
+struct VecC {
+	static constexpr int N = 1;
+	static constexpr int M = 1; // pixels per pack_bgra64
+	typedef float F;
+
+	static F load(const float* p) { return *p; }
+	static F load(const uint8_t* p) { return (float)*p; }
+	static F load(const uint16_t* p) { return (float)*p; }
+	static void store(float* p, F a) { *p = a; }
+	static void store2(float* p, F e, F o) { p[0] = e; p[1] = o; }
+	static F set1(float a) { return a; }
+	static F add(F a, F b) { return a + b; }
+	static F mul(F a, F b) { return a * b; }
+
+	static int round_clamp(F a, int max)
+	{
+		int v = (int)lrintf(a);
+		return v < 0 ? 0 : (v > max ? max : v);
+	}
+
+	static void store_bgra(uint8_t* p, F b, F g, F r)
+	{
+		p[0] = (uint8_t)round_clamp(b, 0xFF);
+		p[1] = (uint8_t)round_clamp(g, 0xFF);
+		p[2] = (uint8_t)round_clamp(r, 0xFF);
+		p[3] = 0xFF;
+	}
+
+	static void store_bgra(uint16_t* p, F b, F g, F r)
+	{
+		p[0] = (uint16_t)round_clamp(b, 0xFFFF);
+		p[1] = (uint16_t)round_clamp(g, 0xFFFF);
+		p[2] = (uint16_t)round_clamp(r, 0xFFFF);
+		p[3] = 0xFFFF;
+	}
+
+	template <bool swap, bool alpha>
+	static void pack_bgra64(const uint16_t* b, const uint16_t* g, const uint16_t* r, const uint16_t* a, uint16_t* p)
+	{
+		p[0] = swap ? bswap16(*b) : *b;
+		p[1] = swap ? bswap16(*g) : *g;
+		p[2] = swap ? bswap16(*r) : *r;
+		p[3] = alpha ? (swap ? bswap16(*a) : *a) : 0xFFFF;
+	}
+};
+
+template <typename T>
+inline const T* plane_row(const uint8_t* plane, const int stride, const int y)
+{
+	return (const T*)(plane + (ptrdiff_t)y * stride);
+}
+
+// 4-tap vertical interpolation of chroma rows
+template <class S, typename T>
+void vfilter(const T* const r[4], const float* w, float* dst, const int x0, const int x1)
+{
+	typedef typename S::F F;
+	const F w0 = S::set1(w[0]);
+	const F w1 = S::set1(w[1]);
+	const F w2 = S::set1(w[2]);
+	const F w3 = S::set1(w[3]);
+
+	for (int x = x0; x < x1; x += S::N) {
+		F a = S::mul(w0, S::load(r[0] + x));
+		a = S::add(a, S::mul(w1, S::load(r[1] + x)));
+		a = S::add(a, S::mul(w2, S::load(r[2] + x)));
+		a = S::add(a, S::mul(w3, S::load(r[3] + x)));
+		S::store(dst + x, a);
+	}
+}
+
+template <class S, typename T>
+void vcopy(const T* r, float* dst, const int x0, const int x1)
+{
+	for (int x = x0; x < x1; x += S::N) {
+		S::store(dst + x, S::load(r + x));
+	}
+}
+
+template <class S>
+typename S::F tap4(const float* c, const typename S::F* w)
+{
+	typename S::F a = S::mul(w[0], S::load(c));
+	a = S::add(a, S::mul(w[1], S::load(c + 1)));
+	a = S::add(a, S::mul(w[2], S::load(c + 2)));
+	a = S::add(a, S::mul(w[3], S::load(c + 3)));
+	return a;
+}
+
+// horizontal 2x interpolation, c must be padded by 2 samples on each side
+template <class S>
+void hfilter(const Params& p, const float* c, float* dst, const int k0, const int k1)
+{
+	typedef typename S::F F;
+	F we[4], wo[4];
+	for (int i = 0; i < 4; i++) {
+		we[i] = S::set1(p.h_w[0][i]);
+		wo[i] = S::set1(p.h_w[1][i]);
+	}
+	const float* ce = c + p.h_off[0];
+	const float* co = c + p.h_off[1];
+
+	for (int k = k0; k < k1; k += S::N) {
+		F e = p.h_exact[0] ? S::load(ce + k) : tap4<S>(ce + k - 1, we);
+		F o = p.h_exact[1] ? S::load(co + k) : tap4<S>(co + k - 1, wo);
+		S::store2(dst + 2 * k, e, o);
+	}
+}
+
+template <class S, typename T, typename O>
+void pack_rgb(const Params& p, const T* y, const float* u, const float* v, O* dst, const int x0, const int x1)
+{
+	typedef typename S::F F;
+	const F k_y  = S::set1(p.k_y);
+	const F k_rv = S::set1(p.k_rv);
+	const F k_gu = S::set1(p.k_gu);
+	const F k_gv = S::set1(p.k_gv);
+	const F k_bu = S::set1(p.k_bu);
+	const F off_r = S::set1(p.off_r);
+	const F off_g = S::set1(p.off_g);
+	const F off_b = S::set1(p.off_b);
+
+	for (int x = x0; x < x1; x += S::N) {
+		const F Y = S::mul(k_y, S::load(y + x));
+		const F U = S::load(u + x);
+		const F V = S::load(v + x);
+		const F r = S::add(S::add(Y, S::mul(k_rv, V)), off_r);
+		const F g = S::add(S::add(S::add(Y, S::mul(k_gu, U)), S::mul(k_gv, V)), off_g);
+		const F b = S::add(S::add(Y, S::mul(k_bu, U)), off_b);
+		S::store_bgra(dst + 4 * x, b, g, r);
+	}
+}
+
+// chroma row of the output row y, vertically interpolated
+template <class S, typename T>
+void chroma_row(const Params& p, const uint8_t* plane, const int stride, const int y, float* dst, const int cw)
+{
+	const int main = cw - cw % S::N;
+
+	if (!p.ss_y) {
+		const T* r = plane_row<T>(plane, stride, y);
+		vcopy<S, T>(r, dst, 0, main);
+		vcopy<VecC, T>(r, dst, main, cw);
+		return;
+	}
+
+	const int ch = (p.height + 1) >> 1;
+	const int par = y & 1;
+	const int m = (y >> 1) + p.v_off[par];
+
+	if (p.v_exact[par]) {
+		const T* r = plane_row<T>(plane, stride, std::clamp(m, 0, ch - 1));
+		vcopy<S, T>(r, dst, 0, main);
+		vcopy<VecC, T>(r, dst, main, cw);
+		return;
+	}
+
+	const T* r[4];
+	for (int i = 0; i < 4; i++) {
+		r[i] = plane_row<T>(plane, stride, std::clamp(m - 1 + i, 0, ch - 1));
+	}
+	vfilter<S, T>(r, p.v_w[par], dst, 0, main);
+	vfilter<VecC, T>(r, p.v_w[par], dst, main, cw);
+}
+
+template <class S, typename T, typename O>
+void convert_rows(const Params& p, const uint8_t* const src[4], const int src_stride[4], uint8_t* dst, int dst_stride, int y0, int y1)
+{
+	constexpr int pad = 8;
+	const int w  = p.width;
+	const int cw = p.ss_x ? (w + 1) >> 1 : w;
+	const int cw_main = cw - cw % S::N;
+	const int w_main  = w - w % S::N;
+
+	const size_t c_size = cw + pad * 2;
+	const size_t f_size = 2 * cw + pad;
+	std::vector<float> buf(c_size * 2 + (p.ss_x ? f_size * 2 : 0));
+	float* cu = buf.data() + pad;
+	float* cv = cu + c_size;
+	float* fu = cu;
+	float* fv = cv;
+	if (p.ss_x) {
+		fu = buf.data() + c_size * 2;
+		fv = fu + f_size;
+	}
+
+	for (int y = y0; y < y1; y++) {
+		chroma_row<S, T>(p, src[1], src_stride[1], y, cu, cw);
+		chroma_row<S, T>(p, src[2], src_stride[2], y, cv, cw);
+
+		if (p.ss_x) {
+			for (int i = 1; i <= pad; i++) {
+				cu[-i] = cu[0];
+				cv[-i] = cv[0];
+				cu[cw - 1 + i] = cu[cw - 1];
+				cv[cw - 1 + i] = cv[cw - 1];
+			}
+			hfilter<S>(p, cu, fu, 0, cw_main);
+			hfilter<VecC>(p, cu, fu, cw_main, cw);
+			hfilter<S>(p, cv, fv, 0, cw_main);
+			hfilter<VecC>(p, cv, fv, cw_main, cw);
+		}
+
+		const T* ly = plane_row<T>(src[0], src_stride[0], y);
+		O* out = (O*)(dst + (ptrdiff_t)y * dst_stride);
+		pack_rgb<S, T, O>(p, ly, fu, fv, out, 0, w_main);
+		pack_rgb<VecC, T, O>(p, ly, fu, fv, out, w_main, w);
+	}
+}
+
+template <class S, bool swap, bool alpha>
+void pack_rgb64(const uint16_t* g, const uint16_t* b, const uint16_t* r, const uint16_t* a, uint16_t* dst, const int x0, const int x1)
+{
+	for (int x = x0; x < x1; x += S::M) {
+		S::template pack_bgra64<swap, alpha>(b + x, g + x, r + x, alpha ? a + x : nullptr, dst + 4 * x);
+	}
+}
+
+// planes are G, B, R, A
+template <class S, bool swap, bool alpha>
+void planar_rgb_rows(const Params& p, const uint8_t* const src[4], const int src_stride[4], uint8_t* dst, int dst_stride, int y0, int y1)
+{
+	const int w = p.width;
+	const int w_main = w - w % S::M;
+
+	for (int y = y0; y < y1; y++) {
+		const uint16_t* g = plane_row<uint16_t>(src[0], src_stride[0], y);
+		const uint16_t* b = plane_row<uint16_t>(src[1], src_stride[1], y);
+		const uint16_t* r = plane_row<uint16_t>(src[2], src_stride[2], y);
+		const uint16_t* a = alpha ? plane_row<uint16_t>(src[3], src_stride[3], y) : nullptr;
+		uint16_t* out = (uint16_t*)(dst + (ptrdiff_t)y * dst_stride);
+		pack_rgb64<S, swap, alpha>(g, b, r, a, out, 0, w_main);
+		pack_rgb64<VecC, swap, alpha>(g, b, r, a, out, w_main, w);
+	}
+}
+
+template <class S>
+RowsFunc select_rows(const Params& p)
+{
+	if (p.rgb) {
+		if (p.big_endian) {
+			return p.alpha ? planar_rgb_rows<S, true, true> : planar_rgb_rows<S, true, false>;
+		}
+		return p.alpha ? planar_rgb_rows<S, false, true> : planar_rgb_rows<S, false, false>;
+	}
+	if (p.depth > 8) {
+		return p.out16 ? convert_rows<S, uint16_t, uint16_t> : convert_rows<S, uint16_t, uint8_t>;
+	}
+	return p.out16 ? convert_rows<S, uint8_t, uint16_t> : convert_rows<S, uint8_t, uint8_t>;
+}
+
+} // namespace
+} // namespace pixconv
@@ -0,0 +1,82 @@
+/*
+ * Copyright (C) 2026 v0lt
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include <smmintrin.h>
+#include "pixconv_impl.h"
+
+namespace pixconv {
+namespace {
+
+struct VecSSE41 {
+	static constexpr int N = 4;
+	static constexpr int M = 8;
+	typedef __m128 F;
+
+	static F load(const float* p) { return _mm_loadu_ps(p); }
+	static F load(const uint8_t* p) { return _mm_cvtepi32_ps(_mm_cvtepu8_epi32(_mm_loadu_si32(p))); }
+	static F load(const uint16_t* p) { return _mm_cvtepi32_ps(_mm_cvtepu16_epi32(_mm_loadl_epi64((const __m128i*)p))); }
+	static void store(float* p, F a) { _mm_storeu_ps(p, a); }
+	static void store2(float* p, F e, F o)
+	{
+		_mm_storeu_ps(p,     _mm_unpacklo_ps(e, o));
+		_mm_storeu_ps(p + 4, _mm_unpackhi_ps(e, o));
+	}
+	static F set1(float a) { return _mm_set1_ps(a); }
+	static F add(F a, F b) { return _mm_add_ps(a, b); }
+	static F mul(F a, F b) { return _mm_mul_ps(a, b); }
+
+	static void store_bgra(uint8_t* p, F b, F g, F r)
+	{
+		const __m128i bg = _mm_packs_epi32(_mm_cvtps_epi32(b), _mm_cvtps_epi32(g));
+		const __m128i ra = _mm_packs_epi32(_mm_cvtps_epi32(r), _mm_set1_epi32(0xFF));
+		const __m128i planar = _mm_packus_epi16(bg, ra); // b0-b3 g0-g3 r0-r3 a0-a3
+		const __m128i mask = _mm_setr_epi8(0, 4, 8, 12, 1, 5, 9, 13, 2, 6, 10, 14, 3, 7, 11, 15);
+		_mm_storeu_si128((__m128i*)p, _mm_shuffle_epi8(planar, mask));
+	}
+
+	static void store_bgra(uint16_t* p, F b, F g, F r)
+	{
+		const __m128i bg = _mm_packus_epi32(_mm_cvtps_epi32(b), _mm_cvtps_epi32(g));
+		const __m128i ra = _mm_packus_epi32(_mm_cvtps_epi32(r), _mm_set1_epi32(0xFFFF));
+		const __m128i br = _mm_unpacklo_epi16(bg, ra); // b0 r0 b1 r1 ...
+		const __m128i ga = _mm_unpackhi_epi16(bg, ra); // g0 a0 g1 a1 ...
+		_mm_storeu_si128((__m128i*)p,       _mm_unpacklo_epi16(br, ga));
+		_mm_storeu_si128((__m128i*)(p + 8), _mm_unpackhi_epi16(br, ga));
+	}
+
+	template <bool swap>
+	static __m128i load16(const uint16_t* p)
+	{
+		const __m128i v = _mm_loadu_si128((const __m128i*)p);
+		return swap ? _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8)) : v;
+	}
+
+	template <bool swap, bool alpha>
+	static void pack_bgra64(const uint16_t* b, const uint16_t* g, const uint16_t* r, const uint16_t* a, uint16_t* p)
+	{
+		const __m128i vb = load16<swap>(b);
+		const __m128i vg = load16<swap>(g);
+		const __m128i vr = load16<swap>(r);
+		const __m128i va = alpha ? load16<swap>(a) : _mm_set1_epi16(-1);
+		const __m128i bg_lo = _mm_unpacklo_epi16(vb, vg);
+		const __m128i bg_hi = _mm_unpackhi_epi16(vb, vg);
+		const __m128i ra_lo = _mm_unpacklo_epi16(vr, va);
+		const __m128i ra_hi = _mm_unpackhi_epi16(vr, va);
+		_mm_storeu_si128((__m128i*)p,        _mm_unpacklo_epi32(bg_lo, ra_lo));
+		_mm_storeu_si128((__m128i*)(p + 8),  _mm_unpackhi_epi32(bg_lo, ra_lo));
+		_mm_storeu_si128((__m128i*)(p + 16), _mm_unpacklo_epi32(bg_hi, ra_hi));
+		_mm_storeu_si128((__m128i*)(p + 24), _mm_unpackhi_epi32(bg_hi, ra_hi));
+	}
+};
+
+} // namespace
+
+RowsFunc get_rows_sse41(const Params& p)
+{
+	return select_rows<VecSSE41>(p);
+}
+
+} // namespace pixconv
@@ -12,6 +12,7 @@
 #define IDD_EXPORT_PROGRESS             105
 #define IDD_FFLAYER                     106
 #define IDD_FFLAYER_FILE                107
+#define IDD_EXPORT_SPLIT                108
 
 #define IDD_ENC_FFV1                    200
 #define IDD_ENC_FFVHUFF                 201
@@ -105,6 +106,7 @@
 #define IDC_CACHE_SPIN                  1060
 #define IDC_THREADING                   1061
 #define IDC_LINK                        1062
+#define IDC_SPLIT_LENGTH                1063
 
 #define IDC_ENCODER_LABEL               1070
 #define IDC_ENC_COLORSPACE              1071
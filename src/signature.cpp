@@ -0,0 +1,233 @@
+/*
+ * Copyright (C) 2026 v0lt
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include "stdafx.h"
+
+#include "signature.h"
+
+void copyCharToWchar(wchar_t* dst, size_t dst_size, const char* src); // InputFile2.cpp
+
+namespace {
+	inline uint16_t rl16(const uint8_t* p) { return p[0] | (p[1] << 8); }
+	inline uint32_t rl32(const uint8_t* p) { return p[0] | (p[1] << 8) | (p[2] << 16) | (uint32_t(p[3]) << 24); }
+	inline uint32_t rb32(const uint8_t* p) { return (uint32_t(p[0]) << 24) | (p[1] << 16) | (p[2] << 8) | p[3]; }
+
+	// MPEG-TS: sync byte every 188 bytes, M2TS: the same with a 4 byte timecode before each packet
+	bool check_ts(const uint8_t* p, const int size, const int packet, const int offset)
+	{
+		const int count = std::min(8, (size - offset) / packet);
+		if (count < 3) {
+			return false;
+		}
+		for (int i = 0; i < count; i++) {
+			if (p[offset + i * packet] != 0x47) {
+				return false;
+			}
+		}
+		return true;
+	}
+
+	bool check_mpegts(const uint8_t* p, const int size)
+	{
+		return check_ts(p, size, 188, 0);
+	}
+
+	bool check_m2ts(const uint8_t* p, const int size)
+	{
+		return check_ts(p, size, 192, 4);
+	}
+
+	// pack header of MPEG-2 or MPEG-1 program stream
+	bool check_mpegps(const uint8_t* p, const int size)
+	{
+		return size >= 12 && ((p[4] & 0xC4) == 0x44 || (p[4] & 0xF1) == 0x21);
+	}
+
+	// EBML header with DocType "matroska" or "webm"
+	bool check_ebml(const uint8_t* p, const int size)
+	{
+		const int end = std::min(size, 64);
+		for (int i = 4; i + 3 < end; i++) {
+			if (p[i] == 0x42 && p[i + 1] == 0x82 && (p[i + 2] & 0x80)) {
+				const int len = p[i + 2] & 0x7F;
+				if (i + 3 + len > size) {
+					return false;
+				}
+				const std::string_view doctype((const char*)p + i + 3, len);
+				return doctype.starts_with("matroska") || doctype.starts_with("webm");
+			}
+		}
+		return false;
+	}
+
+	bool check_flv(const uint8_t* p, const int size)
+	{
+		return size >= 9 && p[3] == 1 && rb32(p + 5) >= 9;
+	}
+
+	bool check_ogg(const uint8_t* p, const int size)
+	{
+		return size >= 27 && p[4] == 0;
+	}
+
+	bool check_bmp(const uint8_t* p, const int size)
+	{
+		if (size < 18 || rl32(p + 6) != 0) {
+			return false;
+		}
+		switch (rl32(p + 14)) {
+		case 12: case 40: case 52: case 56: case 64: case 108: case 124:
+			return true;
+		}
+		return false;
+	}
+
+	bool check_dds(const uint8_t* p, const int size)
+	{
+		return size >= 8 && rl32(p + 4) == 124;
+	}
+
+	// JPEG and JPEG-LS differ only by the SOF marker
+	int find_sof(const uint8_t* p, const int size)
+	{
+		int i = 2;
+		while (i + 4 <= size && p[i] == 0xFF) {
+			const int marker = p[i + 1];
+			if ((marker >= 0xC0 && marker <= 0xCF && marker != 0xC4 && marker != 0xC8 && marker != 0xCC) || marker == 0xF7) {
+				return marker;
+			}
+			i += 2 + ((p[i + 2] << 8) | p[i + 3]);
+		}
+		return -1;
+	}
+
+	bool check_jpeg(const uint8_t* p, const int size)
+	{
+		const int sof = find_sof(p, size);
+		return sof >= 0 && sof != 0xF7;
+	}
+
+	bool check_jpegls(const uint8_t* p, const int size)
+	{
+		return find_sof(p, size) == 0xF7;
+	}
+
+	bool check_pnm(const uint8_t* p, const int size)
+	{
+		return size >= 3 && (p[2] == ' ' || p[2] == '\n' || p[2] == '\r' || p[2] == '\t');
+	}
+
+	bool check_psd(const uint8_t* p, const int size)
+	{
+		return size >= 6 && (p[4] == 0) && (p[5] == 1 || p[5] == 2);
+	}
+
+	bool check_sgi(const uint8_t* p, const int size)
+	{
+		return size >= 6 && p[2] <= 1 && (p[3] == 1 || p[3] == 2) && p[5] >= 1 && p[5] <= 3;
+	}
+
+	bool check_pcx(const uint8_t* p, const int size)
+	{
+		if (size < 128 || p[1] > 5 || p[1] == 1 || p[2] != 1) {
+			return false;
+		}
+		switch (p[3]) {
+		case 1: case 2: case 4: case 8:
+			break;
+		default:
+			return false;
+		}
+		// x_max >= x_min, y_max >= y_min, reserved byte
+		return rl16(p + 8) >= rl16(p + 4) && rl16(p + 10) >= rl16(p + 6) && p[64] == 0;
+	}
+
+	struct Signature {
+		const char* name; // FFmpeg demuxer
+		int offset;
+		const char* magic;
+		int magic_size;
+		bool (*check)(const uint8_t* p, const int size);
+		const char* form = nullptr; // RIFF and FORM files: form type at offset 8
+	};
+
+#define SIG(name, offset, magic, check) { name, offset, magic, int(sizeof(magic) - 1), check }
+#define FORM(name, magic, form) { name, 0, magic, 4, nullptr, form }
+
+	const Signature s_signatures[] = {
+		// containers
+		SIG("matroska,webm",  0, "\x1A\x45\xDF\xA3", check_ebml),
+		SIG("mpeg",           0, "\x00\x00\x01\xBA", check_mpegps),
+		SIG("flv",            0, "FLV", check_flv),
+		SIG("nut",            0, "nut/multimedia container\0", nullptr),
+		SIG("ogg",            0, "OggS", check_ogg),
+		FORM("wav",              "RIFF", "WAVE"),
+		FORM("wav",              "RF64", "WAVE"),
+		FORM("aiff",             "FORM", "AIFF"),
+		FORM("aiff",             "FORM", "AIFC"),
+		SIG("yuv4mpegpipe",   0, "YUV4MPEG2 ", nullptr),
+		SIG("mpegts",         0, "\x47", check_mpegts),
+		SIG("mpegts",         4, "\x47", check_m2ts),
+		// images
+		SIG("png_pipe",       0, "\x89PNG\r\n\x1A\n", nullptr),
+		SIG("jpegls_pipe",    0, "\xFF\xD8\xFF", check_jpegls),
+		SIG("jpeg_pipe",      0, "\xFF\xD8\xFF", check_jpeg),
+		SIG("bmp_pipe",       0, "BM", check_bmp),
+		SIG("dds_pipe",       0, "DDS ", check_dds),
+		SIG("dpx_pipe",       0, "SDPX", nullptr),
+		SIG("dpx_pipe",       0, "XPDS", nullptr),
+		SIG("exr_pipe",       0, "\x76\x2F\x31\x01", nullptr),
+		SIG("j2k_pipe",       0, "\xFF\x4F\xFF\x51", nullptr),
+		SIG("jpegxl_pipe",    0, "\xFF\x0A", nullptr),
+		SIG("jpegxl_pipe",    0, "\x00\x00\x00\x0CJXL \r\n\x87\n", nullptr),
+		SIG("pam_pipe",       0, "P7\n", nullptr),
+		SIG("pbm_pipe",       0, "P1", check_pnm),
+		SIG("pbm_pipe",       0, "P4", check_pnm),
+		SIG("pgm_pipe",       0, "P2", check_pnm),
+		SIG("pgm_pipe",       0, "P5", check_pnm),
+		SIG("ppm_pipe",       0, "P3", check_pnm),
+		SIG("ppm_pipe",       0, "P6", check_pnm),
+		SIG("pcx_pipe",       0, "\x0A", check_pcx),
+		SIG("psd_pipe",       0, "8BPS", check_psd),
+		SIG("sgi_pipe",       0, "\x01\xDA", check_sgi),
+		SIG("sunrast_pipe",   0, "\x59\xA6\x6A\x95", nullptr),
+		SIG("tiff_pipe",      0, "II\x2A\x00", nullptr),
+		SIG("tiff_pipe",      0, "MM\x00\x2A", nullptr),
+		FORM("webp_pipe",        "RIFF", "WEBP"),
+	};
+
+#undef SIG
+#undef FORM
+}
+
+IVDXInputFileDriver::DetectionConfidence detect_signature(VDXMediaInfo& info, const void* pHeader, int32_t nHeaderSize)
+{
+	if (!pHeader || nHeaderSize < 4) {
+		return IVDXInputFileDriver::kDC_None;
+	}
+	const uint8_t* p = (const uint8_t*)pHeader;
+	const int size = nHeaderSize;
+
+	for (const Signature& sig : s_signatures) {
+		if (sig.offset + sig.magic_size > size) {
+			continue;
+		}
+		if (memcmp(p + sig.offset, sig.magic, sig.magic_size) != 0) {
+			continue;
+		}
+		if (sig.form && (size < 12 || memcmp(p + 8, sig.form, 4) != 0)) {
+			continue;
+		}
+		if (sig.check && !sig.check(p, size)) {
+			continue;
+		}
+
+		copyCharToWchar(info.format_name, std::size(info.format_name), sig.name);
+		return IVDXInputFileDriver::kDC_Moderate;
+	}
+
+	return IVDXInputFileDriver::kDC_None;
+}
@@ -0,0 +1,15 @@
+/*
+ * Copyright (C) 2026 v0lt
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#pragma once
+
+#include <vd2/plugin/vdinputdriver.h>
+
+// Detection of common containers and image formats by their header, without FFmpeg probing.
+// format_name is set to the name of the FFmpeg demuxer that opens the file.
+// Formats with weak signatures are not detected here and are left to av_probe_input_format3.
+
+IVDXInputFileDriver::DetectionConfidence detect_signature(VDXMediaInfo& info, const void* pHeader, int32_t nHeaderSize);